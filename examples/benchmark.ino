@@ -0,0 +1,218 @@
+#include <Arduino.h>
+#include "AT_lib.h"
+
+// On-target counterpart of extras/host/bench/at_bench.cpp.
+// Prints one JSON document to Serial with the same result
+// layout, so host and device runs can be compared directly.
+// Heap use is reported as the free-heap delta per operation
+// instead of an allocation count.
+
+// UARTs
+#define MODEM_RX 26
+#define MODEM_TX 27
+
+// APN settings
+#define APN     "internet"
+
+// Broker used for the publish and loopback runs
+#define BROKER  "tcp://broker.hivemq.com:1883"
+#define TOPIC   "at_lib/bench"
+
+// Iterations per run
+#define BENCH_COMMANDS 200
+#define BENCH_PUBLISHES 50
+#define BENCH_RECEIVES 20
+
+// Globals
+AT_Lib at(Serial1, Serial);
+
+static bool first = true;
+static int asyncDone = 0;
+static int rxCount = 0;
+static unsigned long rxBytes = 0;
+
+static uint32_t freeHeap()
+{
+#ifdef ARDUINO_ARCH_ESP32
+    return ESP.getFreeHeap();
+#else
+    return 0;
+#endif
+}
+
+static void result(const char *name, const char *fields)
+{
+    Serial.printf("%s\n    {\"name\": \"%s\", %s}", first ? "" : ",", name, fields);
+    first = false;
+}
+
+static int compareUl(const void *a, const void *b)
+{
+    unsigned long x = *(const unsigned long *)a;
+    unsigned long y = *(const unsigned long *)b;
+    return x < y ? -1 : x > y;
+}
+
+// ----------------------------------------------------
+// Callbacks
+// ----------------------------------------------------
+void onPublished(const AT_Completion &done, void *user)
+{
+    asyncDone++;
+}
+
+void onBenchMessage(const char *topic, const char *payload, uint16_t len)
+{
+    rxCount++;
+    rxBytes += len;
+}
+
+// ----------------------------------------------------
+// Command round trip
+// ----------------------------------------------------
+static void benchCommand()
+{
+    static unsigned long rtt[BENCH_COMMANDS];
+    char f[160];
+
+    int32_t heap = freeHeap();
+    for (int i = 0; i < BENCH_COMMANDS; i++) {
+        unsigned long t = micros();
+        at.command("AT", 500);
+        rtt[i] = micros() - t;
+    }
+    heap -= freeHeap();
+
+    qsort(rtt, BENCH_COMMANDS, sizeof(rtt[0]), compareUl);
+    snprintf(f, sizeof(f),
+             "\"ops\": %d, \"p50_us\": %lu, \"p99_us\": %lu, \"max_us\": %lu, \"heap_per_op\": %.2f",
+             BENCH_COMMANDS, rtt[BENCH_COMMANDS / 2], rtt[BENCH_COMMANDS * 99 / 100],
+             rtt[BENCH_COMMANDS - 1], (double)heap / BENCH_COMMANDS);
+    result("command", f);
+}
+
+// ----------------------------------------------------
+// Publish throughput
+// ----------------------------------------------------
+static void benchPublish(uint16_t size)
+{
+    static uint8_t payload[1024];
+    memset(payload, 'x', size);
+    char f[200];
+
+    int32_t heap = freeHeap();
+    unsigned long start = millis();
+    int ok = 0;
+    for (int i = 0; i < BENCH_PUBLISHES; i++) {
+        ok += at.mqttPublish(0, TOPIC "/publish", payload, size, 0);
+    }
+    float s = (millis() - start) / 1000.0f;
+    heap -= freeHeap();
+
+    snprintf(f, sizeof(f),
+             "\"payload\": %u, \"ops\": %d, \"ok\": %d, \"msgs_per_s\": %.1f, \"bytes_per_s\": %.0f, \"heap_per_op\": %.2f",
+             size, BENCH_PUBLISHES, ok, ok / s, ok * size / s, (double)heap / BENCH_PUBLISHES);
+    result("mqttPublish", f);
+
+    // Pipelined: keep the async queue full
+    asyncDone = 0;
+    int queued = 0;
+    heap = freeHeap();
+    start = millis();
+    while (asyncDone < BENCH_PUBLISHES && millis() - start < 60000) {
+        while (queued < BENCH_PUBLISHES &&
+               at.mqttPublishAsync(0, TOPIC "/publish", payload, size, 0, onPublished)) {
+            queued++;
+        }
+        at.poll();
+    }
+    s = (millis() - start) / 1000.0f;
+    heap -= freeHeap();
+
+    snprintf(f, sizeof(f),
+             "\"payload\": %u, \"ops\": %d, \"ok\": %d, \"msgs_per_s\": %.1f, \"bytes_per_s\": %.0f, \"heap_per_op\": %.2f",
+             size, BENCH_PUBLISHES, asyncDone, asyncDone / s, asyncDone * size / s,
+             (double)heap / BENCH_PUBLISHES);
+    result("mqttPublishAsync", f);
+}
+
+// ----------------------------------------------------
+// RX parse rate (loopback through the broker)
+// ----------------------------------------------------
+static void benchReceive(uint16_t size)
+{
+    static char payload[1024];
+    // Kept JSON so deliverMqtt() accepts it
+    memset(payload, 'x', size);
+    memcpy(payload, "{\"v\":\"", 6);
+    memcpy(payload + size - 2, "\"}", 2);
+
+    for (int i = 0; i < BENCH_RECEIVES; i++) {
+        at.mqttPublish(0, TOPIC "/rx", (const uint8_t *)payload, size, 0);
+    }
+
+    rxCount = 0;
+    rxBytes = 0;
+    int32_t heap = freeHeap();
+    unsigned long start = millis();
+    while (rxCount < BENCH_RECEIVES && millis() - start < 30000) {
+        at.poll();
+    }
+    float s = (millis() - start) / 1000.0f;
+    heap -= freeHeap();
+
+    char f[200];
+    snprintf(f, sizeof(f),
+             "\"payload\": %u, \"ops\": %d, \"received\": %d, \"msgs_per_s\": %.1f, \"bytes_per_s\": %.0f, "
+             "\"heap_per_op\": %.2f",
+             size, BENCH_RECEIVES, rxCount, rxCount / s, rxBytes / s, (double)heap / BENCH_RECEIVES);
+    result("mqttPoll", f);
+}
+
+// ----------------------------------------------------
+// Arduino SETUP
+// ----------------------------------------------------
+void setup()
+{
+    Serial.begin(115200);
+    delay(1000);
+
+    at.setLogLevel(AT_LOG_NONE);
+    at.begin(115200, MODEM_RX, MODEM_TX);
+
+    if (!at.waitForPBDONE(15000)) return;
+    if (!at.modemReady(5000)) return;
+
+    at.sendCommand("AT+CGDCONT=1,\"IP\",\"" APN "\"", 3000);
+    at.sendCommand("AT+CGATT=1", 10000);
+
+    if (!at.mqttStart() ||
+        !at.mqttAcquire(0, "at_lib_bench") ||
+        !at.mqttConnect(0, BROKER, "", "")) {
+        Serial.println("[BENCH] MQTT setup failed");
+        return;
+    }
+    at.mqttSubscribe(0, TOPIC "/rx", 0, onBenchMessage);
+
+    Serial.printf("{\n  \"suite\": \"AT_Lib\",\n  \"target\": \"device\",\n  \"mode\": \"realistic\",\n  \"results\": [");
+
+    benchCommand();
+    static const uint16_t sizes[] = {16, 128, 512, 1024};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        benchPublish(sizes[i]);
+    }
+    benchReceive(128);
+    benchReceive(1024);
+
+    // SMS ingest needs a second party sending to the SIM; it is
+    // measured on the host only
+    Serial.printf("\n  ]\n}\n");
+}
+
+// ----------------------------------------------------
+// Arduino LOOP
+// ----------------------------------------------------
+void loop()
+{
+    at.poll();
+}
@@ -1,5 +1,6 @@
 #include <Arduino.h>
-#include "AT_Lib.h"
+#include <LittleFS.h>
+#include "AT_lib.h"
 #include "Sim76xx_mqtt_errors.h"
 
 // UARTs
@@ -14,6 +15,16 @@
 // Globals
 AT_Lib at(Serial1, Serial);
 
+// Kept for the supervisor, which reconnects with it
+AT_MqttSession session;
+
+// Publishes made while the link is down wait here, in flash
+AT_OutboxLittleFS outboxStore;
+AT_Outbox outbox(outboxStore);
+
+// Readings are batched per topic into one message every 30 s
+AT_Telemetry telemetry(AT_TELEMETRY_FLUSH_BYTES, 30000);
+
 // ----------------------------------------------------
 // Basic cellular network setup (PDP context)
 // ----------------------------------------------------
@@ -55,7 +66,18 @@ void setup()
 
     if (!setupNetwork()) return;
 
+    // Readings stored before a reset are sent once connected
+    if (LittleFS.begin(true) && outbox.begin()) {
+        at.setOutbox(&outbox);
+        Serial.printf("[MQTT] %lu stored publishes waiting\n", (unsigned long)outbox.depth());
+    }
+
     // ---------------- MQTT ----------------
+    session.clientName = "esp32client";
+    session.uri = "tcp://broker.hivemq.com:1883";
+    session.user = "username";
+    session.pass = "password";
+
     Serial.println("[MQTT] Starting service...");
     if (!at.mqttStart()) {
         Serial.println("[MQTT] Start failed");
@@ -63,7 +85,7 @@ void setup()
     }
 
     Serial.println("[MQTT] Acquiring client...");
-    if (!at.mqttAcquire(0, "esp32client")) {
+    if (!at.mqttAcquire(0, session.clientName)) {
         Serial.println("[MQTT] Acquire failed");
         return;
     }
@@ -71,11 +93,11 @@ void setup()
     Serial.println("[MQTT] Connecting...");
     if (!at.mqttConnect(
             0,
-            "tcp://broker.hivemq.com:1883",
-            "username",
-            "password",
-            60,
-            true
+            session.uri,
+            session.user,
+            session.pass,
+            session.keepAlive,
+            session.cleanSession
         )) {
         Serial.println("[MQTT] Connect failed");
         return;
@@ -97,28 +119,53 @@ void setup()
         0
     );
 
+    // From here on a dropped link is brought back, with its
+    // subscriptions, from inside poll()
+    at.mqttSupervise(0, session);
+    at.setTelemetry(&telemetry, 0, 1);
+
     Serial.println("[MQTT] Setup complete");
 }
 
+// ----------------------------------------------------
+// Publish result (async)
+// ----------------------------------------------------
+void onPublished(const AT_Completion &done, void *user)
+{
+    if (!done.ok) {
+        Serial.printf("[MQTT] Publish failed (%d)\n", done.code);
+    }
+}
+
 // ----------------------------------------------------
 // Arduino LOOP
 // ----------------------------------------------------
 void loop()
 {
-    // Required to receive MQTT messages
-    at.mqttPoll();
+    // Required to receive MQTT messages and advance async work
+    at.poll();
+
+    // One sample a second, published as a batch
+    static uint32_t lastSample = 0;
+    if (millis() - lastSample > 1000) {
+        lastSample = millis();
+        at.record("test/telemetry/heap", (long)ESP.getFreeHeap());
+    }
 
+    // While the supervisor is reconnecting this goes to the outbox
     static uint32_t lastPub = 0;
     if (millis() - lastPub > 10000) {
         lastPub = millis();
 
+        // Queued; loop() keeps running while the modem works
         const char* msg = "periodic ping";
-        at.mqttPublish(
+        at.mqttPublishAsync(
             0,
             "test/topic",
             (const uint8_t*)msg,
             strlen(msg),
-            0
+            0,
+            onPublished
         );
     }
 }
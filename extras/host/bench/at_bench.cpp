@@ -0,0 +1,280 @@
+// Host benchmark of AT_Lib against the SIM7600 emulator.
+// Prints one JSON document to stdout; see examples/benchmark.ino
+// for the on-target counterpart with the same result layout.
+//
+//   at_bench              library cost only, modem answers instantly
+//   at_bench --realistic  115200 baud pacing, 2 ms response, 60 ms network
+
+#include <Arduino.h>
+#include <algorithm>
+#include <new>
+#include <vector>
+#include "AT_lib.h"
+#include "Sim7600Emulator.h"
+
+// =====================================================
+// ALLOCATION COUNTER
+// Counts heap allocations made outside the emulator
+// =====================================================
+static unsigned long g_allocs = 0;
+
+void *operator new(size_t n)
+{
+  if (!Sim7600Emulator::busy())
+    g_allocs++;
+  void *p = malloc(n ? n : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void *operator new[](size_t n) { return operator new(n); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+// =====================================================
+// SETUP
+// =====================================================
+class NullStream : public Stream
+{
+public:
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  size_t write(uint8_t) override { return 1; }
+  using Print::write;
+};
+
+static NullStream quiet;
+static Sim7600Emulator modem;
+static AT_Lib at(modem, quiet);
+
+static bool first = true;
+
+static void result(const char *name, const char *fields)
+{
+  printf("%s\n    {\"name\": \"%s\", %s}", first ? "" : ",", name, fields);
+  first = false;
+}
+
+static double seconds(unsigned long startUs)
+{
+  return (micros() - startUs) / 1e6;
+}
+
+// =====================================================
+// COMMAND ROUND TRIP
+// =====================================================
+static void benchCommand(int n)
+{
+  std::vector<unsigned long> rtt;
+  rtt.reserve(n);
+
+  unsigned long allocs = g_allocs;
+  for (int i = 0; i < n; i++)
+  {
+    unsigned long t = micros();
+    at.sendCommand("AT", 500);
+    rtt.push_back(micros() - t);
+  }
+  allocs = g_allocs - allocs;
+
+  std::sort(rtt.begin(), rtt.end());
+  char f[160];
+  snprintf(f, sizeof(f), "\"ops\": %d, \"p50_us\": %lu, \"p99_us\": %lu, \"max_us\": %lu, \"allocs_per_op\": %.2f",
+           n, rtt[n / 2], rtt[n * 99 / 100], rtt[n - 1], (double)allocs / n);
+  result("sendCommand", f);
+
+  rtt.clear();
+  allocs = g_allocs;
+  for (int i = 0; i < n; i++)
+  {
+    unsigned long t = micros();
+    at.command("AT", 500);
+    rtt.push_back(micros() - t);
+  }
+  allocs = g_allocs - allocs;
+
+  std::sort(rtt.begin(), rtt.end());
+  snprintf(f, sizeof(f), "\"ops\": %d, \"p50_us\": %lu, \"p99_us\": %lu, \"max_us\": %lu, \"allocs_per_op\": %.2f",
+           n, rtt[n / 2], rtt[n * 99 / 100], rtt[n - 1], (double)allocs / n);
+  result("command", f);
+}
+
+// =====================================================
+// PUBLISH THROUGHPUT
+// =====================================================
+static int asyncDone = 0;
+
+static void onAsync(const AT_Completion &done, void *user)
+{
+  asyncDone++;
+}
+
+static void benchPublish(uint16_t size, int n)
+{
+  std::vector<uint8_t> payload(size, 'x');
+  char f[200];
+
+  unsigned long allocs = g_allocs;
+  unsigned long start = micros();
+  int ok = 0;
+  for (int i = 0; i < n; i++)
+    ok += at.mqttPublish(0, "bench/publish", payload.data(), size, 0);
+  double s = seconds(start);
+  allocs = g_allocs - allocs;
+
+  snprintf(f, sizeof(f),
+           "\"payload\": %u, \"ops\": %d, \"ok\": %d, \"msgs_per_s\": %.1f, \"bytes_per_s\": %.0f, \"allocs_per_op\": %.2f",
+           size, n, ok, n / s, n * size / s, (double)allocs / n);
+  result("mqttPublish", f);
+
+  // Pipelined: keep the async queue full
+  asyncDone = 0;
+  allocs = g_allocs;
+  start = micros();
+  int queued = 0;
+  unsigned long deadline = millis() + 60000;
+  while (asyncDone < n && millis() < deadline)
+  {
+    while (queued < n && at.mqttPublishAsync(0, "bench/publish", payload.data(), size, 0, onAsync))
+      queued++;
+    at.poll();
+  }
+  s = seconds(start);
+  allocs = g_allocs - allocs;
+
+  snprintf(f, sizeof(f),
+           "\"payload\": %u, \"ops\": %d, \"ok\": %d, \"msgs_per_s\": %.1f, \"bytes_per_s\": %.0f, "
+           "\"allocs_per_op\": %.2f",
+           size, n, asyncDone, asyncDone / s, asyncDone * size / s, (double)allocs / n);
+  result("mqttPublishAsync", f);
+}
+
+// =====================================================
+// RX PARSE RATE
+// =====================================================
+static int rxCount = 0;
+static unsigned long rxBytes = 0;
+
+static void onMessage(const char *topic, const char *payload, uint16_t len)
+{
+  rxCount++;
+  rxBytes += len;
+}
+
+static void benchReceive(uint16_t size, int n)
+{
+  std::string payload = "{\"v\":\"" + std::string(size > 8 ? size - 8 : 0, 'x') + "\"}";
+  for (int i = 0; i < n; i++)
+    modem.injectMqttMessage(0, "bench/rx/" + std::to_string(i % 10), payload);
+
+  rxCount = 0;
+  rxBytes = 0;
+  unsigned long allocs = g_allocs;
+  unsigned long start = micros();
+  unsigned long deadline = millis() + 60000;
+  while (rxCount < n && millis() < deadline)
+    at.poll();
+  double s = seconds(start);
+  allocs = g_allocs - allocs;
+
+  char f[200];
+  snprintf(f, sizeof(f),
+           "\"payload\": %u, \"ops\": %d, \"received\": %d, \"msgs_per_s\": %.1f, \"bytes_per_s\": %.0f, "
+           "\"allocs_per_op\": %.2f",
+           (unsigned)payload.size(), n, rxCount, rxCount / s, rxBytes / s, (double)allocs / n);
+  result("mqttPoll", f);
+}
+
+// =====================================================
+// SMS INGEST
+// =====================================================
+static int smsCount = 0;
+
+static void onSms(const char *sender, const char *timestamp, const char *message)
+{
+  smsCount++;
+}
+
+static void benchSms(int n)
+{
+  smsCount = 0;
+  unsigned long allocs = g_allocs;
+  unsigned long start = micros();
+  unsigned long deadline = millis() + 60000;
+
+  // Stays within the +CMTI pending queue
+  int injected = 0;
+  while (smsCount < n && millis() < deadline)
+  {
+    while (injected < n && injected - smsCount < AT_SMS_PENDING_MAX)
+    {
+      modem.injectSms("+15550100", "benchmark message body");
+      injected++;
+    }
+    at.poll();
+  }
+  double s = seconds(start);
+  allocs = g_allocs - allocs;
+
+  char f[160];
+  snprintf(f, sizeof(f), "\"ops\": %d, \"received\": %d, \"msgs_per_s\": %.1f, \"allocs_per_op\": %.2f", n,
+           smsCount, smsCount / s, (double)allocs / n);
+  result("smsPoll", f);
+
+  // Blocking read of a stored message
+  int index = modem.storeSms("+15550100", "benchmark message body");
+  char sender[AT_SMS_SENDER_MAX], time[AT_SMS_TIME_MAX], body[AT_SMS_BODY_MAX];
+  int ok = 0;
+  allocs = g_allocs;
+  start = micros();
+  for (int i = 0; i < n; i++)
+    ok += at.readSMS(index, sender, sizeof(sender), time, sizeof(time), body, sizeof(body));
+  s = seconds(start);
+  allocs = g_allocs - allocs;
+
+  snprintf(f, sizeof(f), "\"ops\": %d, \"ok\": %d, \"msgs_per_s\": %.1f, \"allocs_per_op\": %.2f", n, ok,
+           n / s, (double)allocs / n);
+  result("readSMS", f);
+}
+
+// =====================================================
+// MAIN
+// =====================================================
+int main(int argc, char **argv)
+{
+  bool realistic = argc > 1 && strcmp(argv[1], "--realistic") == 0;
+  int scale = realistic ? 20 : 1;
+
+  at.setLogLevel(AT_LOG_NONE);
+  at.begin(115200, -1, -1);
+  if (realistic)
+  {
+    modem.setPacing(true);
+    modem.setResponseDelay(2);
+    modem.setNetworkDelay(60);
+  }
+
+  at.mqttStart();
+  at.mqttAcquire(0, "bench");
+  at.mqttConnect(0, "tcp://bench:1883", "", "");
+  at.mqttSubscribe(0, "bench/rx/#", 0, onMessage);
+  at.onSMSReceived(onSms);
+
+  printf("{\n  \"suite\": \"AT_Lib\",\n  \"target\": \"host\",\n  \"mode\": \"%s\",\n  \"results\": [",
+         realistic ? "realistic" : "cpu");
+
+  benchCommand(20000 / scale);
+  static const uint16_t sizes[] = {16, 128, 512, 1024};
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    benchPublish(sizes[i], 2000 / scale);
+  benchReceive(128, 5000 / scale);
+  benchReceive(1024, 2000 / scale);
+  benchSms(2000 / scale);
+
+  printf("\n  ]\n}\n");
+  return 0;
+}
@@ -0,0 +1,295 @@
+#ifndef ARDUINO_COMPAT_H
+#define ARDUINO_COMPAT_H
+
+/*
+ * Minimal Arduino compatibility layer for building AT_Lib on a host.
+ * Only the subset of the Arduino core used by the library is provided.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <math.h>
+#include <sys/time.h>
+#include <string>
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+inline bool isDigit(int c) { return isdigit(c) != 0; }
+
+#define SERIAL_8N1 0x800001c
+
+/* =====================================================
+ * String
+ * ===================================================== */
+class String
+{
+public:
+  String() {}
+  String(const char *s) : _s(s ? s : "") {}
+  String(const char *s, size_t n) : _s(s, n) {}
+  String(const String &o) = default;
+  String(char c) : _s(1, c) {}
+  String(int v) : _s(std::to_string(v)) {}
+  String(unsigned int v) : _s(std::to_string(v)) {}
+  String(long v) : _s(std::to_string(v)) {}
+  String(unsigned long v) : _s(std::to_string(v)) {}
+  String &operator=(const String &o) = default;
+  String &operator=(const char *s)
+  {
+    _s = s ? s : "";
+    return *this;
+  }
+
+  unsigned int length() const { return (unsigned int)_s.size(); }
+  const char *c_str() const { return _s.c_str(); }
+  bool reserve(unsigned int n)
+  {
+    _s.reserve(n);
+    return true;
+  }
+
+  String &operator+=(const String &o)
+  {
+    _s += o._s;
+    return *this;
+  }
+  String &operator+=(const char *s)
+  {
+    _s += s ? s : "";
+    return *this;
+  }
+  String &operator+=(char c)
+  {
+    _s += c;
+    return *this;
+  }
+  bool concat(const char *s, unsigned int n)
+  {
+    _s.append(s, n);
+    return true;
+  }
+  friend String operator+(const String &a, const String &b) { return String((a._s + b._s).c_str(), a._s.size() + b._s.size()); }
+  friend String operator+(const String &a, const char *b) { return a + String(b); }
+  friend String operator+(const char *a, const String &b) { return String(a) + b; }
+
+  bool operator==(const String &o) const { return _s == o._s; }
+  bool operator==(const char *s) const { return _s == (s ? s : ""); }
+  bool operator!=(const char *s) const { return !(*this == s); }
+  char operator[](unsigned int i) const { return i < _s.size() ? _s[i] : 0; }
+  char charAt(unsigned int i) const { return (*this)[i]; }
+
+  int indexOf(char c, unsigned int from = 0) const { return pos(_s.find(c, from)); }
+  int indexOf(const char *s, unsigned int from = 0) const { return pos(_s.find(s, from)); }
+  int indexOf(const String &s, unsigned int from = 0) const { return pos(_s.find(s._s, from)); }
+  int lastIndexOf(char c) const { return pos(_s.rfind(c)); }
+  bool startsWith(const char *s) const { return _s.compare(0, strlen(s), s) == 0; }
+  bool endsWith(const char *s) const
+  {
+    size_t n = strlen(s);
+    return _s.size() >= n && _s.compare(_s.size() - n, n, s) == 0;
+  }
+
+  String substring(unsigned int from) const { return from >= _s.size() ? String() : String(_s.substr(from).c_str()); }
+  String substring(unsigned int from, unsigned int to) const
+  {
+    if (from >= _s.size() || to <= from)
+      return String();
+    return String(_s.substr(from, to - from).c_str());
+  }
+  void remove(unsigned int index, unsigned int count = (unsigned int)-1)
+  {
+    if (index < _s.size())
+      _s.erase(index, count);
+  }
+  void trim()
+  {
+    size_t b = 0, e = _s.size();
+    while (b < e && isspace((unsigned char)_s[b]))
+      b++;
+    while (e > b && isspace((unsigned char)_s[e - 1]))
+      e--;
+    _s = _s.substr(b, e - b);
+  }
+  long toInt() const { return atol(_s.c_str()); }
+  void toCharArray(char *buf, unsigned int size) const
+  {
+    if (!size)
+      return;
+    size_t n = _s.size() < size - 1 ? _s.size() : size - 1;
+    memcpy(buf, _s.data(), n);
+    buf[n] = 0;
+  }
+
+private:
+  static int pos(size_t p) { return p == std::string::npos ? -1 : (int)p; }
+  std::string _s;
+};
+
+/* =====================================================
+ * Print / Stream
+ * ===================================================== */
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buf, size_t n)
+  {
+    size_t w = 0;
+    while (n--)
+      w += write(*buf++);
+    return w;
+  }
+  size_t write(const char *s) { return s ? write((const uint8_t *)s, strlen(s)) : 0; }
+  size_t write(const char *s, size_t n) { return write((const uint8_t *)s, n); }
+  size_t write(char c) { return write((uint8_t)c); }
+  size_t write(int c) { return write((uint8_t)c); }
+
+  size_t print(const char *s) { return write(s); }
+  size_t print(const String &s) { return write(s.c_str(), s.length()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v) { return printf("%d", v); }
+  size_t print(unsigned int v) { return printf("%u", v); }
+  size_t print(long v) { return printf("%ld", v); }
+  size_t print(unsigned long v) { return printf("%lu", v); }
+  size_t print(long long v) { return printf("%lld", v); }
+  size_t print(double v) { return printf("%.2f", v); }
+
+  size_t println() { return write("\r\n"); }
+  template <typename T>
+  size_t println(const T &v)
+  {
+    size_t n = print(v);
+    return n + println();
+  }
+
+  size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)))
+  {
+    char buf[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n < 0)
+      return 0;
+    if ((size_t)n >= sizeof(buf))
+      n = sizeof(buf) - 1;
+    return write((const uint8_t *)buf, n);
+  }
+
+  virtual void flush() {}
+};
+
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long ms) { _timeout = ms; }
+
+  size_t readBytes(char *buf, size_t n)
+  {
+    size_t got = 0;
+    unsigned long start = millis();
+    while (got < n && millis() - start < _timeout)
+    {
+      int c = read();
+      if (c < 0)
+      {
+        yield();
+        continue;
+      }
+      buf[got++] = (char)c;
+    }
+    return got;
+  }
+
+  String readStringUntil(char terminator)
+  {
+    String s;
+    unsigned long start = millis();
+    while (millis() - start < _timeout)
+    {
+      int c = read();
+      if (c < 0)
+      {
+        yield();
+        continue;
+      }
+      if (c == terminator)
+        break;
+      s += (char)c;
+    }
+    return s;
+  }
+
+protected:
+  unsigned long _timeout = 1000;
+};
+
+/* =====================================================
+ * HardwareSerial
+ * Host stand-in; sketches normally talk to a modem emulator
+ * through the Stream interface instead.
+ * ===================================================== */
+class HardwareSerial : public Stream
+{
+public:
+  explicit HardwareSerial(int num = 0) : _num(num) {}
+  void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rx = -1, int8_t tx = -1)
+  {
+    (void)config;
+    (void)rx;
+    (void)tx;
+    _baud = baud;
+  }
+  void end() {}
+  void updateBaudRate(unsigned long baud) { _baud = baud; }
+  unsigned long baudRate() const { return _baud; }
+
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  size_t write(uint8_t c) override
+  {
+    (void)c;
+    return 1;
+  }
+  using Print::write;
+
+private:
+  int _num;
+  unsigned long _baud = 0;
+};
+
+/* =====================================================
+ * Console
+ * `Serial` for host programs: output goes to stdout,
+ * there is never any input.
+ * ===================================================== */
+class ConsoleStream : public Stream
+{
+public:
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  size_t write(uint8_t c) override { return fputc(c, stdout) == EOF ? 0 : 1; }
+  size_t write(const uint8_t *buf, size_t n) override { return fwrite(buf, 1, n, stdout); }
+  using Print::write;
+  void flush() override { fflush(stdout); }
+};
+
+extern ConsoleStream Serial;
+
+#endif /* ARDUINO_COMPAT_H */
@@ -0,0 +1,192 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+struct RtosTask
+{
+  std::mutex m;
+  std::condition_variable cv;
+  uint32_t notified = 0;
+};
+
+struct RtosMutex
+{
+  std::recursive_timed_mutex m;
+};
+
+struct RtosQueue
+{
+  std::mutex m;
+  std::condition_variable cv;
+  std::deque<std::vector<uint8_t>> items;
+  size_t length;
+  size_t itemSize;
+};
+
+static thread_local RtosTask *currentTask = nullptr;
+
+// Waits on `cv` until `ready()`; portMAX_DELAY waits forever
+template <typename Pred>
+static bool waitFor(std::condition_variable &cv, std::unique_lock<std::mutex> &lock, TickType_t ticks, Pred ready)
+{
+  if (ticks == portMAX_DELAY)
+  {
+    cv.wait(lock, ready);
+    return true;
+  }
+  return cv.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+// =====================================================
+// TASKS
+// Tasks are detached threads; handles live until exit
+// =====================================================
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stackDepth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *created, BaseType_t core)
+{
+  RtosTask *task = new RtosTask();
+  if (created)
+    *created = task;
+
+  std::thread([fn, arg, task]() {
+    currentTask = task;
+    fn(arg);
+  }).detach();
+  return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+  // A FreeRTOS task function never returns; the thread simply ends
+  // here. The handle is leaked, as nothing may use it afterwards.
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+  return currentTask;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+  std::lock_guard<std::mutex> lock(task->m);
+  task->notified++;
+  task->cv.notify_one();
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks)
+{
+  RtosTask *task = currentTask;
+  if (!task)
+  {
+    vTaskDelay(ticks == portMAX_DELAY ? 1 : ticks);
+    return 0;
+  }
+
+  std::unique_lock<std::mutex> lock(task->m);
+  waitFor(task->cv, lock, ticks, [task] { return task->notified > 0; });
+  uint32_t value = task->notified;
+  if (value)
+    task->notified = clearOnExit ? 0 : value - 1;
+  return value;
+}
+
+// =====================================================
+// RECURSIVE MUTEX
+// =====================================================
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex()
+{
+  return new RtosMutex();
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t ticks)
+{
+  if (ticks == portMAX_DELAY)
+  {
+    mutex->m.lock();
+    return pdTRUE;
+  }
+  return mutex->m.try_lock_for(std::chrono::milliseconds(ticks)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex)
+{
+  mutex->m.unlock();
+  return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t mutex)
+{
+  delete mutex;
+}
+
+// =====================================================
+// QUEUES
+// Items are copied in and out, as in FreeRTOS
+// =====================================================
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+  RtosQueue *q = new RtosQueue();
+  q->length = length;
+  q->itemSize = itemSize;
+  return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+  std::unique_lock<std::mutex> lock(q->m);
+  if (!waitFor(q->cv, lock, ticks, [q] { return q->items.size() < q->length; }))
+    return pdFAIL;
+
+  const uint8_t *p = (const uint8_t *)item;
+  q->items.emplace_back(p, p + q->itemSize);
+  q->cv.notify_all();
+  return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+  std::unique_lock<std::mutex> lock(q->m);
+  if (!waitFor(q->cv, lock, ticks, [q] { return !q->items.empty(); }))
+    return pdFALSE;
+
+  memcpy(item, q->items.front().data(), q->itemSize);
+  q->items.pop_front();
+  q->cv.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueuePeek(QueueHandle_t q, void *item, TickType_t ticks)
+{
+  std::unique_lock<std::mutex> lock(q->m);
+  if (!waitFor(q->cv, lock, ticks, [q] { return !q->items.empty(); }))
+    return pdFALSE;
+
+  memcpy(item, q->items.front().data(), q->itemSize);
+  return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+  std::lock_guard<std::mutex> lock(q->m);
+  return q->items.size();
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+  delete q;
+}
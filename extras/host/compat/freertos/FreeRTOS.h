@@ -0,0 +1,34 @@
+#ifndef FREERTOS_COMPAT_H
+#define FREERTOS_COMPAT_H
+
+/*
+ * Minimal FreeRTOS compatibility layer on host threads, enough to
+ * build AT_Lib with AT_RTOS=1. One tick is one millisecond; task
+ * priorities, stack sizes and core affinity are accepted and ignored.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFFUL)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+struct RtosTask;
+struct RtosMutex;
+struct RtosQueue;
+typedef RtosTask *TaskHandle_t;
+typedef RtosMutex *SemaphoreHandle_t;
+typedef RtosQueue *QueueHandle_t;
+
+typedef void (*TaskFunction_t)(void *);
+
+#endif /* FREERTOS_COMPAT_H */
@@ -0,0 +1,11 @@
+#ifndef FREERTOS_SEMPHR_COMPAT_H
+#define FREERTOS_SEMPHR_COMPAT_H
+
+#include "FreeRTOS.h"
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex();
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t ticks);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex);
+void vSemaphoreDelete(SemaphoreHandle_t mutex);
+
+#endif /* FREERTOS_SEMPHR_COMPAT_H */
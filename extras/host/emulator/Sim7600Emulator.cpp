@@ -0,0 +1,588 @@
+#include "Sim7600Emulator.h"
+#include <time.h>
+
+int Sim7600Emulator::_busy = 0;
+
+Sim7600Emulator::Sim7600Emulator() : HardwareSerial(1) {}
+
+// =====================================================
+// SCRIPTING
+// =====================================================
+void Sim7600Emulator::on(const std::string &prefix, Handler handler)
+{
+  _handlers.push_back(std::make_pair(prefix, handler));
+}
+
+void Sim7600Emulator::reply(const std::string &bytes, uint32_t delayMs)
+{
+  queue(bytes, _responseDelayUs + delayMs * 1000UL);
+}
+
+void Sim7600Emulator::expectData(size_t n, DataHandler handler)
+{
+  _dataLeft = n;
+  _data.clear();
+  _dataHandler = handler;
+  reply("\r\n>");
+}
+
+void Sim7600Emulator::clearLog()
+{
+  _published.clear();
+  _commands.clear();
+  _sentSms.clear();
+  _bytesIn = 0;
+  _bytesOut = 0;
+}
+
+// =====================================================
+// UNSOLICITED TRAFFIC
+// =====================================================
+void Sim7600Emulator::injectUrc(const std::string &line, uint32_t delayMs)
+{
+  queue("\r\n" + line + "\r\n", delayMs * 1000UL);
+}
+
+void Sim7600Emulator::injectMqttMessage(uint8_t client, const std::string &topic, const std::string &payload,
+                                        uint32_t delayMs, size_t chunk)
+{
+  std::string id = std::to_string(client);
+  std::string s = "\r\n+CMQTTRXSTART: " + id + "," + std::to_string(topic.size()) + "," +
+                  std::to_string(payload.size()) + "\r\n";
+  s += "+CMQTTRXTOPIC: " + id + "," + std::to_string(topic.size()) + "\r\n" + topic + "\r\n";
+  for (size_t off = 0; off < payload.size(); off += chunk)
+  {
+    std::string part = payload.substr(off, chunk);
+    s += "+CMQTTRXPAYLOAD: " + id + "," + std::to_string(part.size()) + "\r\n" + part + "\r\n";
+  }
+  s += "+CMQTTRXEND: " + id + "\r\n";
+  queue(s, delayMs * 1000UL);
+}
+
+int Sim7600Emulator::storeSms(const std::string &sender, const std::string &body)
+{
+  // Lowest free slot, as the SIM storage reuses deleted ones
+  int index = 0;
+  while (_sms.count(index))
+    index++;
+  _sms[index] = Sms{sender, "24/01/01,12:00:00+00", body};
+  return index;
+}
+
+int Sim7600Emulator::injectSms(const std::string &sender, const std::string &body, uint32_t delayMs)
+{
+  BusyScope busy;
+  int index = storeSms(sender, body);
+  injectUrc("+CMTI: \"SM\"," + std::to_string(index), delayMs);
+  return index;
+}
+
+void Sim7600Emulator::injectConnLost(uint8_t client, int cause, uint32_t delayMs)
+{
+  _mqtt[client & 1].connected = false;
+  injectUrc("+CMQTTCONNLOST: " + std::to_string(client) + "," + std::to_string(cause), delayMs);
+}
+
+void Sim7600Emulator::injectNoNet(uint32_t delayMs)
+{
+  for (MqttClient &c : _mqtt)
+    c = MqttClient();
+  _mqttStarted = false;
+  injectUrc("+CMQTTNONET", delayMs);
+}
+
+// =====================================================
+// OUTPUT TIMELINE
+// Chunks are kept in start-time order and never overlap
+// the chunk before them; with pacing on, bytes trickle
+// out at the UART rate.
+// =====================================================
+unsigned long Sim7600Emulator::byteTimeUs() const
+{
+  return _pacing && _modemBaud ? 10000000UL / _modemBaud : 0;
+}
+
+void Sim7600Emulator::queue(const std::string &bytes, unsigned long delayUs)
+{
+  if (bytes.empty())
+    return;
+
+  unsigned long start = micros() + delayUs;
+  std::deque<Chunk>::iterator it = _out.end();
+  while (it != _out.begin() && (long)((it - 1)->startUs - start) > 0)
+    --it;
+
+  if (it != _out.begin())
+  {
+    const Chunk &prev = *(it - 1);
+    unsigned long prevEnd = prev.startUs + prev.data.size() * byteTimeUs();
+    if ((long)(prevEnd - start) > 0)
+      start = prevEnd;
+  }
+  _out.insert(it, Chunk{bytes, 0, start});
+}
+
+void Sim7600Emulator::release()
+{
+  while (!_out.empty() && _out.front().pos == _out.front().data.size())
+    _out.pop_front();
+}
+
+int Sim7600Emulator::available()
+{
+  BusyScope scope;
+  release();
+  if (_out.empty())
+    return 0;
+
+  const Chunk &c = _out.front();
+  long elapsed = (long)(micros() - c.startUs);
+  if (elapsed < 0)
+    return 0;
+
+  size_t due = c.data.size();
+  unsigned long bt = byteTimeUs();
+  if (bt)
+  {
+    size_t paced = elapsed / bt + 1;
+    if (paced < due)
+      due = paced;
+  }
+  return due > c.pos ? (int)(due - c.pos) : 0;
+}
+
+int Sim7600Emulator::read()
+{
+  BusyScope scope;
+  if (available() <= 0)
+    return -1;
+  _bytesOut++;
+  return (uint8_t)_out.front().data[_out.front().pos++];
+}
+
+int Sim7600Emulator::peek()
+{
+  BusyScope scope;
+  if (available() <= 0)
+    return -1;
+  return (uint8_t)_out.front().data[_out.front().pos];
+}
+
+// =====================================================
+// INPUT FROM THE HOST
+// =====================================================
+size_t Sim7600Emulator::write(uint8_t c)
+{
+  BusyScope scope;
+
+  // Bytes sent at the wrong rate are noise to the modem
+  if (baudRate() && baudRate() != _modemBaud)
+    return 1;
+  _bytesIn++;
+
+  // "\r\n" ends a command once; the LF must not become raw data
+  if (c == '\n' && _lastCr)
+  {
+    _lastCr = false;
+    return 1;
+  }
+  _lastCr = false;
+
+  if (_dataLeft)
+  {
+    _data += (char)c;
+    if (--_dataLeft == 0)
+    {
+      DataHandler h = _dataHandler;
+      _dataHandler = nullptr;
+      if (h)
+        h(*this, _data);
+    }
+    return 1;
+  }
+
+  if (_ctrlZMode)
+  {
+    if (c == 0x1A)
+    {
+      _ctrlZMode = false;
+      _sentSms.push_back(Sms{_smsTo, "", _data});
+      reply("\r\n+CMGS: " + std::to_string(_sentSms.size()) + "\r\n", _networkDelayUs / 1000);
+      ok(_networkDelayUs / 1000);
+    }
+    else
+    {
+      _data += (char)c;
+    }
+    return 1;
+  }
+
+  if (c == '\r' || c == '\n')
+  {
+    _lastCr = (c == '\r');
+    if (!_line.empty())
+    {
+      std::string cmd;
+      cmd.swap(_line);
+      dispatch(cmd);
+    }
+    return 1;
+  }
+  _line += (char)c;
+  return 1;
+}
+
+void Sim7600Emulator::dispatch(const std::string &cmd)
+{
+  _commands.push_back(cmd);
+
+  if (!_failPrefix.empty() && cmd.compare(0, _failPrefix.size(), _failPrefix) == 0)
+  {
+    _failPrefix.clear();
+    error();
+    return;
+  }
+
+  for (size_t i = 0; i < _handlers.size(); i++)
+  {
+    const std::string &prefix = _handlers[i].first;
+    if (cmd.compare(0, prefix.size(), prefix) == 0)
+    {
+      _handlers[i].second(*this, cmd);
+      return;
+    }
+  }
+
+  if (!builtin(cmd))
+    error();
+}
+
+// =====================================================
+// BUILT-IN COMMANDS
+// =====================================================
+static bool startsWith(const std::string &s, const char *prefix)
+{
+  return s.compare(0, strlen(prefix), prefix) == 0;
+}
+
+// Integer argument `n` (0-based) after '='
+static long arg(const std::string &cmd, int n)
+{
+  size_t pos = cmd.find('=');
+  while (pos != std::string::npos && n--)
+    pos = cmd.find(',', pos + 1);
+  return pos == std::string::npos ? -1 : atol(cmd.c_str() + pos + 1);
+}
+
+// First quoted argument
+static std::string quoted(const std::string &cmd)
+{
+  size_t a = cmd.find('"');
+  size_t b = a == std::string::npos ? a : cmd.find('"', a + 1);
+  return b == std::string::npos ? std::string() : cmd.substr(a + 1, b - a - 1);
+}
+
+bool Sim7600Emulator::builtin(const std::string &cmd)
+{
+  if (cmd == "AT" || cmd == "ATE0" || cmd == "ATE1" || cmd == "AT+IFC=2,2" || cmd == "AT+CTZU=1" ||
+      cmd == "AT+CMGF=1" || startsWith(cmd, "AT+CNMI="))
+  {
+    ok();
+    return true;
+  }
+
+  if (startsWith(cmd, "AT+IPR="))
+  {
+    ok();
+    _modemBaud = arg(cmd, 0);
+    return true;
+  }
+
+  if (cmd == "AT+CFUN=1,1")
+  {
+    ok();
+    _modemBaud = 115200;
+    _mqttStarted = false;
+    _mqtt[0] = MqttClient();
+    _mqtt[1] = MqttClient();
+    queue("\r\nRDY\r\n\r\nSMS DONE\r\n\r\nPB DONE\r\n", 1000000UL);
+    return true;
+  }
+
+  if (cmd == "AT+CTZU?")
+  {
+    reply("\r\n+CTZU: 1\r\n\r\nOK\r\n");
+    return true;
+  }
+
+  if (cmd == "AT+CCLK?")
+  {
+    time_t now = time(nullptr);
+    struct tm t;
+    gmtime_r(&now, &t);
+    char buf[64];
+    snprintf(buf, sizeof(buf), "\r\n+CCLK: \"%02d/%02d/%02d,%02d:%02d:%02d+00\"\r\n\r\nOK\r\n",
+             t.tm_year % 100, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec);
+    reply(buf);
+    return true;
+  }
+
+  return mqttCommand(cmd) || smsCommand(cmd) || certCommand(cmd);
+}
+
+// =====================================================
+// MQTT
+// =====================================================
+void Sim7600Emulator::mqttResult(const char *name, uint8_t client, int err)
+{
+  reply(std::string("\r\n+") + name + ": " + std::to_string(client) + "," + std::to_string(err) + "\r\n",
+        _networkDelayUs / 1000);
+}
+
+bool Sim7600Emulator::mqttCommand(const std::string &cmd)
+{
+  if (!startsWith(cmd, "AT+CMQTT"))
+    return false;
+
+  if (cmd == "AT+CMQTTSTART")
+  {
+    ok();
+    reply("\r\n+CMQTTSTART: " + std::string(_mqttStarted ? "23" : "0") + "\r\n");
+    _mqttStarted = true;
+    return true;
+  }
+  if (cmd == "AT+CMQTTSTOP")
+  {
+    ok();
+    reply("\r\n+CMQTTSTOP: 0\r\n");
+    _mqttStarted = false;
+    return true;
+  }
+
+  if (cmd == "AT+CMQTTCONNECT?")
+  {
+    std::string lines;
+    for (int i = 0; i < 2; i++)
+    {
+      lines += "\r\n+CMQTTCONNECT: " + std::to_string(i);
+      if (_mqtt[i].connected)
+        lines += "," + _mqtt[i].server;
+    }
+    reply(lines + "\r\n\r\nOK\r\n");
+    return true;
+  }
+
+  long id = arg(cmd, 0);
+  if (id < 0 || id > 1)
+  {
+    error();
+    return true;
+  }
+  MqttClient &c = _mqtt[id];
+
+  if (startsWith(cmd, "AT+CMQTTACCQ="))
+  {
+    c.acquired = true;
+    ok();
+  }
+  else if (startsWith(cmd, "AT+CMQTTREL="))
+  {
+    c = MqttClient();
+    ok();
+  }
+  else if (startsWith(cmd, "AT+CMQTTCONNECT="))
+  {
+    ok();
+    if (!c.acquired || !_brokerReachable)
+    {
+      mqttResult("CMQTTCONNECT", id, c.acquired ? 3 : 20);
+      return true;
+    }
+    c.connected = true;
+    c.server = cmd.substr(cmd.find(',') + 1);
+    mqttResult("CMQTTCONNECT", id);
+  }
+  else if (startsWith(cmd, "AT+CMQTTDISC="))
+  {
+    ok();
+    c.connected = false;
+    mqttResult("CMQTTDISC", id);
+  }
+  else if (startsWith(cmd, "AT+CMQTTSUBTOPIC=") || startsWith(cmd, "AT+CMQTTUNSUBTOPIC="))
+  {
+    uint8_t qos = startsWith(cmd, "AT+CMQTTSUBTOPIC=") ? arg(cmd, 2) : 0;
+    expectData(arg(cmd, 1), [&c, qos](Sim7600Emulator &m, const std::string &topic)
+               {
+                 c.staged.push_back(std::make_pair(topic, qos));
+                 m.ok();
+               });
+  }
+  else if (startsWith(cmd, "AT+CMQTTSUB="))
+  {
+    ok();
+    for (size_t i = 0; i < c.staged.size(); i++)
+      c.subs.push_back(c.staged[i].first);
+    c.staged.clear();
+    mqttResult("CMQTTSUB", id, c.connected ? 0 : 11);
+  }
+  else if (startsWith(cmd, "AT+CMQTTUNSUB="))
+  {
+    ok();
+    for (size_t i = 0; i < c.staged.size(); i++)
+    {
+      for (size_t j = 0; j < c.subs.size(); j++)
+      {
+        if (c.subs[j] == c.staged[i].first)
+          c.subs.erase(c.subs.begin() + j--);
+      }
+    }
+    c.staged.clear();
+    mqttResult("CMQTTUNSUB", id, c.connected ? 0 : 11);
+  }
+  else if (startsWith(cmd, "AT+CMQTTTOPIC="))
+  {
+    expectData(arg(cmd, 1), [&c](Sim7600Emulator &m, const std::string &topic)
+               {
+                 c.topic = topic;
+                 m.ok();
+               });
+  }
+  else if (startsWith(cmd, "AT+CMQTTPAYLOAD="))
+  {
+    expectData(arg(cmd, 1), [&c](Sim7600Emulator &m, const std::string &payload)
+               {
+                 c.payload = payload;
+                 m.ok();
+               });
+  }
+  else if (startsWith(cmd, "AT+CMQTTPUB="))
+  {
+    ok();
+    if (!c.connected)
+    {
+      mqttResult("CMQTTPUB", id, 11);
+      return true;
+    }
+    _published.push_back(Published{(uint8_t)id, c.topic, c.payload, (uint8_t)arg(cmd, 1), arg(cmd, 3) == 1});
+    mqttResult("CMQTTPUB", id);
+
+    if (_loopback)
+    {
+      for (size_t i = 0; i < c.subs.size(); i++)
+      {
+        if (topicMatches(c.subs[i], c.topic))
+        {
+          injectMqttMessage(id, c.topic, c.payload, 2 * _networkDelayUs / 1000);
+          break;
+        }
+      }
+    }
+  }
+  else
+  {
+    error();
+  }
+  return true;
+}
+
+bool Sim7600Emulator::topicMatches(const std::string &filter, const std::string &topic)
+{
+  size_t f = 0, t = 0;
+  while (f < filter.size())
+  {
+    if (filter[f] == '#')
+      return true;
+    if (filter[f] == '+')
+    {
+      while (t < topic.size() && topic[t] != '/')
+        t++;
+      f++;
+    }
+    else
+    {
+      if (t >= topic.size() || filter[f] != topic[t])
+        return false;
+      f++;
+      t++;
+    }
+  }
+  return t == topic.size();
+}
+
+// =====================================================
+// SMS
+// =====================================================
+bool Sim7600Emulator::smsCommand(const std::string &cmd)
+{
+  if (startsWith(cmd, "AT+CMGS="))
+  {
+    _smsTo = quoted(cmd);
+    _data.clear();
+    _ctrlZMode = true;
+    reply("\r\n> ");
+    return true;
+  }
+
+  if (startsWith(cmd, "AT+CMGR="))
+  {
+    std::map<int, Sms>::iterator it = _sms.find(arg(cmd, 0));
+    if (it == _sms.end())
+    {
+      reply("\r\n+CMS ERROR: 321\r\n");
+      return true;
+    }
+    const Sms &m = it->second;
+    reply("\r\n+CMGR: \"REC UNREAD\",\"" + m.sender + "\",\"\",\"" + m.time + "\"\r\n" + m.body +
+          "\r\n\r\nOK\r\n");
+    return true;
+  }
+
+  if (startsWith(cmd, "AT+CMGD="))
+  {
+    if (arg(cmd, 1) == 4)
+      _sms.clear();
+    else
+      _sms.erase(arg(cmd, 0));
+    ok();
+    return true;
+  }
+
+  return false;
+}
+
+// =====================================================
+// CERTIFICATES
+// =====================================================
+bool Sim7600Emulator::certCommand(const std::string &cmd)
+{
+  if (cmd == "AT+CCERTLIST")
+  {
+    std::string s = "\r\n";
+    for (std::map<std::string, std::string>::const_iterator it = _certs.begin(); it != _certs.end(); ++it)
+      s += "+CCERTLIST: \"" + it->first + "\"\r\n";
+    reply(s + "\r\nOK\r\n");
+    return true;
+  }
+
+  if (startsWith(cmd, "AT+CCERTDOWN="))
+  {
+    std::string name = quoted(cmd);
+    expectData(arg(cmd, 1), [name](Sim7600Emulator &m, const std::string &data)
+               {
+                 m._certs[name] = data;
+                 m.ok();
+               });
+    return true;
+  }
+
+  if (startsWith(cmd, "AT+CCERTDELE="))
+  {
+    if (_certs.erase(quoted(cmd)))
+      ok();
+    else
+      error();
+    return true;
+  }
+
+  return false;
+}
@@ -0,0 +1,187 @@
+#ifndef SIM7600_EMULATOR_H
+#define SIM7600_EMULATOR_H
+
+#include <Arduino.h>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+/* =====================================================
+ * SIM7600 EMULATOR
+ * Host-side stand-in for the modem UART. Commands written
+ * by AT_Lib are answered by built-in handlers for the
+ * basic, MQTT, SMS and certificate command sets, or by
+ * handlers registered with on(). Output is released on a
+ * virtual timeline: a response delay, a network delay for
+ * +CMQTTxxx results, and optional pacing at the UART rate.
+ * ===================================================== */
+class Sim7600Emulator : public HardwareSerial
+{
+public:
+  /* A handler gets the command line without CR/LF */
+  typedef std::function<void(Sim7600Emulator &, const std::string &cmd)> Handler;
+  /* Raw data requested with expectData() */
+  typedef std::function<void(Sim7600Emulator &, const std::string &data)> DataHandler;
+
+  struct Published
+  {
+    uint8_t client;
+    std::string topic;
+    std::string payload;
+    uint8_t qos;
+    bool retained;
+  };
+
+  struct Sms
+  {
+    std::string sender;
+    std::string time;
+    std::string body;
+  };
+
+  Sim7600Emulator();
+
+  /* =================================================
+   * SCRIPTING
+   * ================================================= */
+  /* Handlers run before the built-ins; the first whose prefix
+   * matches the command wins */
+  void on(const std::string &prefix, Handler handler);
+  void clearHandlers() { _handlers.clear(); }
+
+  /* Queues modem output after `delayMs` (plus response delay) */
+  void reply(const std::string &bytes, uint32_t delayMs = 0);
+  void ok(uint32_t delayMs = 0) { reply("\r\nOK\r\n", delayMs); }
+  void error(uint32_t delayMs = 0) { reply("\r\nERROR\r\n", delayMs); }
+  /* Sends '>' and hands the next `n` written bytes to `handler` */
+  void expectData(size_t n, DataHandler handler);
+
+  /* =================================================
+   * UNSOLICITED TRAFFIC
+   * ================================================= */
+  void injectUrc(const std::string &line, uint32_t delayMs = 0);
+  /* Full +CMQTTRXSTART .. +CMQTTRXEND block, payload split into
+   * +CMQTTRXPAYLOAD parts of at most `chunk` bytes */
+  void injectMqttMessage(uint8_t client, const std::string &topic, const std::string &payload,
+                         uint32_t delayMs = 0, size_t chunk = 1024);
+  /* Stores the message without a URC; returns its index */
+  int storeSms(const std::string &sender, const std::string &body);
+  /* Stores the message and announces it with +CMTI; returns its index */
+  int injectSms(const std::string &sender, const std::string &body, uint32_t delayMs = 0);
+  /* Drops the broker link now; the URC follows after `delayMs` */
+  void injectConnLost(uint8_t client, int cause = 3, uint32_t delayMs = 0);
+  /* Drops the network: every client and the MQTT service stop,
+   * announced with +CMQTTNONET */
+  void injectNoNet(uint32_t delayMs = 0);
+
+  /* =================================================
+   * TIMING
+   * ================================================= */
+  void setResponseDelay(uint32_t ms) { _responseDelayUs = ms * 1000UL; }
+  void setNetworkDelay(uint32_t ms) { _networkDelayUs = ms * 1000UL; }
+  /* Releases output no faster than the UART rate set by begin() */
+  void setPacing(bool on) { _pacing = on; }
+
+  /* =================================================
+   * MODEM STATE
+   * ================================================= */
+  void setMqttLoopback(bool on) { _loopback = on; } // echo publishes matching a subscription
+  void setFailNext(const std::string &prefix) { _failPrefix = prefix; }
+  /* Off: AT+CMQTTCONNECT reports a socket connect failure (3) */
+  void setBrokerReachable(bool on) { _brokerReachable = on; }
+  void addCertificate(const std::string &name, const std::string &data = "") { _certs[name] = data; }
+
+  const std::vector<Published> &published() const { return _published; }
+  const std::vector<std::string> &commands() const { return _commands; }
+  const std::map<std::string, std::string> &certificates() const { return _certs; }
+  const std::vector<std::string> &subscriptions(uint8_t client) const { return _mqtt[client & 1].subs; }
+  const std::vector<Sms> &sentSms() const { return _sentSms; }
+  unsigned long modemBaud() const { return _modemBaud; }
+
+  /* True while the emulator itself is running, so allocation
+   * counters can leave its own bookkeeping out */
+  static bool busy() { return _busy > 0; }
+
+  uint32_t bytesFromHost() const { return _bytesIn; }
+  uint32_t bytesToHost() const { return _bytesOut; }
+  void clearLog();
+
+  /* =================================================
+   * STREAM INTERFACE (host side)
+   * ================================================= */
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t write(uint8_t c) override;
+  using Print::write;
+
+private:
+  struct Chunk
+  {
+    std::string data;
+    size_t pos;
+    unsigned long startUs;
+  };
+
+  struct MqttClient
+  {
+    bool acquired = false;
+    bool connected = false;
+    std::string server; // AT+CMQTTCONNECT arguments after the index
+    std::string topic;
+    std::string payload;
+    std::vector<std::pair<std::string, uint8_t>> staged; // SUBTOPIC / UNSUBTOPIC
+    std::vector<std::string> subs;
+  };
+
+  void release();
+  unsigned long byteTimeUs() const;
+  void queue(const std::string &bytes, unsigned long delayUs);
+  void dispatch(const std::string &cmd);
+  bool builtin(const std::string &cmd);
+  bool mqttCommand(const std::string &cmd);
+  bool smsCommand(const std::string &cmd);
+  bool certCommand(const std::string &cmd);
+  void mqttResult(const char *name, uint8_t client, int err = 0);
+  static bool topicMatches(const std::string &filter, const std::string &topic);
+
+  struct BusyScope
+  {
+    BusyScope() { _busy++; }
+    ~BusyScope() { _busy--; }
+  };
+  static int _busy;
+
+  std::vector<std::pair<std::string, Handler>> _handlers;
+  std::deque<Chunk> _out;
+  std::string _line;
+  bool _lastCr = false;
+  size_t _dataLeft = 0;
+  std::string _data;
+  DataHandler _dataHandler;
+  bool _ctrlZMode = false; // AT+CMGS text until 0x1A
+
+  unsigned long _responseDelayUs = 0;
+  unsigned long _networkDelayUs = 0;
+  bool _pacing = false;
+  unsigned long _modemBaud = 115200;
+
+  MqttClient _mqtt[2];
+  bool _mqttStarted = false;
+  bool _loopback = false;
+  bool _brokerReachable = true;
+  std::string _failPrefix;
+  std::map<std::string, std::string> _certs;
+  std::map<int, Sms> _sms;
+  std::string _smsTo;
+  std::vector<Sms> _sentSms;
+
+  std::vector<Published> _published;
+  std::vector<std::string> _commands;
+  uint32_t _bytesIn = 0;
+  uint32_t _bytesOut = 0;
+};
+
+#endif /* SIM7600_EMULATOR_H */
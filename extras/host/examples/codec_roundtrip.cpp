@@ -0,0 +1,128 @@
+// Host run of the payload codecs against the SIM7600 emulator:
+// the same reading goes out as plain JSON, as CBOR and as
+// LZ-framed CBOR on topics with their own codec, comes back
+// through the broker loopback and is checked and decoded on
+// the way in. A payload that breaks its topic's codec is
+// dropped before any handler, and one too large once framed
+// is not sent.
+
+#include "example.h"
+
+static int received = 0;
+static bool decoded = true;
+
+// {"id":7,"temp":[21.5,21.25,..],"ok":true}
+static size_t encodeReading(AT_CborWriter &w, int samples)
+{
+    w.map(3).key("id").integer(7).key("temp").array(samples);
+    for (int i = 0; i < samples; i++)
+        w.number(21.5 - (i % 4) * 0.25);
+    w.key("ok").boolean(true);
+    return w.ok() ? w.length() : 0;
+}
+
+void onJson(const char *topic, const char *payload, uint16_t len)
+{
+    received++;
+}
+
+void onCbor(const char *topic, const char *payload, uint16_t len)
+{
+    AT_CborReader r((const uint8_t *)payload, len);
+    bool ok = r.next() == AT_CBOR_MAP && r.count() == 3;
+    while (ok && r.next() == AT_CBOR_TEXT)
+    {
+        if (r.textEquals("id"))
+            ok = r.next() == AT_CBOR_UINT && r.toInt() == 7;
+        else if (r.textEquals("temp"))
+            ok = r.next() == AT_CBOR_ARRAY && r.skip();
+        else
+            ok = r.next() == AT_CBOR_BOOL && r.toBool();
+    }
+    decoded &= ok;
+    received++;
+}
+
+int main()
+{
+    modem.setMqttLoopback(true);
+    if (!boot())
+        return 1;
+
+    if (!at.setCodec("dev/+/cbor", AT_CODEC_CBOR) ||
+        !at.setCodec("dev/+/cbor.lz", AT_CODEC_CBOR | AT_CODEC_LZ))
+        return 1;
+
+    if (!connect() ||
+        !at.mqttSubscribe(0, "dev/7/json", 1, onJson) ||
+        !at.mqttSubscribe(0, "dev/7/cbor", 1, onCbor) ||
+        !at.mqttSubscribe(0, "dev/7/cbor.lz", 1, onCbor))
+        return 1;
+
+    const int SAMPLES = 60;
+    char json[1024];
+    int jsonLen = snprintf(json, sizeof(json), "{\"id\":7,\"temp\":[");
+    for (int i = 0; i < SAMPLES; i++)
+        jsonLen += snprintf(json + jsonLen, sizeof(json) - jsonLen, "%s%g", i ? "," : "", 21.5 - (i % 4) * 0.25);
+    jsonLen += snprintf(json + jsonLen, sizeof(json) - jsonLen, "],\"ok\":true}");
+
+    uint8_t cbor[512];
+    AT_CborWriter w(cbor, sizeof(cbor));
+    size_t cborLen = encodeReading(w, SAMPLES);
+
+    // Each one is looped back before the next goes out
+    size_t first = modem.published().size();
+    bool sent = at.mqttPublish(0, "dev/7/json", (const uint8_t *)json, jsonLen, 1);
+    pollFor(200);
+    sent = at.mqttPublish(0, "dev/7/cbor", cbor, cborLen, 1) && sent;
+    pollFor(200);
+    sent = at.mqttPublish(0, "dev/7/cbor.lz", cbor, cborLen, 1) && sent;
+    pollFor(200);
+
+    AT_Stats s = at.stats();
+    const std::vector<Sim7600Emulator::Published> &p = modem.published();
+    Serial.printf("[APP] on the air: json %u, cbor %u, cbor+lz %u bytes\n", (unsigned)p[first].payload.size(),
+                  (unsigned)p[first + 1].payload.size(), (unsigned)p[first + 2].payload.size());
+    Serial.printf("[APP] received %d, decoded=%d, lz saved %lu bytes\n", received, decoded,
+                  (unsigned long)s.codecSaved);
+    check(sent && received == 3 && decoded, "each codec round trip decoded");
+    check(p[first + 2].payload.size() < p[first + 1].payload.size() &&
+              p[first + 1].payload.size() < p[first].payload.size(),
+          "cbor smaller than json, lz smaller still");
+
+    // Payloads that break their topic's codec never reach a handler
+    std::string lz = p[first + 2].payload;
+    std::string cut((const char *)cbor, cborLen / 2);
+    modem.injectMqttMessage(0, "dev/7/cbor", "{\"id\":7}", 10);
+    modem.injectMqttMessage(0, "dev/7/cbor", cut, 60);
+    modem.injectMqttMessage(0, "dev/7/cbor.lz", lz.substr(0, lz.size() - 4), 110);
+    modem.injectMqttMessage(0, "dev/7/cbor.lz", std::string("\x7f") + lz.substr(1), 160);
+    pollFor(400);
+    check(received == 3 && at.stats().mqttRxInvalid == 4, "json, cut cbor and broken lz frames dropped");
+
+    // Too large once framed: refused, nothing on the air
+    uint8_t noise[1024];
+    uint32_t x = 2463534242u;
+    for (size_t i = 0; i < sizeof(noise); i++)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        noise[i] = x;
+    }
+    size_t onAir = p.size();
+    check(!at.mqttPublish(0, "dev/7/cbor.lz", noise, sizeof(noise), 1) && p.size() == onAir,
+          "payload too large once framed not sent");
+
+    // Bad filters and a full codec table are refused
+    bool badFilter = !at.setCodec("dev/#/cbor", AT_CODEC_CBOR) && !at.setCodec("", AT_CODEC_CBOR);
+    int routes = 2;
+    char filter[24];
+    for (int i = 0; i < AT_CODEC_ROUTES + 1; i++)
+    {
+        snprintf(filter, sizeof(filter), "dev/%d/cbor", i);
+        routes += at.setCodec(filter, AT_CODEC_CBOR);
+    }
+    check(badFilter && routes == AT_CODEC_ROUTES, "bad filter and full codec table refused");
+    return exitCode();
+}
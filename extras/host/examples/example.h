@@ -0,0 +1,86 @@
+// Shared setup of the host examples: the emulated SIM7600 and the
+// AT_Lib on it, brought up the way a sketch would, and the checks
+// an example reports and exits with.
+
+#ifndef EXAMPLE_H
+#define EXAMPLE_H
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include "AT_lib.h"
+#include "Sim7600Emulator.h"
+
+Sim7600Emulator modem;
+AT_Lib at(modem, Serial);
+
+static const char *const BROKER = "tcp://broker.example:1883";
+static int checkFailures = 0;
+
+static void pollFor(uint32_t ms)
+{
+    uint32_t start = millis();
+    while (millis() - start < ms)
+    {
+        at.poll();
+        delay(1);
+    }
+}
+
+// Polls until `done()` holds or `ms` have passed; returns done()
+template <typename F>
+static bool pollUntil(F done, uint32_t ms)
+{
+    uint32_t start = millis();
+    while (!done())
+    {
+        if (millis() - start >= ms)
+            return false;
+        at.poll();
+        delay(1);
+    }
+    return true;
+}
+
+// Modem booted to PB DONE and answering; commands are answered
+// after `responseMs`, MQTT results after `networkMs`
+static bool boot(uint32_t responseMs = 5, uint32_t networkMs = 40)
+{
+    modem.setResponseDelay(responseMs);
+    modem.setNetworkDelay(networkMs);
+    at.begin(115200, 26, 27);
+    modem.injectUrc("PB DONE", 50);
+    return at.waitForPBDONE(1000) && at.modemReady(1000);
+}
+
+// MQTT service started and client 0 connected to the broker
+static bool connect(const char *clientName = "hostclient")
+{
+    return at.mqttStart() && at.mqttAcquire(0, clientName) && at.mqttConnect(0, BROKER, "", "");
+}
+
+// Commands sent since the `from`-th that start with `prefix`
+static int commandsSince(size_t from, const char *prefix)
+{
+    int n = 0;
+    const std::vector<std::string> &cmds = modem.commands();
+    for (size_t i = from; i < cmds.size(); i++)
+        n += cmds[i].compare(0, strlen(prefix), prefix) == 0;
+    return n;
+}
+
+// Reports one expected behaviour; a failed one makes the exit code 1
+static bool check(bool ok, const char *what)
+{
+    Serial.printf("[APP] %s: %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+        checkFailures++;
+    return ok;
+}
+
+static int exitCode()
+{
+    return checkFailures ? 1 : 0;
+}
+
+#endif /* EXAMPLE_H */
@@ -0,0 +1,148 @@
+// Host run of the MQTT flow from examples/mqtt.ino against the
+// SIM7600 emulator: publishes loop back to matching subscriptions,
+// and an SMS and a connection loss are injected on the way.
+
+#include "example.h"
+
+static int received = 0;
+static int asyncFailed = 0;
+
+void onCommand(const char *topic, const char *payload, uint16_t len)
+{
+    Serial.printf("[APP] %s <- %.*s\n", topic, (int)len, payload);
+    received++;
+}
+
+void onOther(const char *topic, const char *payload, uint16_t len)
+{
+    Serial.printf("[APP] wrong handler for %s\n", topic);
+}
+
+static int subFailed = 0;
+
+void onSubscribed(const AT_Completion &done, void *user)
+{
+    if (!done.ok)
+        subFailed++;
+}
+
+static int smsReceived = 0;
+
+void onSms(const char *sender, const char *timestamp, const char *message)
+{
+    Serial.printf("[APP] SMS from %s at %s: %s\n", sender, timestamp, message);
+    smsReceived++;
+}
+
+void onPublished(const AT_Completion &done, void *user)
+{
+    Serial.printf("[APP] async publish %s (err %d)\n", done.ok ? "ok" : "failed", done.code);
+    if (!done.ok)
+        asyncFailed++;
+}
+
+int main()
+{
+    modem.setPacing(true);
+    modem.setMqttLoopback(true);
+    if (!boot(5, 80))
+        return 1;
+
+    at.onSMSReceived(onSms);
+    at.enableSMS();
+
+    uint32_t start = millis();
+    if (!at.mqttStart() ||
+        !at.mqttAcquire(0, "hostclient") ||
+        !at.mqttConnect(0, BROKER, "user", "pass"))
+        return 1;
+    Serial.printf("[APP] connected in %lu ms\n", millis() - start);
+
+    AT_MqttSub subs[] = {
+        {"dev/+/cmd", 1, onCommand},
+        {"dev/all/#", 0, onCommand},
+    };
+    start = millis();
+    uint8_t n = at.mqttSubscribeMany(0, subs, 2);
+    Serial.printf("[APP] %u topics subscribed in %lu ms\n", n, millis() - start);
+
+    const char *msg = "{\"led\":1}";
+    start = millis();
+    at.mqttPublish(0, "dev/7/cmd", (const uint8_t *)msg, strlen(msg), 1);
+    Serial.printf("[APP] blocking publish in %lu ms\n", millis() - start);
+
+    at.mqttPublishAsync(0, "dev/all/fw", (const uint8_t *)msg, strlen(msg), 0, onPublished);
+    modem.injectSms("+15550100", "hello from the emulator", 30);
+    pollFor(400);
+
+    // An OK where the topic prompt was due fails the publish chain
+    size_t sent = modem.published().size();
+    modem.on("AT+CMQTTTOPIC=", [](Sim7600Emulator &m, const std::string &) { m.ok(); });
+    at.mqttPublishAsync(0, "dev/all/fw", (const uint8_t *)msg, strlen(msg), 0, onPublished);
+    pollFor(100);
+    modem.clearHandlers();
+    check(asyncFailed == 1 && modem.published().size() == sent && at.stats().promptMissing == 1,
+          "publish without a topic prompt failed");
+
+    // An SMS whose AT+CMGR fails is read again; one that cannot be
+    // parsed is counted and left on the SIM
+    modem.setFailNext("AT+CMGR=");
+    modem.injectSms("+15550101", "read on the retry");
+    bool retried = pollUntil([] { return smsReceived == 2 && !at.asyncPending(); }, 500);
+    size_t mark = modem.commands().size();
+    modem.on("AT+CMGR=", [](Sim7600Emulator &m, const std::string &) { m.ok(); });
+    modem.injectSms("+15550102", "not parsed");
+    pollFor(200);
+    modem.clearHandlers();
+    check(retried && smsReceived == 2 && at.stats().smsDropped == 1 && commandsSince(mark, "AT+CMGR=") == 1 &&
+              commandsSince(mark, "AT+CMGD=") == 0,
+          "failed SMS read retried, unparsed one kept");
+
+    // A re-subscribe the broker refuses leaves the old handler and QoS
+    AT_MqttSub again[] = {{"dev/+/cmd", 0, onOther}};
+    modem.setFailNext("AT+CMQTTSUB=");
+    bool refused = at.mqttSubscribeMany(0, again, 1) == 0;
+    const AT_TopicTable::Entry *kept = at.mqttSubscriptions(0).find("dev/+/cmd");
+    check(refused && kept && kept->cb == onCommand && kept->qos == 1, "refused re-subscribe kept the old entry");
+
+    // The same on the async path: a refused new filter is taken out
+    // again, a refused re-subscribe puts the old entry back
+    modem.setFailNext("AT+CMQTTSUB=");
+    at.mqttSubscribeAsync(0, "dev/9/#", 1, onOther, onSubscribed);
+    pollUntil([] { return !at.asyncPending(); }, 500);
+    modem.setFailNext("AT+CMQTTSUB=");
+    at.mqttSubscribeAsync(0, "dev/+/cmd", 0, onOther, onSubscribed);
+    pollUntil([] { return !at.asyncPending(); }, 500);
+    kept = at.mqttSubscriptions(0).find("dev/+/cmd");
+    check(subFailed == 2 && !at.mqttSubscriptions(0).find("dev/9/#") && kept && kept->cb == onCommand &&
+              kept->qos == 1,
+          "refused async subscribes undone");
+
+    // A topic longer than the RX buffer is dropped, not cut and matched
+    int before = received;
+    modem.injectMqttMessage(0, "dev/all/" + std::string(150, 'x'), "{\"long\":1}");
+    pollFor(100);
+    check(received == before && at.stats().mqttRxOverflow == 1, "over-long topic dropped");
+
+    // Two messages arriving during one slow blocking publish both
+    // wait in the RX queue for poll()
+    before = received;
+    modem.setNetworkDelay(300);
+    modem.injectMqttMessage(0, "dev/3/cmd", "{\"n\":1}", 50);
+    modem.injectMqttMessage(0, "dev/4/cmd", "{\"n\":2}", 100);
+    bool published = at.mqttPublish(0, "dev/5/data", (const uint8_t *)msg, strlen(msg), 1);
+    modem.setNetworkDelay(80);
+    bool held = received == before;
+    pollFor(100);
+    check(published && held && received == before + 2 && !at.stats().mqttRxDropped,
+          "messages during a blocking command kept");
+
+    modem.injectConnLost(0, 3, 20);
+    pollFor(100);
+
+    Serial.printf("[APP] messages=%d published=%u state=%d modem rx=%lu tx=%lu bytes\n",
+                  received, (unsigned)modem.published().size(), at.mqttState(0),
+                  (unsigned long)modem.bytesFromHost(), (unsigned long)modem.bytesToHost());
+    check(received == 4, "every message delivered once");
+    return exitCode();
+}
@@ -0,0 +1,112 @@
+// Host run of the MQTT supervisor against the SIM7600 emulator:
+// the link is dropped by a CONNLOST, by a network loss and by a
+// broker that stays away for a while, and each time the client
+// has to come back with its subscriptions without help from the
+// sketch. Retries during the outage are spaced by the backoff,
+// and a client no longer supervised stays down.
+
+#include "example.h"
+
+static int received = 0;
+
+void onCommand(const char *topic, const char *payload, uint16_t len)
+{
+    Serial.printf("[APP] %s <- %.*s\n", topic, (int)len, payload);
+    received++;
+}
+
+// Waits for the drop to be seen and for the supervisor to bring
+// the client back, then checks the subscription by publishing
+// into it
+static bool recovered(const char *what, uint32_t timeoutMs)
+{
+    pollUntil([] { return at.mqttState(0) < MQTT_STATE_SUBSCRIBED; }, 100);
+
+    uint32_t start = millis();
+    if (!pollUntil([] { return at.mqttState(0) >= MQTT_STATE_SUBSCRIBED; }, timeoutMs))
+    {
+        Serial.printf("[APP] %s: not recovered (state %d)\n", what, at.mqttState(0));
+        return false;
+    }
+    Serial.printf("[APP] %s: recovered in %lu ms\n", what, millis() - start);
+
+    int before = received;
+    const char *msg = "{\"ping\":1}";
+    at.mqttPublish(0, "dev/7/cmd", (const uint8_t *)msg, strlen(msg), 1);
+    pollFor(200);
+    return received == before + 1;
+}
+
+int main()
+{
+    modem.setMqttLoopback(true);
+    if (!boot())
+        return 1;
+
+    AT_MqttSession session;
+    session.clientName = "hostclient";
+    session.uri = BROKER;
+    session.backoffMinMs = 50;
+    session.backoffMaxMs = 400;
+    session.checkIntervalMs = 500;
+
+    // Nothing to reconnect with
+    AT_MqttSession unnamed = session;
+    unnamed.clientName = nullptr;
+    check(!at.mqttSupervise(0, unnamed), "session without a client name refused");
+
+    // A client the supervisor connects from scratch has not been
+    // brought back: its first connect is no reconnect
+    AT_MqttSession spare = session;
+    spare.clientName = "hostspare";
+    if (!at.mqttStart() || !at.mqttSupervise(1, spare))
+        return 1;
+    bool spareUp = pollUntil([] { return at.mqttState(1) >= MQTT_STATE_CONNECTED; }, 2000);
+    check(spareUp && at.stats().mqttReconnects == 0, "first supervised connect not counted");
+    at.mqttUnsupervise(1);
+    if (!at.mqttDisconnect(1))
+        return 1;
+
+    AT_MqttSub subs[] = {
+        {"dev/+/cmd", 1, onCommand},
+        {"dev/all/#", 0, onCommand},
+    };
+    if (!at.mqttAcquire(0, session.clientName) ||
+        !at.mqttConnect(0, session.uri, session.user, session.pass) ||
+        at.mqttSubscribeMany(0, subs, 2) != 2 ||
+        !at.mqttSupervise(0, session))
+        return 1;
+
+    modem.injectConnLost(0, 3, 20);
+    check(recovered("connection lost", 2000), "back after a CONNLOST");
+
+    modem.injectNoNet(20);
+    check(recovered("network lost", 2000), "back after a network loss");
+
+    // Attempts back off towards backoffMaxMs, and the client is
+    // released and acquired anew after AT_MQTT_RELEASE_AFTER of them
+    size_t mark = modem.commands().size();
+    modem.setBrokerReachable(false);
+    modem.injectConnLost(0, 1, 20);
+    pollFor(1500);
+    int attempts = commandsSince(mark, "AT+CMQTTCONNECT=");
+    Serial.printf("[APP] %d connect attempts in a 1500 ms outage\n", attempts);
+    check(attempts >= AT_MQTT_RELEASE_AFTER && attempts <= 1500 / 100, "retries spaced by the backoff");
+    check(commandsSince(mark, "AT+CMQTTREL=") >= 1, "client released after repeated failures");
+    modem.setBrokerReachable(true);
+    check(recovered("broker outage", 3000), "back after a broker outage");
+
+    // Without the supervisor nobody reconnects
+    at.mqttUnsupervise(0);
+    mark = modem.commands().size();
+    modem.injectConnLost(0, 3, 20);
+    bool stayedDown = pollUntil([] { return at.mqttState(0) < MQTT_STATE_CONNECTED; }, 200) &&
+                      !pollUntil([] { return at.mqttState(0) >= MQTT_STATE_CONNECTED; }, 1000);
+    check(stayedDown && commandsSince(mark, "AT+CMQTTCONNECT=") == 0, "unsupervised client left down");
+
+    AT_Stats s = at.stats();
+    Serial.printf("[APP] messages=%d link_lost=%lu reconnects=%lu\n", received, (unsigned long)s.mqttLinkLost,
+                  (unsigned long)s.mqttReconnects);
+    check(s.mqttLinkLost == 4 && s.mqttReconnects == 3, "drops and reconnects counted");
+    return exitCode();
+}
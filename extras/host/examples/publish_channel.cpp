@@ -0,0 +1,154 @@
+// Host run of publish channels against the SIM7600 emulator: the
+// same readings go out through mqttPublishAsync() and through a
+// channel opened once, which skips the per-topic checks and line
+// rendering. A retained channel keeps its flag on the wire and
+// through the outbox while the broker is away. Channels that
+// cannot be opened, are closed or get no answer refuse the
+// publish, and a codec set later still applies to an open one.
+
+#include "example.h"
+
+AT_OutboxRam<4096> outboxStore;
+AT_Outbox outbox(outboxStore);
+
+static const int READINGS = 200;
+static int acked = 0;
+static int failed = 0;
+
+void onPublished(const AT_Completion &done, void *user)
+{
+    if (done.ok)
+        acked++;
+    else
+        failed++;
+}
+
+// Queues READINGS publishes one at a time and returns the time
+// spent inside the publish calls, in microseconds
+static unsigned long readings(AT_PublishChannel *channel)
+{
+    unsigned long spent = 0;
+    acked = 0;
+    for (int i = 0; i < READINGS; i++)
+    {
+        char msg[24];
+        int len = snprintf(msg, sizeof(msg), "{\"n\":%d}", i);
+        unsigned long t0 = micros();
+        bool queued = channel ? at.publishAsync(*channel, (const uint8_t *)msg, len, onPublished)
+                              : at.mqttPublishAsync(0, "dev/7/data", (const uint8_t *)msg, len, 1, onPublished);
+        spent += micros() - t0;
+        if (!queued)
+            return 0;
+        while (at.asyncPending())
+        {
+            at.poll();
+            delay(1);
+        }
+    }
+    return spent;
+}
+
+int main()
+{
+    if (!boot(1, 2))
+        return 1;
+
+    AT_MqttSession session;
+    session.clientName = "hostclient";
+    session.uri = BROKER;
+    session.backoffMinMs = 50;
+    session.backoffMaxMs = 200;
+
+    AT_PublishChannel data, state;
+    if (!connect(session.clientName) ||
+        !at.mqttSupervise(0, session) ||
+        !outbox.begin() ||
+        !at.openChannel(data, 0, "dev/7/data", 1) ||
+        !at.openChannel(state, 0, "dev/7/state", 1, true))
+        return 1;
+    at.setOutbox(&outbox);
+
+    unsigned long plain = readings(nullptr);
+    int plainAcked = acked;
+    unsigned long channel = readings(&data);
+    int channelAcked = acked;
+    Serial.printf("[APP] per publish call: mqttPublishAsync %.2f us, channel %.2f us (%d + %d acknowledged)\n",
+                  (double)plain / READINGS, (double)channel / READINGS, plainAcked, channelAcked);
+
+    // Both ways put the same messages on the wire
+    const std::vector<Sim7600Emulator::Published> &pub = modem.published();
+    bool same = pub.size() == 2 * READINGS;
+    for (size_t i = 0; same && i < READINGS; i++)
+        same = pub[i].topic == pub[i + READINGS].topic && pub[i].payload == pub[i + READINGS].payload &&
+               pub[i].qos == pub[i + READINGS].qos && !pub[i].retained && !pub[i + READINGS].retained;
+
+    // Retained: published directly, then stored during an outage
+    const char *online = "{\"state\":\"online\"}";
+    const char *resumed = "{\"state\":\"resumed\"}";
+    bool direct = at.publish(state, (const uint8_t *)online, strlen(online)) && modem.published().back().retained;
+
+    modem.setBrokerReachable(false);
+    modem.injectConnLost(0, 1, 0);
+    pollFor(50);
+    bool stored = at.publish(state, (const uint8_t *)resumed, strlen(resumed)) && outbox.depth() == 1;
+    modem.setBrokerReachable(true);
+    pollUntil([] { return !outbox.depth(); }, 5000);
+    pollFor(100);
+    bool drained = !outbox.depth() && modem.published().back().payload == resumed &&
+                   modem.published().back().retained;
+
+    check(plain && channel && plainAcked == READINGS && channelAcked == READINGS, "both ways acknowledged");
+    check(same, "same messages on the wire");
+    check(direct, "retained flag kept on a direct publish");
+    check(stored && drained, "retained flag kept through the outbox");
+
+    // Channels that cannot be opened stay closed and refuse publishes
+    AT_PublishChannel bad;
+    char longTopic[AT_PublishChannel::TOPIC_MAX + 2];
+    memset(longTopic, 'x', sizeof(longTopic) - 1);
+    longTopic[sizeof(longTopic) - 1] = '\0';
+    bool refused = !at.openChannel(bad, 0, "", 1) && !at.openChannel(bad, 0, longTopic, 1) &&
+                   !at.openChannel(bad, 0, "dev/7/data", 3) && !bad.isOpen() &&
+                   !at.publish(bad, (const uint8_t *)online, strlen(online));
+    AT_PublishChannel closed;
+    refused = at.openChannel(closed, 0, "dev/7/data", 1) && refused;
+    closed.close();
+    refused = !at.publish(closed, (const uint8_t *)online, strlen(online)) &&
+              !at.publishAsync(closed, (const uint8_t *)online, strlen(online), onPublished) && refused;
+    check(refused, "invalid and closed channels refuse publishes");
+
+    // A codec set after the channel was opened applies to it
+    if (!at.setCodec("dev/+/data", AT_CODEC_JSON | AT_CODEC_LZ))
+        return 1;
+    bool framed = at.publish(data, (const uint8_t *)online, strlen(online)) &&
+                  modem.published().back().payload != online;
+    at.setCodec("dev/+/data", AT_CODEC_JSON);
+    framed = at.publish(data, (const uint8_t *)online, strlen(online)) &&
+             modem.published().back().payload == online && framed;
+    check(framed, "codec changes picked up by an open channel");
+
+    // No outbox and no broker: the async publish fails in its callback
+    at.setOutbox(nullptr);
+    modem.setBrokerReachable(false);
+    modem.injectConnLost(0, 1, 0);
+    pollFor(50);
+    acked = failed = 0;
+    bool queued = at.publishAsync(data, (const uint8_t *)online, strlen(online), onPublished);
+    check(queued && pollUntil([] { return acked + failed == 1; }, 1000) && failed == 1,
+          "publish without a link fails");
+    modem.setBrokerReachable(true);
+    pollUntil([] { return at.mqttState(0) >= MQTT_STATE_CONNECTED; }, 2000);
+
+    // No answer to the publish: a channel's own timeout ends the wait
+    AT_PublishChannel quick;
+    if (!at.openChannel(quick, 0, "dev/7/data", 1, false, 200))
+        return 1;
+    modem.on("AT+CMQTTPUB=", [](Sim7600Emulator &, const std::string &) {});
+    uint32_t start = millis();
+    bool timedOut = !at.publish(quick, (const uint8_t *)online, strlen(online));
+    uint32_t waited = millis() - start;
+    modem.clearHandlers();
+    Serial.printf("[APP] unanswered publish gave up after %lu ms\n", (unsigned long)waited);
+    check(timedOut && waited >= 200 && waited < 1000, "channel timeout ends an unanswered publish");
+    return exitCode();
+}
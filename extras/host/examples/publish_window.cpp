@@ -0,0 +1,133 @@
+// Host run of pipelined publishing against the SIM7600 emulator:
+// the same burst of QoS 1 publishes goes out one at a time and
+// then with a window of four, where the next topic and payload
+// are loaded while the broker acknowledges the previous ones.
+// A publish whose result times out is sent again until its
+// retries run out, and a lost link fails the ones in flight.
+
+#include "example.h"
+
+static const int BURST = 40;
+static int acked = 0;
+static int failed = 0;
+static int lastCode = 0;
+
+void onPublished(const AT_Completion &done, void *user)
+{
+    if (done.ok)
+        acked++;
+    else
+        failed++;
+    lastCode = done.code;
+}
+
+static bool publish(const char *msg)
+{
+    return at.mqttPublishAsync(0, "dev/7/data", (const uint8_t *)msg, strlen(msg), 1, onPublished);
+}
+
+// Publishes BURST readings, keeping `window` of them unacknowledged
+// at most, and returns the time until the last one was acknowledged
+static uint32_t burst(uint8_t window)
+{
+    if (!at.setPublishWindow(window))
+        return 0;
+
+    acked = failed = 0;
+    uint32_t start = millis();
+    for (int i = 0; i < BURST && millis() - start < 20000;)
+    {
+        char msg[24];
+        snprintf(msg, sizeof(msg), "{\"n\":%d}", i);
+        if (i - acked - failed < window && at.asyncPending() + 3 <= AT_ASYNC_QUEUE_LEN && publish(msg))
+            i++;
+        at.poll();
+        delay(1);
+    }
+    pollUntil([] { return acked + failed >= BURST; }, 20000 - (millis() - start));
+    uint32_t ms = millis() - start;
+    Serial.printf("[APP] window %u: %d/%d acknowledged in %lu ms\n", window, acked, BURST, (unsigned long)ms);
+    return acked == BURST ? ms : 0;
+}
+
+// Answers each publish; the next `timeouts` results report
+// SIM76xx_MQTT_TIMEOUT (17), every one of them while it is -1
+static int timeouts = 0;
+
+static void timingOut(Sim7600Emulator &m, const std::string &cmd)
+{
+    m.ok();
+    m.reply(timeouts ? "\r\n+CMQTTPUB: 0,17\r\n" : "\r\n+CMQTTPUB: 0,0\r\n", 40);
+    if (timeouts > 0)
+        timeouts--;
+}
+
+int main()
+{
+    if (!boot() || !connect())
+        return 1;
+
+    uint32_t serial = burst(1);
+    uint32_t pipelined = burst(4);
+    Serial.printf("[APP] speedup %.1fx\n", pipelined ? (double)serial / pipelined : 0.0);
+    check(serial && pipelined && pipelined < serial, "window of four faster than one at a time");
+
+    // A blocking publish after the pipelined ones gets its own result
+    const char *msg = "{\"last\":1}";
+    check(at.mqttPublish(0, "dev/7/data", (const uint8_t *)msg, strlen(msg), 1), "blocking publish after the window");
+
+    // A slow broker: the pipelined results take longer than the
+    // blocking publish's own timeout, which must still wait them out
+    modem.setNetworkDelay(800);
+    acked = failed = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        publish(msg);
+        pollUntil([] { return !at.asyncPending(); }, 1000);
+    }
+    modem.setNetworkDelay(40);
+    bool slow = at.mqttPublish(0, "dev/7/data", (const uint8_t *)msg, strlen(msg), 1, 300) && acked == 4;
+    check(slow, "blocking publish after a slow broker");
+    check(modem.published().size() == 2 * BURST + 6, "every publish on the air once");
+
+    // Bounds of the window
+    check(!at.setPublishWindow(0) && !at.setPublishWindow(AT_MQTT_PUB_WINDOW_MAX + 1), "window out of range refused");
+    if (!at.setPublishWindow(2))
+        return 1;
+    acked = failed = 0;
+    bool full = publish(msg) && publish(msg) && !publish(msg);
+    check(full && !at.setPublishWindow(4), "window full, and kept while publishes are in flight");
+    pollUntil([] { return acked + failed == 2; }, 2000);
+
+    // A timed-out result is sent again, and fails once the retries
+    // (AT_MQTT_PUB_RETRIES) are used up
+    modem.on("AT+CMQTTPUB=", timingOut);
+    AT_Stats before = at.stats();
+    acked = failed = 0;
+    timeouts = 1;
+    publish(msg);
+    bool retried = pollUntil([] { return acked + failed == 1; }, 2000) && acked == 1 &&
+                   at.stats().mqttPubRetries == before.mqttPubRetries + 1;
+    check(retried, "timed-out publish sent again");
+
+    acked = failed = 0;
+    timeouts = -1;
+    publish(msg);
+    bool gaveUp = pollUntil([] { return acked + failed == 1; }, 2000) && failed == 1 && lastCode == 17 &&
+                  at.stats().mqttPubRetries == before.mqttPubRetries + 1 + AT_MQTT_PUB_RETRIES;
+    check(gaveUp, "publish failed once its retries ran out");
+
+    // No result comes; the link goes with both publishes in flight
+    modem.clearHandlers();
+    modem.on("AT+CMQTTPUB=", [](Sim7600Emulator &m, const std::string &) { m.ok(); });
+    acked = failed = 0;
+    publish(msg);
+    publish(msg);
+    pollUntil([] { return !at.asyncPending(); }, 1000);
+    modem.injectConnLost(0, 3, 0);
+    bool lost = pollUntil([] { return failed == 2; }, 1000) && !acked && lastCode == 11 && !at.publishesInFlight();
+    check(lost, "lost link fails the publishes in flight");
+    modem.clearHandlers();
+
+    return exitCode();
+}
@@ -0,0 +1,150 @@
+// Host run of the store-and-forward outbox against the SIM7600
+// emulator: readings published while the broker is unreachable
+// are kept in a RAM outbox, found again after a reset, and arrive
+// in order once the supervisor has the client back, interleaved
+// with live ones and through another drop of the link. A record
+// the broker refuses is dropped, and a full outbox refuses the
+// newest publish.
+
+#include "example.h"
+
+AT_OutboxRam<16384> outboxStore;
+AT_Outbox outbox(outboxStore);
+
+static int stored = 0;
+static int nextStored = 0; // next reading expected back, in order
+static int live = 0;
+static int late = 0;
+static bool inOrder = true;
+
+void onReading(const char *topic, const char *payload, uint16_t len)
+{
+    int n = atoi(payload + 5); // {"n":<n>}
+    if (strcmp(topic, "dev/7/live") == 0)
+    {
+        live++;
+        return;
+    }
+    if (strcmp(topic, "dev/7/late") == 0)
+    {
+        late++;
+        return;
+    }
+    inOrder &= n == nextStored;
+    nextStored = n + 1;
+}
+
+static bool publish(const char *topic, int n)
+{
+    char msg[24];
+    int len = snprintf(msg, sizeof(msg), "{\"n\":%d}", n);
+    return at.mqttPublishAsync(0, topic, (const uint8_t *)msg, len, 1, nullptr);
+}
+
+static void outage()
+{
+    modem.setBrokerReachable(false);
+    modem.injectConnLost(0, 1, 0);
+    pollFor(50);
+}
+
+static bool drained(AT_Outbox &box, uint32_t ms)
+{
+    return pollUntil([&box] { return box.depth() == 0 && !at.asyncPending(); }, ms);
+}
+
+int main()
+{
+    modem.setMqttLoopback(true);
+    if (!boot())
+        return 1;
+
+    AT_MqttSession session;
+    session.clientName = "hostclient";
+    session.uri = BROKER;
+    session.backoffMinMs = 50;
+    session.backoffMaxMs = 200;
+
+    if (!connect(session.clientName) ||
+        !at.mqttSubscribe(0, "dev/7/#", 1, onReading) ||
+        !at.mqttSupervise(0, session) ||
+        !outbox.begin())
+        return 1;
+    at.setOutbox(&outbox, 20);
+
+    // Outage: every reading goes to the outbox
+    outage();
+    for (int i = 0; i < 30; i++, stored++)
+    {
+        publish("dev/7/stored", i);
+        pollFor(20);
+    }
+    Serial.printf("[APP] outage over, %lu stored\n", (unsigned long)outbox.depth());
+
+    // A reset: a new outbox over the same storage finds them all
+    AT_Outbox restarted(outboxStore);
+    check(restarted.begin() && restarted.depth() == (uint32_t)stored, "stored readings found after a reset");
+    at.setOutbox(&restarted, 20);
+
+    // Back: the backlog drains while live readings keep going,
+    // and a link lost halfway loses none of it
+    modem.setBrokerReachable(true);
+    uint32_t start = millis();
+    bool dropped = false;
+    for (int i = 0; restarted.depth() && millis() - start < 10000; i++)
+    {
+        if (at.mqttState(0) >= MQTT_STATE_CONNECTED && i % 25 == 0)
+            publish("dev/7/live", i);
+        if (!dropped && restarted.depth() <= (uint32_t)stored / 2)
+        {
+            modem.injectConnLost(0, 3, 0);
+            dropped = true;
+        }
+        pollFor(10);
+    }
+    pollFor(300);
+    Serial.printf("[APP] drained in %lu ms, stored back %d/%d, live %d\n", millis() - start, nextStored, stored,
+                  live);
+    check(dropped && inOrder && nextStored == stored && live > 0, "backlog delivered in order around a drop");
+
+    // A record the broker refuses with the link up is dropped; the
+    // ones behind it still go
+    AT_Stats before = at.stats();
+    outage();
+    for (int i = 0; i < 3; i++)
+        publish("dev/7/late", i);
+    modem.setFailNext("AT+CMQTTPUB=");
+    modem.setBrokerReachable(true);
+    drained(restarted, 5000);
+    pollFor(200);
+    AT_Stats after = at.stats();
+    check(late == 2 && after.outboxDropped == before.outboxDropped + 1 && after.outboxSent == before.outboxSent + 2,
+          "refused record dropped, the rest sent");
+
+    // Full storage with AT_OUTBOX_DROP_NEWEST: the newest publish is
+    // refused to the caller and counted
+    AT_OutboxRam<256> smallStore;
+    AT_Outbox small(smallStore, AT_OUTBOX_DROP_NEWEST);
+    if (!small.begin())
+        return 1;
+    at.setOutbox(&small, 20);
+    before = at.stats();
+    outage();
+    int accepted = 0;
+    for (int i = 0; i < 20; i++)
+        accepted += publish("dev/7/full", i);
+    after = at.stats();
+    Serial.printf("[APP] small outbox took %d of 20\n", accepted);
+    check(accepted > 0 && accepted < 20 && small.depth() == (uint32_t)accepted &&
+              after.outboxDropped - before.outboxDropped == (uint32_t)(20 - accepted),
+          "full outbox refuses the newest");
+    modem.setBrokerReachable(true);
+    check(drained(small, 5000), "small outbox drained");
+
+    AT_Stats s = at.stats();
+    char json[1024];
+    AT_statsToJson(s, json, sizeof(json));
+    Serial.printf("[APP] %s\n", strstr(json, "\"outbox_stored\""));
+    check(s.outboxSent == (uint32_t)(stored + 2 + accepted) && !s.outboxDepth, "every stored publish accounted");
+    return exitCode();
+}
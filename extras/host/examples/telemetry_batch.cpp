@@ -0,0 +1,113 @@
+// Host run of telemetry batching against the SIM7600 emulator:
+// two sensors record a reading every 10 ms, first published one
+// message per reading, then through record() as one batched
+// message per topic and window. Every sample has to arrive,
+// also from a batch that only its window sends and one held
+// while the link is down; samples without room are refused.
+
+#include <algorithm>
+#include "example.h"
+
+AT_Telemetry telemetry(AT_TELEMETRY_FLUSH_BYTES, 500);
+
+static const int SAMPLES = 300; // per sensor
+
+// Samples in the published batches: one "[dt,value]" each,
+// inside the "s" array
+static size_t countSamples(size_t from)
+{
+    size_t n = 0;
+    for (size_t i = from; i < modem.published().size(); i++)
+    {
+        const std::string &p = modem.published()[i].payload;
+        n += std::count(p.begin(), p.end(), '[') - 1;
+    }
+    return n;
+}
+
+int main()
+{
+    if (!boot() || !connect())
+        return 1;
+
+    // One publish per reading, as fast as the modem takes them
+    uint32_t bytes = at.stats().bytesOut;
+    uint32_t start = millis();
+    for (int i = 0; i < 50; i++)
+    {
+        char msg[24];
+        int len = snprintf(msg, sizeof(msg), "{\"v\":%.2f}", 20 + i * 0.01);
+        at.mqttPublish(0, "dev/7/temp", (const uint8_t *)msg, len, 1);
+    }
+    double directMs = (double)(millis() - start) / 50;
+    double directBytes = (double)(at.stats().bytesOut - bytes) / 50;
+
+    // Batched
+    check(!at.record("dev/7/temp", 1.0), "no sample taken before setTelemetry()");
+    at.setTelemetry(&telemetry, 0, 1);
+    size_t first = modem.published().size();
+    bytes = at.stats().bytesOut;
+    for (int i = 0; i < SAMPLES; i++)
+    {
+        at.record("dev/7/temp", 20 + i * 0.01);
+        at.record("dev/7/rpm", 1200 + i);
+        pollFor(10);
+    }
+    at.flushTelemetry();
+    pollFor(500);
+
+    AT_Stats s = at.stats();
+    size_t messages = modem.published().size() - first;
+    size_t arrived = countSamples(first);
+    double batchedBytes = (double)(s.bytesOut - bytes) / (2 * SAMPLES);
+    Serial.printf("[APP] direct: %.0f UART bytes and %.0f ms per reading\n", directBytes, directMs);
+    Serial.printf("[APP] batched: %u samples in %u messages, %.1f UART bytes per sample (%.0fx fewer)\n",
+                  (unsigned)arrived, (unsigned)messages, batchedBytes, directBytes / batchedBytes);
+    check(arrived == 2 * SAMPLES && s.telemetrySamples == 2 * SAMPLES && !s.telemetryDropped &&
+              messages == s.telemetryBatches && messages * 10 < arrived,
+          "every sample batched and delivered");
+
+    // No flush: the batch waits for its 500 ms window, then goes
+    first = modem.published().size();
+    start = millis();
+    at.record("dev/7/slow", 1L);
+    at.record("dev/7/slow", millis());
+    at.record("dev/7/slow", (uint32_t)4000000000UL);
+    pollFor(300);
+    bool held = modem.published().size() == first;
+    bool sent = pollUntil([first] { return modem.published().size() > first; }, 1000);
+    Serial.printf("[APP] window batch sent after %lu ms\n", millis() - start);
+    check(held && sent && millis() - start >= 500 && countSamples(first) == 3, "batch sent by its window");
+    check(sent && modem.published().back().payload.find(",4000000000]") != std::string::npos,
+          "unsigned sample recorded as is");
+
+    // No room: every topic slot holds samples, or the topic is too long
+    char topic[AT_TELEMETRY_TOPIC_MAX + 8];
+    for (int i = 0; i < AT_TELEMETRY_TOPICS; i++)
+    {
+        snprintf(topic, sizeof(topic), "dev/7/s%d", i);
+        at.record(topic, (long)i);
+    }
+    bool refused = !at.record("dev/7/extra", 1L);
+    memset(topic, 'x', sizeof(topic) - 1);
+    topic[sizeof(topic) - 1] = '\0';
+    refused = !at.record(topic, 1L) && refused;
+    check(refused && at.stats().telemetryDropped == 2, "samples without room refused and counted");
+    at.flushTelemetry();
+    pollFor(300);
+
+    // Link down and no outbox: the batch is held, then sent once
+    // the client is back
+    modem.injectConnLost(0, 3, 0);
+    pollUntil([] { return at.mqttState(0) < MQTT_STATE_CONNECTED; }, 500);
+    first = modem.published().size();
+    for (int i = 0; i < 10; i++)
+        at.record("dev/7/temp", 30 + i * 0.1);
+    at.flushTelemetry();
+    pollFor(700);
+    held = modem.published().size() == first && telemetry.pending() == 10;
+    bool back = at.mqttConnect(0, BROKER, "", "");
+    sent = back && pollUntil([first] { return countSamples(first) == 10; }, 1000);
+    check(held && sent && at.stats().telemetryDropped == 2, "batch held while the link is down");
+    return exitCode();
+}
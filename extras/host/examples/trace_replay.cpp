@@ -0,0 +1,135 @@
+// Records an MQTT + SMS session against the SIM7600 emulator with
+// AT_TraceRecorder, then replays the trace through a fresh AT_Lib.
+//
+//   trace_replay                 record, then replay
+//   trace_replay -o <file>       the same, saving the recording
+//   trace_replay <file> [loops]  poll-only replay of a saved trace,
+//                                e.g. one dumped from a device; URCs
+//                                and MQTT RX only, command responses
+//                                are passed over
+
+#include <Arduino.h>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include "AT_lib.h"
+#include "Sim7600Emulator.h"
+
+static int received = 0;
+static int smsReceived = 0;
+
+static void onMessage(const char *topic, const char *payload, uint16_t len)
+{
+    received++;
+}
+
+static void onSms(const char *sender, const char *timestamp, const char *message)
+{
+    smsReceived++;
+}
+
+// The same calls drive the recording and the replay
+static bool session(AT_Lib &at)
+{
+    at.setLogLevel(AT_LOG_WARN);
+    at.onSMSReceived(onSms);
+    if (!at.mqttStart() ||
+        !at.mqttAcquire(0, "tracer") ||
+        !at.mqttConnect(0, "tcp://broker.example:1883", "", "") ||
+        !at.mqttSubscribe(0, "trace/#", 0, onMessage))
+        return false;
+
+    const char *msg = "{\"seq\":1}";
+    for (int i = 0; i < 5; i++)
+    {
+        at.mqttPublish(0, "trace/loop", (const uint8_t *)msg, strlen(msg), 0);
+        for (uint32_t start = millis(); millis() - start < 100;)
+            at.poll();
+    }
+    return true;
+}
+
+// Also waits out the SMS delete queued on receipt, so it is in
+// the recording and the replay writes nothing past it
+static void pollUntil(AT_Lib &at, int messages, uint32_t ms)
+{
+    uint32_t start = millis();
+    while ((received < messages || smsReceived < 1 || at.asyncPending()) && millis() - start < ms)
+        at.poll();
+}
+
+static int replay(const std::vector<uint8_t> &image, int loops)
+{
+    unsigned long start = micros();
+    unsigned long bytes = 0;
+    for (int i = 0; i < loops; i++)
+    {
+        AT_TraceReplay port(image.data(), image.size());
+        if (!port.valid())
+        {
+            printf("not a trace image\n");
+            return 1;
+        }
+        port.setGateOnTx(false);
+
+        AT_Lib at(port, Serial);
+        at.setLogLevel(AT_LOG_NONE);
+        at.onMQTTReceived(onMessage);
+        at.onSMSReceived(onSms);
+        while (!port.done())
+            at.poll();
+        at.poll();
+        bytes += at.stats().bytesIn;
+    }
+    double s = (micros() - start) / 1e6;
+    printf("replayed %d x %u bytes: %d messages, %d SMS, %.1f MB/s parse rate\n",
+           loops, (unsigned)image.size(), received, smsReceived, bytes / s / 1e6);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *save = argc > 2 && strcmp(argv[1], "-o") == 0 ? argv[2] : nullptr;
+    if (argc > 1 && !save)
+    {
+        std::ifstream in(argv[1], std::ios::binary);
+        std::vector<uint8_t> image((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        return replay(image, argc > 2 ? atoi(argv[2]) : 1);
+    }
+
+    // ---------------- record ----------------
+    static AT_TraceBuffer<8192> trace;
+    Sim7600Emulator modem;
+    modem.setResponseDelay(2);
+    modem.setNetworkDelay(30);
+    modem.setMqttLoopback(true);
+
+    AT_Lib live(modem, Serial);
+    live.begin(115200, -1, -1);
+    live.setTrace(&trace);
+    if (!session(live))
+        return 1;
+    modem.injectSms("+15550100", "traced message", 20);
+    pollUntil(live, 5, 2000);
+
+    std::vector<uint8_t> image(trace.imageSize());
+    trace.copy(image.data(), image.size());
+    if (save)
+        std::ofstream(save, std::ios::binary).write((const char *)image.data(), image.size());
+    printf("recorded %u bytes (%lu dropped), %d messages, %d SMS\n",
+           (unsigned)image.size(), (unsigned long)trace.dropped(), received, smsReceived);
+
+    // ---------------- replay ----------------
+    int liveMessages = received;
+    received = smsReceived = 0;
+
+    AT_TraceReplay port(image.data(), image.size());
+    AT_Lib replayed(port, Serial);
+    if (!session(replayed))
+        return 1;
+    pollUntil(replayed, 5, 2000);
+
+    printf("replayed: %d messages, %d SMS, %lu TX mismatches, %lu extra TX bytes\n",
+           received, smsReceived, (unsigned long)port.mismatches(), (unsigned long)port.extraTx());
+    return received == liveMessages && smsReceived == 1 && port.mismatches() == 0 && port.extraTx() == 0 ? 0 : 1;
+}
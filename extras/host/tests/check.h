@@ -0,0 +1,29 @@
+// Minimal assertions for the host tests: a failed CHECK() prints
+// the expression and carries on, checkResult() is main()'s exit
+// code. Run them all with ctest from the host build directory.
+
+#ifndef AT_HOST_CHECK_H
+#define AT_HOST_CHECK_H
+
+#include <stdio.h>
+
+static int checkFailures = 0;
+
+#define CHECK(cond)                                                        \
+    do                                                                     \
+    {                                                                      \
+        if (!(cond))                                                       \
+        {                                                                  \
+            fprintf(stderr, "%s:%d: CHECK(%s)\n", __FILE__, __LINE__, #cond); \
+            checkFailures++;                                               \
+        }                                                                  \
+    } while (0)
+
+static inline int checkResult()
+{
+    if (checkFailures)
+        fprintf(stderr, "%d check(s) failed\n", checkFailures);
+    return checkFailures ? 1 : 0;
+}
+
+#endif
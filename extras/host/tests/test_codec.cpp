@@ -0,0 +1,113 @@
+// Payload codecs: CBOR writer / reader, well-formedness, the LZ
+// frame and the per-format checks
+
+#include "AT_codec.h"
+#include "check.h"
+#include <initializer_list>
+#include <stdlib.h>
+
+static bool wellFormed(std::initializer_list<uint8_t> bytes)
+{
+    return AT_CborReader::wellFormed(bytes.begin(), bytes.size());
+}
+
+static void cbor()
+{
+    uint8_t buf[128];
+    AT_CborWriter w(buf, sizeof(buf));
+    w.map(4).key("n").integer(-500).key("t").number(21.5).key("ok").boolean(true).key("b").bytes(
+        (const uint8_t *)"\x01\x02", 2);
+    CHECK(w.ok());
+    CHECK(AT_CborReader::wellFormed(w.data(), w.length()));
+
+    AT_CborReader r(w.data(), w.length());
+    CHECK(r.next() == AT_CBOR_MAP && r.count() == 4);
+    CHECK(r.next() == AT_CBOR_TEXT && r.textEquals("n"));
+    CHECK(r.next() == AT_CBOR_NEGINT && r.toInt() == -500);
+    CHECK(r.next() == AT_CBOR_TEXT && r.textEquals("t"));
+    CHECK(r.next() == AT_CBOR_FLOAT && r.toDouble() == 21.5);
+    CHECK(r.next() == AT_CBOR_TEXT && r.textEquals("ok"));
+    CHECK(r.next() == AT_CBOR_BOOL && r.toBool());
+    CHECK(r.next() == AT_CBOR_TEXT && r.textEquals("b"));
+    CHECK(r.next() == AT_CBOR_BYTES && r.count() == 2 && r.bytes()[1] == 2);
+    CHECK(r.next() == AT_CBOR_END);
+
+    // skip() passes over a whole container
+    w.reset();
+    w.array(2).array(2).integer(1).string("x").integer(7);
+    AT_CborReader s(w.data(), w.length());
+    CHECK(s.next() == AT_CBOR_ARRAY && s.next() == AT_CBOR_ARRAY && s.skip());
+    CHECK(s.next() == AT_CBOR_UINT && s.toInt() == 7);
+
+    // A writer that runs out of room stops for good
+    AT_CborWriter small(buf, 4);
+    small.string("too long for four bytes").integer(1);
+    CHECK(!small.ok());
+
+    CHECK(wellFormed({0x01}));
+    CHECK(wellFormed({0x82, 0x01, 0x61, 'a'}));
+    CHECK(wellFormed({0xA0}));
+    // Tags: the count is the tag number, one item follows
+    CHECK(wellFormed({0xD8, 0x20, 0x61, 'a'}));        // tag 32 (URI)
+    CHECK(wellFormed({0xD9, 0xD9, 0xF7, 0x01}));       // self-describe tag 55799
+    CHECK(wellFormed({0x81, 0xC1, 0x1A, 0, 0, 0, 1})); // epoch time in an array
+    CHECK(!wellFormed({0xD8, 0x20}));                  // tag without its item
+    CHECK(!wellFormed({}));
+    CHECK(!wellFormed({0x82, 0x01}));            // array short of an item
+    CHECK(!wellFormed({0x01, 0x02}));            // two items
+    CHECK(!wellFormed({0x9F, 0x01, 0xFF}));      // indefinite length
+    CHECK(!wellFormed({0x62, 'a'}));             // text past the end
+    CHECK(!wellFormed({0x9B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF})); // huge count
+}
+
+static void lz()
+{
+    uint8_t in[1024], frame[1100], out[1024];
+
+    // Repetitive text shrinks, noise is stored
+    for (size_t i = 0; i < sizeof(in); i++)
+        in[i] = "{\"t\":21.5,\"h\":40},"[i % 19];
+    int32_t n = AT_lzCompress(in, sizeof(in), frame, sizeof(frame));
+    CHECK(n > 0 && n < 200 && frame[0] == AT_LZ_LZSS);
+    CHECK(AT_lzDecompress(frame, n, out, sizeof(out)) == (int32_t)sizeof(in) && memcmp(in, out, sizeof(in)) == 0);
+
+    srand(7);
+    for (size_t i = 0; i < sizeof(in); i++)
+        in[i] = rand();
+    n = AT_lzCompress(in, sizeof(in), frame, sizeof(frame));
+    CHECK(n == (int32_t)sizeof(in) + 1 && frame[0] == AT_LZ_STORED);
+    CHECK(AT_lzDecompress(frame, n, out, sizeof(out)) == (int32_t)sizeof(in) && memcmp(in, out, sizeof(in)) == 0);
+
+    // Does not fit, corrupt frames, too small an output
+    CHECK(AT_lzCompress(in, sizeof(in), frame, 100) < 0);
+    const uint8_t badMethod[] = {0x07, 'a'};
+    CHECK(AT_lzDecompress(badMethod, sizeof(badMethod), out, sizeof(out)) < 0);
+    const uint8_t farMatch[] = {AT_LZ_LZSS, 4, 0, 0x00, 0xFF, 0x0F}; // offset before the start
+    CHECK(AT_lzDecompress(farMatch, sizeof(farMatch), out, sizeof(out)) < 0);
+    for (size_t i = 0; i < sizeof(in); i++)
+        in[i] = 'a';
+    n = AT_lzCompress(in, sizeof(in), frame, sizeof(frame));
+    CHECK(n > 0 && AT_lzDecompress(frame, n, out, 100) < 0);
+    CHECK(AT_lzDecompress(frame, n - 1, out, sizeof(out)) < 0); // truncated
+}
+
+static void formats()
+{
+    const char *json = "  {\"a\":1}";
+    CHECK(AT_codecValid(AT_CODEC_JSON, (const uint8_t *)json, strlen(json)));
+    CHECK(!AT_codecValid(AT_CODEC_JSON, (const uint8_t *)"   ", 3));
+    CHECK(!AT_codecValid(AT_CODEC_JSON, (const uint8_t *)"21.5", 4));
+    const uint8_t item[] = {0x18, 0x64};
+    CHECK(AT_codecValid(AT_CODEC_CBOR | AT_CODEC_LZ, item, sizeof(item)));
+    CHECK(!AT_codecValid(AT_CODEC_CBOR, item, 1));
+    CHECK(AT_codecValid(AT_CODEC_RAW, item, 1));
+    CHECK(!AT_codecValid(AT_CODEC_RAW, item, 0));
+}
+
+int main()
+{
+    cbor();
+    lz();
+    formats();
+    return checkResult();
+}
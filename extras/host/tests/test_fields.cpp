@@ -0,0 +1,53 @@
+// AT_Slice / AT_Fields: typed fields of information responses
+
+#include "AT_buffer.h"
+#include "check.h"
+
+int main()
+{
+    AT_Fields f;
+
+    // Quoted fields keep commas, empty ones read as empty
+    CHECK(f.parse(AT_Slice("+CMGR: \"REC UNREAD\",\"+15550100\",,\"24/01/01,12:00:00+00\""), "+CMGR:"));
+    CHECK(f.count() == 4);
+    CHECK(f[0].type == AT_FIELD_STRING && f.text(0).equals("REC UNREAD"));
+    CHECK(f[2].type == AT_FIELD_EMPTY);
+    CHECK(f.text(3).equals("24/01/01,12:00:00+00"));
+    CHECK(f[7].type == AT_FIELD_EMPTY && f.toInt(7, -1) == -1); // past the end
+
+    // Integers, signs and unquoted text
+    CHECK(f.parse(AT_Slice("+CMQTTPUB: 0,-12, +3 ,1A")));
+    CHECK(f.count() == 4);
+    CHECK(f[0].isInt() && f.toInt(0) == 0);
+    CHECK(f.toInt(1) == -12 && f.toInt(2) == 3);
+    CHECK(f[3].type == AT_FIELD_TEXT && f.toInt(3, 99) == 99);
+
+    // Escaped quotes are resolved by copyTo()
+    char buf[16];
+    CHECK(f.parse(AT_Slice("+X: \"a\\\"b\",1")));
+    CHECK(f[0].escaped && f[0].copyTo(buf, sizeof(buf)) == 3 && strcmp(buf, "a\"b") == 0);
+    CHECK(f.toInt(1) == 1);
+
+    // Wrong prefix, open quote, too many fields
+    CHECK(!f.parse(AT_Slice("+CMGS: 5"), "+CMGR:"));
+    CHECK(!f.parse(AT_Slice("+X: \"open,1")));
+    CHECK(f.count() == 1);
+    CHECK(!f.parse(AT_Slice("+X: 1,2,3,4,5,6,7,8,9,10,11,12,13")));
+    CHECK(f.count() == AT_FIELDS_MAX);
+
+    // Nothing after the prefix
+    CHECK(f.parse(AT_Slice("+X:  ")) && f.count() == 0);
+
+    // Lines of a response
+    AT_Slice resp("\r\n+CSQ: 20,99\r\n\r\nOK\r\n");
+    CHECK(resp.findLine("+CSQ:").equals("+CSQ: 20,99"));
+    CHECK(resp.findLine("+CREG:").empty());
+    uint16_t pos = 0;
+    AT_Slice line;
+    int lines = 0;
+    while (resp.nextLine(pos, line))
+        lines++;
+    CHECK(lines == 2);
+
+    return checkResult();
+}
@@ -0,0 +1,55 @@
+// AT_Matcher: prefix and exact patterns fed one byte at a time
+
+#include "AT_match.h"
+#include "check.h"
+#include <string.h>
+
+static AT_match_mask_t run(const AT_Matcher &proto, const char *line)
+{
+    AT_Matcher m = proto;
+    m.reset();
+    for (const char *p = line; *p; p++)
+        m.feed(*p);
+    return m.matched();
+}
+
+int main()
+{
+    AT_Matcher m;
+    CHECK(m.add("OK", 0, true));
+    CHECK(m.add("ERROR", 1, true));
+    CHECK(m.add("+CME ERROR:", 2, false));
+    CHECK(m.add("+CMQTT", 3, false));
+    CHECK(m.add("+CMQTTRXSTART:", 4, false));
+    CHECK(m.add(">", 5, true));
+
+    CHECK(run(m, "OK") == 1u << 0);
+    CHECK(run(m, "OK2") == 0);  // exact: the whole line only
+    CHECK(run(m, "O") == 0);    // a pattern's prefix is no match
+    CHECK(run(m, "ERROR") == 1u << 1);
+    CHECK(run(m, "+CME ERROR: 10") == 1u << 2);
+    CHECK(run(m, "+CMQTTPUB: 0,0") == 1u << 3);
+    CHECK(run(m, "+CMQTTRXSTART: 0,5,6") == (1u << 3 | 1u << 4)); // nested prefixes both hit
+    CHECK(run(m, ">") == 1u << 5);
+    CHECK(run(m, "") == 0);
+    CHECK(run(m, "RING") == 0);
+
+    // A pattern added again with another kind moves its bit
+    CHECK(m.add("OK", 0, false));
+    CHECK(run(m, "OK2") == 1u << 0);
+
+    // Bad input and a full trie leave the matcher as it was
+    CHECK(!m.add("", 6, false));
+    CHECK(!m.add(nullptr, 6, false));
+    CHECK(!m.add("X", 32, false));
+    char longPattern[AT_MATCH_NODES + 2];
+    memset(longPattern, 'z', sizeof(longPattern) - 1);
+    longPattern[sizeof(longPattern) - 1] = '\0';
+    CHECK(!m.add(longPattern, 7, false));
+    CHECK(run(m, "zz") == 0);
+    CHECK(run(m, "ERROR") == 1u << 1);
+
+    m.clear();
+    CHECK(run(m, "OK") == 0);
+    return checkResult();
+}
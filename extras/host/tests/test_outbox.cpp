@@ -0,0 +1,136 @@
+// AT_Outbox on RAM storage: order, recovery after a reset (a new
+// AT_Outbox over the same storage), batched cursor saves, torn and
+// corrupt records and the full-storage policies
+
+#include <Arduino.h>
+#include "AT_outbox.h"
+#include "check.h"
+
+static const int RECORD = AT_OUTBOX_HEADER_LEN + 3 + 7; // "t/1" + {"n":1}
+
+static bool push(AT_Outbox &box, int n)
+{
+    char payload[8];
+    snprintf(payload, sizeof(payload), "{\"n\":%d}", n % 10);
+    return box.push(0, "t/1", (const uint8_t *)payload, 7, 1);
+}
+
+// Payload digit of the next record, -1 when there is none
+static int next(AT_Outbox &box, bool pop = true)
+{
+    AT_OutboxMessage m;
+    if (!box.peek(m))
+        return -1;
+    int n = m.payload[5] - '0';
+    if (pop)
+        box.pop();
+    return n;
+}
+
+static void recovery()
+{
+    uint8_t buf[2048];
+    AT_OutboxRamStore store(buf, sizeof(buf), 4);
+    {
+        AT_Outbox box(store);
+        CHECK(box.begin() && box.depth() == 0);
+        for (int i = 0; i < 10; i++)
+            CHECK(push(box, i));
+        CHECK(box.depth() == 10);
+        for (int i = 0; i < 4; i++)
+            CHECK(next(box) == i);
+    }
+
+    // Reset: fewer records sent than AT_OUTBOX_CURSOR_EVERY, so
+    // the cursor was not saved and they all come back, in order
+    AT_Outbox box(store);
+    CHECK(box.begin());
+    CHECK(box.depth() == 10);
+    CHECK(next(box, false) == 0);
+
+    // A torn record ends its segment; appends go to a new one
+    uint8_t torn[5] = {AT_OUTBOX_REC_PUBLISH, 0x01, 3, 7, 0};
+    uint32_t first, last;
+    CHECK(store.range(first, last) && store.append(last, torn, sizeof(torn)));
+    AT_Outbox again(store);
+    CHECK(again.begin() && again.depth() == 10);
+    CHECK(push(again, 9) && again.depth() == 11);
+    uint32_t last2;
+    CHECK(store.range(first, last2) && last2 == last + 1);
+
+    // A corrupt record is skipped and counted, the rest still go
+    buf[5 * RECORD + AT_OUTBOX_HEADER_LEN + 3 + 5] ^= 0x01; // record 5, slot 0
+    int order[12], got = 0, n;
+    while ((n = next(again)) >= 0 && got < 12)
+        order[got++] = n;
+    CHECK(got == 10 && again.dropped() == 1);
+    CHECK(order[0] == 0 && order[4] == 4 && order[5] == 6 && order[9] == 9);
+    CHECK(again.depth() == 0);
+}
+
+// The cursor is saved every AT_OUTBOX_CURSOR_EVERY records and
+// when a segment is finished; a reset re-sends what came after
+static void cursor()
+{
+    uint8_t buf[2048];
+    AT_OutboxRamStore store(buf, sizeof(buf), 4);
+    const int PER_SEGMENT = sizeof(buf) / 4 / RECORD;
+    const int TOTAL = PER_SEGMENT + AT_OUTBOX_CURSOR_EVERY;
+    {
+        AT_Outbox box(store);
+        CHECK(box.begin());
+        for (int i = 0; i < TOTAL; i++)
+            CHECK(push(box, i));
+        for (int i = 0; i < AT_OUTBOX_CURSOR_EVERY + 1; i++)
+            CHECK(next(box) == i % 10);
+    }
+
+    // Saved after AT_OUTBOX_CURSOR_EVERY; the one after it is sent again
+    AT_Outbox box(store);
+    CHECK(box.begin() && box.depth() == TOTAL - AT_OUTBOX_CURSOR_EVERY);
+    CHECK(next(box, false) == AT_OUTBOX_CURSOR_EVERY % 10);
+
+    // Moving on from the drained first segment deletes it and saves
+    // the cursor
+    for (int i = AT_OUTBOX_CURSOR_EVERY; i < PER_SEGMENT; i++)
+        CHECK(next(box) == i % 10);
+    CHECK(next(box, false) == PER_SEGMENT % 10);
+    AT_Outbox after(store);
+    CHECK(after.begin() && after.depth() == AT_OUTBOX_CURSOR_EVERY);
+    CHECK(next(after, false) == PER_SEGMENT % 10);
+}
+
+static void policies()
+{
+    uint8_t buf[4 * 64];
+    AT_OutboxRamStore oldest(buf, sizeof(buf), 4); // 64-byte segments, 3 records each
+    AT_Outbox box(oldest);
+    CHECK(box.begin());
+    for (int i = 0; i < 15; i++)
+        CHECK(push(box, i));
+    CHECK(box.depth() == 12 && box.dropped() == 3);
+    CHECK(next(box) == 3);
+
+    uint8_t buf2[4 * 64];
+    AT_OutboxRamStore newest(buf2, sizeof(buf2), 4);
+    AT_Outbox keep(newest, AT_OUTBOX_DROP_NEWEST);
+    CHECK(keep.begin());
+    int stored = 0;
+    for (int i = 0; i < 15; i++)
+        stored += push(keep, i);
+    CHECK(stored == 12 && keep.depth() == 12 && keep.dropped() == 3);
+    CHECK(next(keep) == 0);
+
+    // Bad records are refused outright
+    CHECK(!keep.push(0, "", (const uint8_t *)"x", 1, 1));
+    CHECK(!keep.push(0, "t", (const uint8_t *)"x", 1, 3));
+    CHECK(!keep.push(16, "t", (const uint8_t *)"x", 1, 1));
+}
+
+int main()
+{
+    recovery();
+    cursor();
+    policies();
+    return checkResult();
+}
@@ -0,0 +1,87 @@
+// AT_TopicTable: filter validation, matches() and the table's
+// own match(), which must agree with it for every filter kind
+
+#include "AT_topics.h"
+#include "check.h"
+#include <string.h>
+
+static void onMessage(const char *, const char *, uint16_t) {}
+
+struct Case
+{
+    const char *filter;
+    const char *topic;
+    bool match;
+};
+
+static const Case cases[] = {
+    {"dev/7/temp", "dev/7/temp", true},
+    {"dev/7/temp", "dev/7/temp/x", false},
+    {"dev/+/temp", "dev/7/temp", true},
+    {"dev/+/temp", "dev/7/hum", false},
+    {"dev/+/temp", "dev//temp", true}, // '+' matches an empty level
+    {"dev/+", "dev/7/temp", false},
+    {"+/+", "dev/7", true},
+    {"dev/#", "dev/7/temp", true},
+    {"dev/7/#", "dev/8/temp", false},
+    {"dev/7/#", "dev/70", false},
+    {"#", "dev/7/temp", true},
+    {"+/7/#", "dev/7/temp/x", true},
+    // "a/#" also matches the parent level "a"
+    {"dev/7/#", "dev/7", true},
+    {"dev/7/#", "dev/", false},
+    {"dev/7/#", "dev/8", false},
+    {"+/7/#", "dev/7", true},
+    {"/#", "", true},
+    // Wildcards at the first level leave $-topics alone
+    {"#", "$SYS/load", false},
+    {"+/load", "$SYS/load", false},
+    {"$SYS/#", "$SYS/load", true},
+    {"$SYS/+", "$SYS/load", true},
+};
+
+int main()
+{
+    CHECK(AT_TopicTable::valid("a/+/b/#"));
+    CHECK(!AT_TopicTable::valid(""));
+    CHECK(!AT_TopicTable::valid("a/#/b"));
+    CHECK(!AT_TopicTable::valid("a/b#"));
+    CHECK(!AT_TopicTable::valid("a+/b"));
+
+    for (const Case &c : cases)
+    {
+        AT_TopicTable table;
+        mqtt_rx_callback_t cbs[AT_MQTT_SUBS_MAX];
+        CHECK(table.add(c.filter, 1, onMessage));
+
+        bool byFilter = AT_TopicTable::matches(c.filter, c.topic);
+        bool byTable = table.match(c.topic, cbs, AT_MQTT_SUBS_MAX) == 1;
+        if (byFilter != c.match || byTable != c.match)
+        {
+            fprintf(stderr, "%s vs %s: matches %d, match %d, expected %d\n", c.filter, c.topic, byFilter,
+                    byTable, c.match);
+            checkFailures++;
+        }
+    }
+
+    // Updates keep one entry; dispatch() calls every hit
+    AT_TopicTable table;
+    CHECK(table.add("dev/#", 0, onMessage));
+    CHECK(table.add("dev/#", 1, onMessage));
+    CHECK(table.count() == 1 && table.find("dev/#")->qos == 1);
+    CHECK(table.add("dev/7/temp", 1, onMessage));
+    CHECK(table.dispatch("dev/7/temp", "1", 1) == 2);
+    CHECK(table.remove("dev/#") && !table.remove("dev/#"));
+    CHECK(table.dispatch("dev/7/temp", "1", 1) == 1);
+
+    // Full table
+    table.clear();
+    char filter[16];
+    for (int i = 0; i < AT_MQTT_SUBS_MAX; i++)
+    {
+        snprintf(filter, sizeof(filter), "t/%d", i);
+        CHECK(table.add(filter, 0, onMessage));
+    }
+    CHECK(!table.add("t/x", 0, onMessage));
+    return checkResult();
+}
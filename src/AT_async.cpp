@@ -0,0 +1,590 @@
+#include "AT_lib.h"
+
+// =====================================================
+// ASYNC TRANSACTION ENGINE
+// Transactions are queued and advanced from poll():
+//   send command → [wait '>' → send data] → wait result
+// Steps of one operation (e.g. TOPIC, PAYLOAD, PUB) form a
+// chain; a failing step drops the rest of the chain and the
+// completion callback of the last step reports the failure.
+// =====================================================
+
+// Claims `len` contiguous bytes of the data arena. Data is
+// released in queue order, so the arena is a simple ring:
+// live bytes are [tail, head), or [tail, wrap) + [0, head)
+// once an allocation had to restart at offset 0.
+int32_t AT_Lib::allocAsyncData(uint16_t len)
+{
+  if (len == 0)
+    return 0;
+
+  if (_dataUsed == 0)
+  {
+    _dataHead = _dataTail = 0;
+    _dataWrapped = false;
+  }
+
+  if (!_dataWrapped)
+  {
+    if (AT_ASYNC_DATA_SIZE - _dataHead >= len)
+    {
+      uint16_t off = _dataHead;
+      _dataHead += len;
+      _dataUsed += len;
+      return off;
+    }
+    if (_dataTail >= len)
+    {
+      _dataWrap = _dataHead;
+      _dataWrapped = true;
+      _dataHead = len;
+      _dataUsed += len;
+      return 0;
+    }
+    return -1;
+  }
+
+  if (_dataTail - _dataHead >= len)
+  {
+    uint16_t off = _dataHead;
+    _dataHead += len;
+    _dataUsed += len;
+    return off;
+  }
+  return -1;
+}
+
+void AT_Lib::freeAsyncData(uint16_t off, uint16_t len)
+{
+  if (len == 0)
+    return;
+
+  if (_dataWrapped && off != _dataTail)
+  {
+    // Everything up to the wrap mark is gone; continue from 0
+    _dataWrapped = false;
+  }
+  _dataTail = off + len;
+  _dataUsed -= len;
+}
+
+AT_Lib::AsyncTx *AT_Lib::pushAsync(const char *cmd, const uint8_t *data, uint16_t dataLen,
+                                   const char *terminator, uint32_t timeout)
+{
+  if (_asyncCount >= AT_ASYNC_QUEUE_LEN || strlen(cmd) >= AT_ASYNC_CMD_MAX)
+    return nullptr;
+
+  int32_t off = allocAsyncData(dataLen);
+  if (off < 0)
+    return nullptr;
+
+  AsyncTx &tx = _asyncQueue[(_asyncHead + _asyncCount) % AT_ASYNC_QUEUE_LEN];
+  _asyncCount++;
+
+  strcpy(tx.cmd, cmd);
+  tx.def = nullptr;
+  tx.dataOff = (uint16_t)off;
+  tx.dataLen = dataLen;
+  if (dataLen)
+    memcpy(_asyncData + off, data, dataLen);
+  tx.terminator = terminator;
+  tx.timeout = timeout;
+  tx.cb = nullptr;
+  tx.user = nullptr;
+  tx.flags = 0;
+#if AT_RTOS
+  // Sent by the reader task; wake it instead of waiting a period
+  if (_readerTask && xTaskGetCurrentTaskHandle() != _readerTask)
+    wakeReader();
+#endif
+  return &tx;
+}
+
+// A line already rendered from `cmd`; the entry stays
+// attached for the stats family.
+AT_Lib::AsyncTx *AT_Lib::pushLine(const char *line, const AT_CmdDef &cmd, const uint8_t *data, uint16_t dataLen,
+                                  uint32_t timeout)
+{
+  AsyncTx *tx = pushAsync(line, data, dataLen, (cmd.flags & AT_CMD_FLAG_RESULT) ? cmd.response : nullptr,
+                          timeout ? timeout : cmd.timeout);
+  if (tx)
+    tx->def = &cmd;
+  return tx;
+}
+
+// Table commands are rendered into the queue slot once
+AT_Lib::AsyncTx *AT_Lib::pushArgs(const AT_CmdDef &cmd, const AT_Arg *args, uint8_t count,
+                                  const uint8_t *data, uint16_t dataLen, uint32_t timeout)
+{
+  char line[AT_ASYNC_CMD_MAX];
+  if (!AT_formatCommand(line, sizeof(line), cmd, args, count) ||
+      !(cmd.flags & AT_CMD_FLAG_PROMPT) != !dataLen)
+  {
+    AT_LOGE("[ASYNC] %s: arguments do not match or line too long", cmd.text);
+    return nullptr;
+  }
+  return pushLine(line, cmd, data, dataLen, timeout);
+}
+
+// Chains are pushed all-or-nothing: on failure the queue and
+// data arena are rolled back to the saved marks.
+void AT_Lib::rollbackAsync(const AsyncMark &mark)
+{
+  _asyncCount = mark.count;
+  _dataHead = mark.dataHead;
+  _dataTail = mark.dataTail;
+  _dataUsed = mark.dataUsed;
+  _dataWrap = mark.dataWrap;
+  _dataWrapped = mark.dataWrapped;
+}
+
+AT_Lib::AsyncMark AT_Lib::markAsync() const
+{
+  AsyncMark m;
+  m.count = _asyncCount;
+  m.dataHead = _dataHead;
+  m.dataTail = _dataTail;
+  m.dataUsed = _dataUsed;
+  m.dataWrap = _dataWrap;
+  m.dataWrapped = _dataWrapped;
+  return m;
+}
+
+bool AT_Lib::commandAsyncArgs(const AT_CmdDef &cmd, at_async_callback_t cb, void *user, uint32_t timeout,
+                              const AT_Arg *args, uint8_t count)
+{
+  AT_GUARD();
+  AsyncTx *tx = pushArgs(cmd, args, count, nullptr, 0, timeout);
+  if (!tx)
+  {
+    AT_LOGW("[ASYNC] Queue full");
+    return false;
+  }
+  tx->cb = cb;
+  tx->user = user;
+  return true;
+}
+
+bool AT_Lib::commandAsync(const char *cmd, at_async_callback_t cb, void *user,
+                          uint32_t timeout, const char *terminator)
+{
+  AT_GUARD();
+  AsyncTx *tx = pushAsync(cmd, nullptr, 0, terminator, timeout);
+  if (!tx)
+  {
+    AT_LOGW("[ASYNC] Queue full");
+    return false;
+  }
+  tx->cb = cb;
+  tx->user = user;
+  return true;
+}
+
+// Reads <err> from "<terminator> <client_index>,<err>"
+static int asyncResultCode(AT_Slice response, const char *terminator, int *clientId)
+{
+  AT_Fields f;
+  f.parse(response.findLine(terminator), terminator);
+  *clientId = (int)f.toInt(0, -1);
+  return (int)f.toInt(1, -1);
+}
+
+void AT_Lib::finishAsync(AT_result_t result)
+{
+  AsyncTx &tx = _asyncQueue[_asyncHead];
+
+  AT_Completion done;
+  done.result = result;
+  done.code = 0;
+  done.ok = (result == AT_RESULT_OK);
+  if (result == AT_RESULT_TERMINATOR)
+  {
+    int clientId;
+    done.code = asyncResultCode(response(), tx.terminator, &clientId);
+    done.ok = (done.code == 0);
+    if (strncmp(tx.terminator, "+CMQTT", 6) == 0)
+    {
+      statMqttResult(done.code);
+      noteMqttResult(tx.terminator, clientId, done.code);
+    }
+  }
+  else if (result == AT_RESULT_CME_ERROR || result == AT_RESULT_CMS_ERROR)
+  {
+    AT_Fields f;
+    f.parse(response().findLine("+CM"));
+    done.code = (int)f.toInt(0);
+  }
+  else if (result == AT_RESULT_PROMPT)
+  {
+    done.ok = false;
+  }
+  done.response = response();
+
+  endResponse();
+  statEnd(result);
+  _asyncState = ASYNC_IDLE;
+
+  uint8_t flags = tx.flags;
+  at_async_callback_t cb = tx.cb;
+  void *user = tx.user;
+  freeAsyncData(tx.dataOff, tx.dataLen);
+  _asyncHead = (_asyncHead + 1) % AT_ASYNC_QUEUE_LEN;
+  _asyncCount--;
+
+  if (flags & TX_CHAINED)
+  {
+    if (done.ok)
+    {
+      _asyncChainOpen = true;
+      return;
+    }
+
+    // Drop the remaining steps; the last one carries the callback
+    while (_asyncCount)
+    {
+      AsyncTx &next = _asyncQueue[_asyncHead];
+      flags = next.flags;
+      cb = next.cb;
+      user = next.user;
+      freeAsyncData(next.dataOff, next.dataLen);
+      _asyncHead = (_asyncHead + 1) % AT_ASYNC_QUEUE_LEN;
+      _asyncCount--;
+      if (!(flags & TX_CHAINED))
+        break;
+    }
+  }
+  _asyncChainOpen = false;
+
+  if (cb)
+  {
+    cb(done, user);
+  }
+}
+
+void AT_Lib::asyncStep()
+{
+  if (_asyncState == ASYNC_IDLE)
+  {
+    if (!_asyncCount)
+      return;
+
+    AsyncTx &tx = _asyncQueue[_asyncHead];
+    AT_LOGT(">> %s", tx.cmd);
+    if (tx.def)
+      statBegin(tx.def->family);
+    else
+      statBegin(tx.cmd);
+    modemPrint(tx.cmd);
+    modemPrint("\r\n");
+    beginResponse(tx.dataLen ? nullptr : tx.terminator);
+    _asyncStart = millis();
+    _asyncState = tx.dataLen ? ASYNC_WAIT_PROMPT : ASYNC_WAIT_RESULT;
+  }
+
+  AsyncTx &tx = _asyncQueue[_asyncHead];
+
+  pumpModem();
+  AT_result_t result = collectResponse();
+
+  if (result == AT_RESULT_TIMEOUT)
+  {
+    if (millis() - _asyncStart >= tx.timeout)
+    {
+      if (_asyncState == ASYNC_WAIT_PROMPT)
+        _stats.promptTimeouts++;
+      finishAsync(AT_RESULT_TIMEOUT);
+    }
+    return;
+  }
+
+  if (_asyncState == ASYNC_WAIT_PROMPT && result == AT_RESULT_PROMPT)
+  {
+    modemWrite(_asyncData + tx.dataOff, tx.dataLen);
+    if (tx.flags & TX_CTRL_Z)
+      modemWrite((const uint8_t *)"\x1A", 1);
+
+    endResponse();
+    beginResponse(tx.terminator);
+    _asyncStart = millis();
+    _asyncState = ASYNC_WAIT_RESULT;
+    return;
+  }
+
+  if (_asyncState == ASYNC_WAIT_PROMPT)
+  {
+    // A final result instead of '>': the data never went out,
+    // so even an OK fails the step (and the rest of its chain)
+    _stats.promptMissing++;
+    if (result == AT_RESULT_OK || result == AT_RESULT_TERMINATOR)
+      result = AT_RESULT_ERROR;
+  }
+  finishAsync(result);
+}
+
+bool AT_Lib::asyncIdle() const
+{
+  return _asyncState == ASYNC_IDLE && !_asyncChainOpen;
+}
+
+void AT_Lib::waitAsyncIdle()
+{
+  while (!asyncIdle())
+  {
+    asyncStep();
+    if (_asyncState != ASYNC_IDLE)
+    {
+      uint32_t elapsed = millis() - _asyncStart;
+      uint32_t timeout = _asyncQueue[_asyncHead].timeout;
+      waitModem(elapsed < timeout ? timeout - elapsed : 0);
+    }
+  }
+}
+
+// =====================================================
+// ASYNC MQTT / SMS / TIME OPERATIONS
+// =====================================================
+bool AT_Lib::mqttPublishAsync(uint8_t clientId, const char *topic, const uint8_t *payload, uint16_t length,
+                              uint8_t qos, at_async_callback_t cb, void *user, uint32_t timeout)
+{
+  AT_GUARD();
+  AT_PublishChannel channel;
+  return prepareChannel(channel, clientId, topic, topic ? strlen(topic) : 0, qos, false, timeout) &&
+         publishQueued(channel, payload, length, cb, user);
+}
+
+bool AT_Lib::publishQueued(AT_PublishChannel &channel, const uint8_t *payload, uint16_t length,
+                           at_async_callback_t cb, void *user)
+{
+  if (!payload || length == 0 || length > MQTT_PAYLOAD_MAX)
+  {
+    AT_LOGW("[MQTT] Invalid payload length");
+    return false;
+  }
+
+  if (outboxWanted(channel._client))
+  {
+    // Stored counts as done; the callback runs at once
+    if (!outboxStore(channel, payload, length))
+      return false;
+    if (cb)
+    {
+      AT_Completion done = {AT_RESULT_OK, 0, true, AT_Slice()};
+      cb(done, user);
+    }
+    return true;
+  }
+  return pushPublish(channel, payload, length, cb, user);
+}
+
+bool AT_Lib::pushPublish(AT_PublishChannel &channel, const uint8_t *payload, uint16_t length,
+                         at_async_callback_t cb, void *user)
+{
+  payload = encodePayload(channel, payload, length);
+  if (!payload)
+    return false;
+
+  if (_pubWindow > 1)
+    return pipelinePublish(channel, payload, length, cb, user);
+
+  AsyncTx *pub = loadPublish(channel, payload, length, false);
+  if (!pub)
+    return false;
+  pub->cb = cb;
+  pub->user = user;
+  return true;
+}
+
+// Queues the channel's TOPIC, PAYLOAD and PUB lines as one
+// chain; returns the last step, which carries the callback.
+// A pipelined PUB is done at its OK.
+AT_Lib::AsyncTx *AT_Lib::loadPublish(AT_PublishChannel &channel, const uint8_t *payload, uint16_t length,
+                                     bool pipelined)
+{
+  AsyncMark mark = markAsync();
+  const AT_CmdDef &pub = pipelined ? AT_Cmd::MQTT_PUBLISH_PIPELINED : AT_Cmd::MQTT_PUBLISH;
+  uint32_t timeout = channel._timeout;
+
+  AsyncTx *t1 = pushLine(channel._topicLine, AT_Cmd::MQTT_TOPIC, (const uint8_t *)channel._topic,
+                         channel._topicLen, timeout);
+  AsyncTx *t2 = t1 ? pushLine(channel.payloadLine(length), AT_Cmd::MQTT_PAYLOAD, payload, length, timeout) : nullptr;
+  AsyncTx *t3 = t2 ? pushLine(channel._pubLine, pub, nullptr, 0, timeout) : nullptr;
+
+  if (!t3)
+  {
+    rollbackAsync(mark);
+    AT_LOGW("[ASYNC] Queue full, publish rejected");
+    return nullptr;
+  }
+
+  t1->flags = TX_CHAINED;
+  t2->flags = TX_CHAINED;
+  return t3;
+}
+
+bool AT_Lib::mqttConnectAsync(uint8_t clientId, const char *uri, const char *user, const char *pass,
+                              uint16_t keepAlive, bool cleanSession, at_async_callback_t cb, void *cbUser,
+                              uint32_t timeout)
+{
+  AT_GUARD();
+  return commandAsync(AT_Cmd::MQTT_CONNECT, cb, cbUser, timeout,
+                      clientId, uri, keepAlive, cleanSession ? 1 : 0, user, pass);
+}
+
+bool AT_Lib::mqttSubscribeAsync(uint8_t clientId, const char *topic, uint8_t qos, mqtt_rx_callback_t rxCb,
+                                at_async_callback_t cb, void *user, uint32_t timeout)
+{
+  AT_GUARD();
+  size_t topicLen = topic ? strlen(topic) : 0;
+  if (topicLen == 0)
+  {
+    AT_LOGW("[MQTT] Empty topic rejected");
+    return false;
+  }
+
+  MqttClient *c = mqttClient(clientId);
+  if (!c)
+    return false;
+
+  const AT_TopicTable::Entry *prev = c->topics.find(topic);
+  if (!prev && c->topics.count() >= AT_MQTT_SUBS_MAX)
+  {
+    AT_LOGW("[MQTT] Subscription table full");
+    return false;
+  }
+  if (!AT_TopicTable::valid(topic))
+  {
+    AT_LOGW("[MQTT] Invalid topic filter");
+    return false;
+  }
+  if (_subUndoCount >= AT_ASYNC_QUEUE_LEN / 2)
+  {
+    AT_LOGW("[ASYNC] Queue full, subscribe rejected");
+    return false;
+  }
+
+  AsyncMark mark = markAsync();
+
+  AsyncTx *t1 = pushCommand(AT_Cmd::MQTT_SUB_TOPIC, (const uint8_t *)topic, topicLen, timeout,
+                            clientId, (unsigned)topicLen, qos);
+  AsyncTx *t2 = t1 ? pushCommand(AT_Cmd::MQTT_SUBSCRIBE, nullptr, 0, timeout, clientId) : nullptr;
+
+  if (!t2)
+  {
+    rollbackAsync(mark);
+    AT_LOGW("[ASYNC] Queue full, subscribe rejected");
+    return false;
+  }
+
+  // Registered up front: nothing arrives for it before the SUB
+  // anyway. subscribed() puts the old entry back if it fails.
+  SubUndo &u = _subUndo[(_subUndoHead + _subUndoCount++) % (AT_ASYNC_QUEUE_LEN / 2)];
+  memcpy(u.filter, topic, topicLen + 1);
+  u.client = clientId;
+  u.qos = qos;
+  u.cb = rxCb;
+  u.known = prev != nullptr;
+  u.prevQos = prev ? prev->qos : 0;
+  u.prevCb = prev ? prev->cb : nullptr;
+  u.userCb = cb;
+  u.user = user;
+  c->topics.add(topic, qos, rxCb);
+
+  t1->flags = TX_CHAINED;
+  t2->cb = onSubscribed;
+  t2->user = this;
+  return true;
+}
+
+void AT_Lib::onSubscribed(const AT_Completion &done, void *user)
+{
+  ((AT_Lib *)user)->subscribed(done);
+}
+
+// Chains complete in queue order, so this is the oldest subscribe.
+// A failed SUB leaves the table as it was, unless another subscribe
+// to the same filter has changed the entry since.
+void AT_Lib::subscribed(const AT_Completion &done)
+{
+  if (!_subUndoCount)
+    return;
+  SubUndo u = _subUndo[_subUndoHead];
+  _subUndoHead = (_subUndoHead + 1) % (AT_ASYNC_QUEUE_LEN / 2);
+  _subUndoCount--;
+
+  if (!done.ok)
+  {
+    AT_TopicTable &table = _mqtt[u.client].topics;
+    const AT_TopicTable::Entry *e = table.find(u.filter);
+    if (e && e->qos == u.qos && e->cb == u.cb)
+    {
+      AT_LOGW("[MQTT] Subscribe to %s failed, entry restored", u.filter);
+      if (u.known)
+        table.add(u.filter, u.prevQos, u.prevCb);
+      else
+        table.remove(u.filter);
+    }
+  }
+  if (u.userCb)
+    u.userCb(done, u.user);
+}
+
+bool AT_Lib::sendSMSAsync(const char *phoneNumber, const char *message, at_async_callback_t cb, void *user,
+                          uint32_t timeout)
+{
+  AT_GUARD();
+  size_t len = message ? strlen(message) : 0;
+  if (!phoneNumber || len == 0)
+  {
+    AT_LOGW("[SMS] Invalid phone number or message");
+    return false;
+  }
+
+  AsyncMark mark = markAsync();
+
+  AsyncTx *t1 = pushCommand(AT_Cmd::SMS_FORMAT, nullptr, 0, 0, 1);
+  AsyncTx *t2 = t1 ? pushCommand(AT_Cmd::SMS_SEND, (const uint8_t *)message, len, timeout, phoneNumber) : nullptr;
+
+  if (!t2)
+  {
+    rollbackAsync(mark);
+    AT_LOGW("[ASYNC] Queue full, SMS rejected");
+    return false;
+  }
+
+  t1->flags = TX_CHAINED;
+  t2->flags = TX_CTRL_Z;
+  t2->cb = cb;
+  t2->user = user;
+  return true;
+}
+
+// Network time only; enabling CTZU needs a modem reboot and
+// stays with the blocking syncTimeOnTimezone().
+bool AT_Lib::syncTimeAsync(at_async_callback_t cb, void *user, uint32_t timeout)
+{
+  AT_GUARD();
+  if (_timeSyncPending)
+    return false;
+
+  if (!commandAsync(AT_Cmd::CLOCK_QUERY, onTimeSync, this, timeout))
+    return false;
+
+  _timeSyncPending = true;
+  _timeSyncCb = cb;
+  _timeSyncUser = user;
+  return true;
+}
+
+void AT_Lib::onTimeSync(const AT_Completion &done, void *user)
+{
+  AT_Lib *self = (AT_Lib *)user;
+  self->_timeSyncPending = false;
+
+  AT_Completion result = done;
+  result.ok = done.ok && self->applyNetworkTime(done.response);
+
+  if (self->_timeSyncCb)
+  {
+    self->_timeSyncCb(result, self->_timeSyncUser);
+  }
+}
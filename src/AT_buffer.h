@@ -0,0 +1,345 @@
+#ifndef AT_BUFFER_H
+#define AT_BUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/* =====================================================
+ * AT SLICE
+ * Non-owning view into a response, line or field.
+ * Never allocates; the viewed bytes must outlive the slice.
+ * ===================================================== */
+struct AT_Slice
+{
+  const char *ptr;
+  uint16_t len;
+
+  AT_Slice() : ptr(""), len(0) {}
+  AT_Slice(const char *p, uint16_t n) : ptr(p), len(n) {}
+  explicit AT_Slice(const char *cstr) : ptr(cstr), len(cstr ? strlen(cstr) : 0) {}
+
+  bool empty() const { return len == 0; }
+  char operator[](uint16_t i) const { return i < len ? ptr[i] : '\0'; }
+
+  bool equals(const char *s) const
+  {
+    size_t n = strlen(s);
+    return n == len && memcmp(ptr, s, n) == 0;
+  }
+
+  bool startsWith(const char *s) const
+  {
+    size_t n = strlen(s);
+    return n <= len && memcmp(ptr, s, n) == 0;
+  }
+
+  int indexOf(char c, uint16_t from = 0) const
+  {
+    for (uint16_t i = from; i < len; i++)
+    {
+      if (ptr[i] == c)
+        return i;
+    }
+    return -1;
+  }
+
+  int indexOf(const char *s, uint16_t from = 0) const
+  {
+    size_t n = strlen(s);
+    if (n == 0)
+      return from <= len ? from : -1;
+    for (uint16_t i = from; i + n <= len; i++)
+    {
+      if (ptr[i] == s[0] && memcmp(ptr + i, s, n) == 0)
+        return i;
+    }
+    return -1;
+  }
+
+  int lastIndexOf(char c) const
+  {
+    for (int i = (int)len - 1; i >= 0; i--)
+    {
+      if (ptr[i] == c)
+        return i;
+    }
+    return -1;
+  }
+
+  AT_Slice sub(uint16_t from, uint16_t to) const
+  {
+    if (to > len)
+      to = len;
+    if (from >= to)
+      return AT_Slice(ptr + (from < len ? from : len), 0);
+    return AT_Slice(ptr + from, to - from);
+  }
+
+  AT_Slice sub(uint16_t from) const { return sub(from, len); }
+
+  AT_Slice trim() const
+  {
+    uint16_t b = 0, e = len;
+    while (b < e && (ptr[b] == ' ' || ptr[b] == '\r' || ptr[b] == '\n' || ptr[b] == '\t'))
+      b++;
+    while (e > b && (ptr[e - 1] == ' ' || ptr[e - 1] == '\r' || ptr[e - 1] == '\n' || ptr[e - 1] == '\t'))
+      e--;
+    return AT_Slice(ptr + b, e - b);
+  }
+
+  /* Optional sign and at least one digit, nothing else */
+  bool isInt() const
+  {
+    uint16_t i = (len && (ptr[0] == '-' || ptr[0] == '+')) ? 1 : 0;
+    if (i == len)
+      return false;
+    for (; i < len; i++)
+    {
+      if (ptr[i] < '0' || ptr[i] > '9')
+        return false;
+    }
+    return true;
+  }
+
+  /* Leading spaces, optional sign, then digits; stops at the first non-digit */
+  long toInt() const
+  {
+    uint16_t i = 0;
+    while (i < len && ptr[i] == ' ')
+      i++;
+    bool neg = false;
+    if (i < len && (ptr[i] == '-' || ptr[i] == '+'))
+      neg = (ptr[i++] == '-');
+    long v = 0;
+    while (i < len && ptr[i] >= '0' && ptr[i] <= '9')
+      v = v * 10 + (ptr[i++] - '0');
+    return neg ? -v : v;
+  }
+
+  /* Iterates non-empty CR/LF separated lines; `pos` starts at 0 */
+  bool nextLine(uint16_t &pos, AT_Slice &line) const
+  {
+    while (pos < len && (ptr[pos] == '\r' || ptr[pos] == '\n'))
+      pos++;
+    if (pos >= len)
+      return false;
+    uint16_t start = pos;
+    while (pos < len && ptr[pos] != '\r' && ptr[pos] != '\n')
+      pos++;
+    line = AT_Slice(ptr + start, pos - start);
+    return true;
+  }
+
+  /* First line starting with `prefix`, empty if none */
+  AT_Slice findLine(const char *prefix) const
+  {
+    uint16_t pos = 0;
+    AT_Slice line;
+    while (nextLine(pos, line))
+    {
+      if (line.startsWith(prefix))
+        return line;
+    }
+    return AT_Slice();
+  }
+
+  /* Copies into `buf` and NUL terminates, truncating to fit */
+  size_t copyTo(char *buf, size_t size) const
+  {
+    if (!size)
+      return 0;
+    size_t n = len < size - 1 ? len : size - 1;
+    memcpy(buf, ptr, n);
+    buf[n] = '\0';
+    return n;
+  }
+};
+
+#ifndef AT_FIELDS_MAX
+#define AT_FIELDS_MAX 12 // fields kept per parsed line
+#endif
+
+/* =====================================================
+ * AT FIELDS
+ * Splits an information response such as
+ *   +CMGR: "REC UNREAD","+15550100",,"24/01/01,12:00:00+00"
+ * into typed fields, in place. Quoted fields may hold commas
+ * and \" escapes; their text excludes the quotes. Missing
+ * fields read as empty, so optional trailing parameters need
+ * no bounds checks.
+ * ===================================================== */
+typedef enum
+{
+  AT_FIELD_EMPTY = 0, /**< Nothing between the commas, or past the end */
+  AT_FIELD_INT,       /**< Optional sign and digits */
+  AT_FIELD_STRING,    /**< Quoted */
+  AT_FIELD_TEXT       /**< Anything else unquoted, e.g. a hex value */
+} AT_field_type_t;
+
+struct AT_Field
+{
+  AT_Slice text;
+  AT_field_type_t type;
+  bool escaped; // text holds \ escapes, resolved by copyTo()
+
+  bool isInt() const { return type == AT_FIELD_INT; }
+  long toInt(long fallback = 0) const { return type == AT_FIELD_INT ? text.toInt() : fallback; }
+
+  size_t copyTo(char *buf, size_t size) const
+  {
+    if (!escaped)
+      return text.copyTo(buf, size);
+    if (!size)
+      return 0;
+    size_t n = 0;
+    for (uint16_t i = 0; i < text.len && n < size - 1; i++)
+    {
+      char c = text.ptr[i];
+      if (c == '\\' && i + 1 < text.len)
+        c = text.ptr[++i];
+      buf[n++] = c;
+    }
+    buf[n] = '\0';
+    return n;
+  }
+};
+
+class AT_Fields
+{
+public:
+  /* Fields after `prefix` (e.g. "+CMGR:"), or after the first ':'
+   * without one. False if the prefix does not match, a quote is
+   * left open or more than AT_FIELDS_MAX fields were found; the
+   * fields read up to that point stay available. */
+  bool parse(AT_Slice line, const char *prefix = nullptr)
+  {
+    _count = 0;
+    if (prefix)
+    {
+      if (!line.startsWith(prefix))
+        return false;
+      line = line.sub(strlen(prefix));
+    }
+    else
+    {
+      line = line.sub(line.indexOf(':') + 1);
+    }
+
+    line = line.trim();
+    if (line.empty())
+      return true;
+
+    const char *p = line.ptr;
+    uint16_t n = line.len;
+    uint16_t i = 0;
+    bool ok = true;
+    for (;;)
+    {
+      AT_Field f = {AT_Slice(), AT_FIELD_EMPTY, false};
+      while (i < n && p[i] == ' ')
+        i++;
+
+      if (i < n && p[i] == '"')
+      {
+        uint16_t start = ++i;
+        while (i < n && p[i] != '"')
+        {
+          if (p[i] == '\\' && i + 1 < n)
+          {
+            f.escaped = true;
+            i++;
+          }
+          i++;
+        }
+        f.text = AT_Slice(p + start, i - start);
+        f.type = AT_FIELD_STRING;
+        if (i < n)
+          i++; // closing quote
+        else
+          ok = false;
+        while (i < n && p[i] != ',')
+          i++;
+      }
+      else
+      {
+        uint16_t start = i;
+        while (i < n && p[i] != ',')
+          i++;
+        f.text = AT_Slice(p + start, i - start).trim();
+        f.type = f.text.empty() ? AT_FIELD_EMPTY : f.text.isInt() ? AT_FIELD_INT : AT_FIELD_TEXT;
+      }
+
+      if (_count < AT_FIELDS_MAX)
+        _fields[_count++] = f;
+      else
+        ok = false;
+
+      if (i >= n)
+        return ok;
+      i++; // comma
+    }
+  }
+
+  uint8_t count() const { return _count; }
+  const AT_Field &operator[](uint8_t i) const { return i < _count ? _fields[i] : none(); }
+  long toInt(uint8_t i, long fallback = 0) const { return (*this)[i].toInt(fallback); }
+  AT_Slice text(uint8_t i) const { return (*this)[i].text; }
+
+private:
+  static const AT_Field &none()
+  {
+    static const AT_Field empty = {AT_Slice(), AT_FIELD_EMPTY, false};
+    return empty;
+  }
+
+  AT_Field _fields[AT_FIELDS_MAX];
+  uint8_t _count = 0;
+};
+
+/* =====================================================
+ * AT RING BUFFER
+ * Fixed-size single-producer / single-consumer byte FIFO.
+ * N must be a power of two.
+ * ===================================================== */
+template <uint16_t N>
+class AT_RingBuffer
+{
+  static_assert(N && (N & (N - 1)) == 0, "AT_RingBuffer size must be a power of two");
+
+public:
+  bool push(uint8_t c)
+  {
+    if (available() == N)
+    {
+      _overflows++;
+      return false;
+    }
+    _buf[_head & (N - 1)] = c;
+    _head++;
+    return true;
+  }
+
+  int pop()
+  {
+    if (_head == _tail)
+      return -1;
+    uint8_t c = _buf[_tail & (N - 1)];
+    _tail++;
+    return c;
+  }
+
+  int peek() const { return _head == _tail ? -1 : _buf[_tail & (N - 1)]; }
+  uint16_t available() const { return (uint16_t)(_head - _tail); }
+  uint16_t space() const { return N - available(); }
+  uint32_t overflows() const { return _overflows; }
+  void clear() { _tail = _head; }
+
+private:
+  uint8_t _buf[N];
+  volatile uint16_t _head = 0;
+  volatile uint16_t _tail = 0;
+  uint32_t _overflows = 0;
+};
+
+#endif /* AT_BUFFER_H */
@@ -0,0 +1,68 @@
+#include "AT_cmd.h"
+#include <string.h>
+
+// =====================================================
+// COMMAND RENDERING
+// Appends stop one short of `size`, so a line that does
+// not fit is reported instead of sent truncated.
+// =====================================================
+static bool appendText(char *out, size_t size, size_t &len, const char *text, size_t n)
+{
+  if (len + n >= size)
+    return false;
+  memcpy(out + len, text, n);
+  len += n;
+  return true;
+}
+
+static bool appendNumber(char *out, size_t size, size_t &len, const AT_Arg &arg)
+{
+  char digits[21]; // 64-bit long and a sign
+  uint8_t n = 0;
+  bool negative = arg.kind == 'i' && arg.num < 0;
+  unsigned long v = negative ? 0UL - (unsigned long)arg.num : (unsigned long)arg.num;
+  do
+  {
+    digits[sizeof(digits) - 1 - n++] = '0' + v % 10;
+    v /= 10;
+  } while (v && n < sizeof(digits) - 1);
+  if (negative)
+    digits[sizeof(digits) - 1 - n++] = '-';
+  return appendText(out, size, len, digits + sizeof(digits) - n, n);
+}
+
+size_t AT_formatCommand(char *out, size_t size, const AT_CmdDef &cmd, const AT_Arg *args, uint8_t count)
+{
+  if (!size)
+    return 0;
+
+  size_t specLen = strlen(cmd.args);
+  if (count != specLen)
+    return 0;
+
+  size_t len = 0;
+  if (!appendText(out, size, len, cmd.text, strlen(cmd.text)))
+    return 0;
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    const AT_Arg &arg = args[i];
+    bool ok = appendText(out, size, len, i ? "," : "=", 1);
+    if (cmd.args[i] == 's')
+    {
+      ok = ok && arg.kind == 's' && arg.str &&
+           appendText(out, size, len, "\"", 1) &&
+           appendText(out, size, len, arg.str, strlen(arg.str)) &&
+           appendText(out, size, len, "\"", 1);
+    }
+    else
+    {
+      ok = ok && (arg.kind == 'i' || arg.kind == 'u') && appendNumber(out, size, len, arg);
+    }
+    if (!ok)
+      return 0;
+  }
+
+  out[len] = '\0';
+  return len;
+}
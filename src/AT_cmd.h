@@ -1,6 +1,10 @@
 #ifndef AT_CMD_H
 #define AT_CMD_H
 
+#include <stdint.h>
+#include <stddef.h>
+#include "AT_stats.h"
+
 #define AT_CMD_BASIC                 "AT"
 #define AT_CMD_ECHO_OFF              "ATE0"
 #define AT_CMD_ECHO_ON               "ATE1"
@@ -21,24 +25,127 @@
 #define AT_CMD_MQTT_STOP             "AT+CMQTTSTOP"
 
 
-// for mqtt using sim7600
+// for mqtt using sim7600; kept for existing sketches, the
+// library itself sends through the AT_Cmd table below
 #define qtt_start "AT+CMQTTSTART"  //Start MQTT service
 #define qtt_stop "AT+CMQTTSTOP" // Stop MQTT service
 #define qtt_acquire_cl "AT+CMQTTACCQ" // Acquire a MQTT client
-#define qtt_release_cl  "AT+CMQTTREL" //Release a MQTT client
+#define qtt_release_cl "AT+CMQTTREL" //Release a MQTT client
 #define qtt_ssl "AT+CMQTTSSLCFG" //Set the SSL context
 #define qtt_willTopic "AT+CMQTTWILLTOPIC" //Input the topic of will message
 #define qtt_willMsg "AT+CMQTTWILLMSG" // Input the will message
 #define qtt_connect "AT+CMQTTCONNECT" //Connect to a MQTT server
-#define qtt_disconnect"AT+CMQTTDISC"// Disconnect from server
-#define qtt_inputPubTopic "AT+CMQTTTOPIC " //Input the publish message topic
-#define qtt_inputPubMsg"AT+CMQTTPAYLOAD" //Input the publish message body
-#define qtt_pubMsg"AT+CMQTTPUB" //Publish a message to server
+#define qtt_disconnect "AT+CMQTTDISC" // Disconnect from server
+#define qtt_inputPubTopic "AT+CMQTTTOPIC" //Input the publish message topic
+#define qtt_inputPubMsg "AT+CMQTTPAYLOAD" //Input the publish message body
+#define qtt_pubMsg "AT+CMQTTPUB" //Publish a message to server
 #define qtt_inputSubTopic "AT+CMQTTSUBTOPIC" //Input a subscribe message topic
 #define qtt_subMsg "AT+CMQTTSUB" // Subscribe a message to server
 #define qtt_inputUnSubTopic "AT+CMQTTUNSUBTOPIC" //Input a unsubscribe message topic
 #define qtt_unSubMsg "AT+CMQTTUNSUB" // Unsubscribe a message to server
 #define qtt_config "AT+CMQTTCFG" // Configure the MQTT Contex
 
+#ifndef AT_CMD_LINE_MAX
+#define AT_CMD_LINE_MAX 256 // longest command line rendered from the table
+#endif
+
+/* =====================================================
+ * COMMAND DEFINITIONS
+ * One entry per command the library sends. The argument
+ * spec has one character per argument, 'i' for an
+ * integer and 's' for a quoted string; the line is
+ * rendered as text=arg,arg,... without a format parse.
+ * ===================================================== */
+typedef enum
+{
+  AT_CMD_FLAG_PROMPT = 0x01, /**< Modem answers '>' and takes a data block */
+  AT_CMD_FLAG_RESULT = 0x02  /**< `response` line, after OK, ends the command */
+} AT_cmd_flag_t;
+
+typedef struct
+{
+  const char *text;       /**< Up to the '=', e.g. "AT+CMQTTPUB" */
+  const char *args;       /**< Argument spec, "" for none */
+  const char *response;   /**< Information or result line prefix, or nullptr */
+  uint16_t timeout;       /**< Default timeout (ms) */
+  AT_cmd_family_t family; /**< Latency stats bucket */
+  uint8_t flags;          /**< AT_cmd_flag_t bits */
+} AT_CmdDef;
+
+namespace AT_Cmd
+{
+  constexpr AT_CmdDef PING = {"AT", "", nullptr, 300, AT_FAMILY_GENERIC, 0};
+  constexpr AT_CmdDef SET_BAUD = {"AT+IPR", "i", nullptr, 1000, AT_FAMILY_GENERIC, 0};
+  constexpr AT_CmdDef SET_FLOW = {"AT+IFC", "ii", nullptr, 1000, AT_FAMILY_GENERIC, 0};
+  constexpr AT_CmdDef REBOOT = {"AT+CFUN", "ii", nullptr, 1000, AT_FAMILY_GENERIC, 0};
+  constexpr AT_CmdDef SAVE_PROFILE = {"AT&W", "", nullptr, 1000, AT_FAMILY_GENERIC, 0};
+
+  constexpr AT_CmdDef TZ_REPORT_QUERY = {"AT+CTZR?", "", "+CTZR:", 1000, AT_FAMILY_GENERIC, 0};
+  constexpr AT_CmdDef TZ_UPDATE = {"AT+CTZU", "i", nullptr, 1000, AT_FAMILY_GENERIC, 0};
+  constexpr AT_CmdDef CLOCK_QUERY = {"AT+CCLK?", "", "+CCLK:", 3000, AT_FAMILY_GENERIC, 0};
+
+  constexpr AT_CmdDef CERT_LIST = {"AT+CCERTLIST", "", "+CCERTLIST:", 5000, AT_FAMILY_CERT, 0};
+  constexpr AT_CmdDef CERT_DOWNLOAD = {"AT+CCERTDOWN", "si", nullptr, 10000, AT_FAMILY_CERT, AT_CMD_FLAG_PROMPT};
+  constexpr AT_CmdDef CERT_DELETE = {"AT+CCERTDELE", "s", nullptr, 3000, AT_FAMILY_CERT, 0};
+
+  constexpr AT_CmdDef MQTT_START = {"AT+CMQTTSTART", "", nullptr, 5000, AT_FAMILY_MQTT_CONNECT, 0};
+  constexpr AT_CmdDef MQTT_STOP = {"AT+CMQTTSTOP", "", nullptr, 5000, AT_FAMILY_MQTT_CONNECT, 0};
+  constexpr AT_CmdDef MQTT_ACQUIRE = {"AT+CMQTTACCQ", "is", nullptr, 3000, AT_FAMILY_MQTT_CONNECT, 0};
+  constexpr AT_CmdDef MQTT_CONNECT = {"AT+CMQTTCONNECT", "isiiss", "+CMQTTCONNECT:", 30000,
+                                      AT_FAMILY_MQTT_CONNECT, AT_CMD_FLAG_RESULT};
+  constexpr AT_CmdDef MQTT_RELEASE = {"AT+CMQTTREL", "i", nullptr, 3000, AT_FAMILY_MQTT_CONNECT, 0};
+  constexpr AT_CmdDef MQTT_CONNECT_QUERY = {"AT+CMQTTCONNECT?", "", "+CMQTTCONNECT:", 3000, AT_FAMILY_MQTT_CONNECT, 0};
+  constexpr AT_CmdDef MQTT_DISCONNECT = {"AT+CMQTTDISC", "ii", "+CMQTTDISC:", 10000,
+                                         AT_FAMILY_MQTT_CONNECT, AT_CMD_FLAG_RESULT};
+
+  constexpr AT_CmdDef MQTT_TOPIC = {"AT+CMQTTTOPIC", "ii", nullptr, 5000, AT_FAMILY_MQTT_PUBLISH, AT_CMD_FLAG_PROMPT};
+  constexpr AT_CmdDef MQTT_PAYLOAD = {"AT+CMQTTPAYLOAD", "ii", nullptr, 5000, AT_FAMILY_MQTT_PUBLISH, AT_CMD_FLAG_PROMPT};
+  constexpr AT_CmdDef MQTT_PUBLISH = {"AT+CMQTTPUB", "iii", "+CMQTTPUB:", 5000,
+                                      AT_FAMILY_MQTT_PUBLISH, AT_CMD_FLAG_RESULT};
+  /* <retained> as a fourth argument; publish channels build it once */
+  constexpr AT_CmdDef MQTT_PUBLISH_RETAINED = {"AT+CMQTTPUB", "iiii", "+CMQTTPUB:", 5000,
+                                               AT_FAMILY_MQTT_PUBLISH, AT_CMD_FLAG_RESULT};
+  /* Done at OK; the +CMQTTPUB: result arrives later as a URC */
+  constexpr AT_CmdDef MQTT_PUBLISH_PIPELINED = {"AT+CMQTTPUB", "iii", "+CMQTTPUB:", 5000, AT_FAMILY_MQTT_PUBLISH, 0};
+
+  constexpr AT_CmdDef MQTT_SUB_TOPIC = {"AT+CMQTTSUBTOPIC", "iii", nullptr, 5000,
+                                        AT_FAMILY_MQTT_SUBSCRIBE, AT_CMD_FLAG_PROMPT};
+  constexpr AT_CmdDef MQTT_SUBSCRIBE = {"AT+CMQTTSUB", "i", "+CMQTTSUB:", 10000,
+                                        AT_FAMILY_MQTT_SUBSCRIBE, AT_CMD_FLAG_RESULT};
+  constexpr AT_CmdDef MQTT_UNSUB_TOPIC = {"AT+CMQTTUNSUBTOPIC", "ii", nullptr, 5000,
+                                          AT_FAMILY_MQTT_SUBSCRIBE, AT_CMD_FLAG_PROMPT};
+  constexpr AT_CmdDef MQTT_UNSUBSCRIBE = {"AT+CMQTTUNSUB", "ii", "+CMQTTUNSUB:", 10000,
+                                          AT_FAMILY_MQTT_SUBSCRIBE, AT_CMD_FLAG_RESULT};
+
+  constexpr AT_CmdDef SMS_FORMAT = {"AT+CMGF", "i", nullptr, 2000, AT_FAMILY_SMS, 0};
+  constexpr AT_CmdDef SMS_NOTIFY = {"AT+CNMI", "iiiii", nullptr, 2000, AT_FAMILY_SMS, 0};
+  constexpr AT_CmdDef SMS_SEND = {"AT+CMGS", "s", "+CMGS:", 10000, AT_FAMILY_SMS, AT_CMD_FLAG_PROMPT};
+  constexpr AT_CmdDef SMS_READ = {"AT+CMGR", "i", "+CMGR:", 5000, AT_FAMILY_SMS, 0};
+  constexpr AT_CmdDef SMS_DELETE = {"AT+CMGD", "ii", nullptr, 5000, AT_FAMILY_SMS, 0};
+}
+
+/* =====================================================
+ * COMMAND ARGUMENT
+ * One value for a table command, converted implicitly
+ * from the integer types and C strings call sites hold.
+ * ===================================================== */
+struct AT_Arg
+{
+  char kind = 0; // 'i' signed, 'u' unsigned, 's' string
+  long num = 0;
+  const char *str = nullptr;
+
+  AT_Arg() {}
+  AT_Arg(int v) : kind('i'), num(v) {}
+  AT_Arg(long v) : kind('i'), num(v) {}
+  AT_Arg(unsigned int v) : kind('u'), num((long)v) {}
+  AT_Arg(unsigned long v) : kind('u'), num((long)v) {}
+  AT_Arg(const char *s) : kind('s'), str(s) {}
+};
+
+/* Renders "text=arg,..." into `out` and NUL terminates.
+ * Returns the length, or 0 when the arguments do not match
+ * the spec or the line does not fit. */
+size_t AT_formatCommand(char *out, size_t size, const AT_CmdDef &cmd, const AT_Arg *args, uint8_t count);
 
 #endif
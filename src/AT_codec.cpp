@@ -0,0 +1,534 @@
+#include "AT_lib.h"
+
+// =====================================================
+// FORMAT CHECKS
+// =====================================================
+static bool isLikelyJson(const uint8_t *buf, size_t len)
+{
+  // Trim leading whitespace
+  while (len && (*buf == ' ' || *buf == '\n' || *buf == '\r' || *buf == '\t'))
+  {
+    buf++;
+    len--;
+  }
+  if (len < 2)
+    return false;
+
+  return (buf[0] == '{' && buf[len - 1] == '}') ||
+         (buf[0] == '[' && buf[len - 1] == ']');
+}
+
+bool AT_codecValid(uint8_t codec, const uint8_t *data, size_t len)
+{
+  if (!data || !len)
+    return false;
+
+  switch (AT_CODEC_FORMAT(codec))
+  {
+  case AT_CODEC_JSON:
+    return isLikelyJson(data, len);
+  case AT_CODEC_CBOR:
+    return AT_CborReader::wellFormed(data, len);
+  default:
+    return true;
+  }
+}
+
+// =====================================================
+// LZ FRAME
+// =====================================================
+#define LZ_WINDOW 4096
+#define LZ_MIN_MATCH 3
+#define LZ_MAX_MATCH 18
+#define LZ_NO_POS 0xFFFF
+
+static uint8_t lzHash(const uint8_t *p)
+{
+  return (uint8_t)((p[0] * 33 + p[1]) * 33 + p[2]);
+}
+
+// LZSS body; -1 when it does not fit `cap` or is no smaller
+// than storing
+static int32_t lzssCompress(const uint8_t *in, size_t len, uint8_t *out, size_t cap)
+{
+  if (len >= LZ_NO_POS || cap < 3)
+    return -1;
+
+  // Last position of each 3-byte hash
+  uint16_t head[256];
+  for (uint16_t h = 0; h < 256; h++)
+    head[h] = LZ_NO_POS;
+
+  out[0] = AT_LZ_LZSS;
+  out[1] = len & 0xFF;
+  out[2] = len >> 8;
+  size_t o = 3;
+  size_t i = 0;
+
+  while (i < len)
+  {
+    if (o >= cap)
+      return -1;
+    size_t flagAt = o++;
+    uint8_t flags = 0;
+
+    for (uint8_t bit = 0; bit < 8 && i < len; bit++)
+    {
+      size_t best = 0;
+      size_t offset = 0;
+      if (i + LZ_MIN_MATCH <= len)
+      {
+        uint8_t h = lzHash(in + i);
+        size_t cand = head[h];
+        head[h] = i;
+        if (cand != LZ_NO_POS && i - cand <= LZ_WINDOW)
+        {
+          size_t max = len - i < LZ_MAX_MATCH ? len - i : LZ_MAX_MATCH;
+          size_t n = 0;
+          while (n < max && in[cand + n] == in[i + n])
+            n++;
+          if (n >= LZ_MIN_MATCH)
+          {
+            best = n;
+            offset = i - cand;
+          }
+        }
+      }
+
+      if (best)
+      {
+        if (o + 2 > cap)
+          return -1;
+        out[o++] = (offset - 1) >> 4;
+        out[o++] = ((offset - 1) & 0x0F) << 4 | (best - LZ_MIN_MATCH);
+        for (size_t k = 1; k < best; k++)
+          if (i + k + LZ_MIN_MATCH <= len)
+            head[lzHash(in + i + k)] = i + k;
+        i += best;
+      }
+      else
+      {
+        if (o + 1 > cap)
+          return -1;
+        flags |= 1 << bit;
+        out[o++] = in[i++];
+      }
+    }
+    out[flagAt] = flags;
+  }
+  return o < len + 1 ? (int32_t)o : -1;
+}
+
+int32_t AT_lzCompress(const uint8_t *in, size_t len, uint8_t *out, size_t cap)
+{
+  int32_t n = lzssCompress(in, len, out, cap);
+  if (n >= 0)
+    return n;
+
+  if (len + 1 > cap)
+    return -1;
+  out[0] = AT_LZ_STORED;
+  memcpy(out + 1, in, len);
+  return len + 1;
+}
+
+int32_t AT_lzDecompress(const uint8_t *in, size_t len, uint8_t *out, size_t cap)
+{
+  if (len < 1)
+    return -1;
+
+  if (in[0] == AT_LZ_STORED)
+  {
+    if (len - 1 > cap)
+      return -1;
+    memcpy(out, in + 1, len - 1);
+    return len - 1;
+  }
+
+  if (in[0] != AT_LZ_LZSS || len < 3)
+    return -1;
+  size_t total = in[1] | (size_t)in[2] << 8;
+  if (total > cap)
+    return -1;
+
+  size_t i = 3;
+  size_t o = 0;
+  while (o < total)
+  {
+    if (i >= len)
+      return -1;
+    uint8_t flags = in[i++];
+
+    for (uint8_t bit = 0; bit < 8 && o < total; bit++)
+    {
+      if (flags & (1 << bit))
+      {
+        if (i >= len)
+          return -1;
+        out[o++] = in[i++];
+        continue;
+      }
+
+      if (i + 2 > len)
+        return -1;
+      size_t offset = ((size_t)in[i] << 4 | in[i + 1] >> 4) + 1;
+      size_t n = (in[i + 1] & 0x0F) + LZ_MIN_MATCH;
+      i += 2;
+      if (offset > o || o + n > total)
+        return -1;
+      for (; n; n--, o++)
+        out[o] = out[o - offset];
+    }
+  }
+  return i == len ? (int32_t)total : -1;
+}
+
+// =====================================================
+// CBOR WRITER
+// =====================================================
+AT_CborWriter &AT_CborWriter::write(const void *data, size_t len)
+{
+  if (_error || len > _cap - _len)
+  {
+    _error = true;
+    return *this;
+  }
+  memcpy(_buf + _len, data, len);
+  _len += len;
+  return *this;
+}
+
+AT_CborWriter &AT_CborWriter::put(uint8_t b)
+{
+  return write(&b, 1);
+}
+
+// Major type and argument, in the shortest form
+AT_CborWriter &AT_CborWriter::head(uint8_t major, uint64_t value)
+{
+  uint8_t b[9];
+  uint8_t n;
+  major <<= 5;
+  if (value < 24)
+  {
+    b[0] = major | (uint8_t)value;
+    n = 1;
+  }
+  else if (value <= 0xFF)
+  {
+    b[0] = major | 24;
+    n = 2;
+  }
+  else if (value <= 0xFFFF)
+  {
+    b[0] = major | 25;
+    n = 3;
+  }
+  else if (value <= 0xFFFFFFFFUL)
+  {
+    b[0] = major | 26;
+    n = 5;
+  }
+  else
+  {
+    b[0] = major | 27;
+    n = 9;
+  }
+  for (uint8_t i = n - 1; i >= 1; i--, value >>= 8)
+    b[i] = value & 0xFF;
+  return write(b, n);
+}
+
+AT_CborWriter &AT_CborWriter::string(const char *text, size_t len)
+{
+  head(3, len);
+  return write(text, len);
+}
+
+AT_CborWriter &AT_CborWriter::bytes(const uint8_t *data, size_t len)
+{
+  head(2, len);
+  return write(data, len);
+}
+
+AT_CborWriter &AT_CborWriter::integer(int64_t value)
+{
+  if (value >= 0)
+    return head(0, (uint64_t)value);
+  return head(1, (uint64_t)(-1 - value));
+}
+
+AT_CborWriter &AT_CborWriter::number(double value)
+{
+  uint8_t b[9];
+  float f = (float)value;
+  if ((double)f == value || value != value)
+  {
+    uint32_t bits;
+    memcpy(&bits, &f, 4);
+    b[0] = 0xFA;
+    for (uint8_t i = 4; i >= 1; i--, bits >>= 8)
+      b[i] = bits & 0xFF;
+    return write(b, 5);
+  }
+
+  uint64_t bits;
+  memcpy(&bits, &value, 8);
+  b[0] = 0xFB;
+  for (uint8_t i = 8; i >= 1; i--, bits >>= 8)
+    b[i] = bits & 0xFF;
+  return write(b, 9);
+}
+
+// =====================================================
+// CBOR READER
+// =====================================================
+static double halfToDouble(uint16_t h)
+{
+  int exp = (h >> 10) & 0x1F;
+  int mant = h & 0x3FF;
+  double v;
+  if (exp == 0)
+    v = ldexp(mant, -24);
+  else if (exp != 31)
+    v = ldexp(mant + 1024, exp - 25);
+  else
+    v = mant ? NAN : INFINITY;
+  return h & 0x8000 ? -v : v;
+}
+
+AT_cbor_type_t AT_CborReader::next()
+{
+  _str = nullptr;
+  if (_p >= _end)
+    return _type = AT_CBOR_END;
+
+  uint8_t ib = *_p++;
+  uint8_t major = ib >> 5;
+  uint8_t info = ib & 0x1F;
+
+  uint64_t v = info;
+  if (info >= 24)
+  {
+    if (info > 27)
+      return _type = AT_CBOR_INVALID; // reserved or indefinite length
+    size_t n = (size_t)1 << (info - 24);
+    if ((size_t)(_end - _p) < n)
+      return _type = AT_CBOR_INVALID;
+    v = 0;
+    while (n--)
+      v = v << 8 | *_p++;
+  }
+  _value = v;
+
+  switch (major)
+  {
+  case 0:
+    return _type = AT_CBOR_UINT;
+  case 1:
+    return _type = AT_CBOR_NEGINT;
+  case 2:
+  case 3:
+    if (v > (uint64_t)(_end - _p))
+      return _type = AT_CBOR_INVALID;
+    _str = _p;
+    _p += v;
+    return _type = major == 2 ? AT_CBOR_BYTES : AT_CBOR_TEXT;
+  case 4:
+    return _type = AT_CBOR_ARRAY;
+  case 5:
+    return _type = AT_CBOR_MAP;
+  case 6:
+    return _type = AT_CBOR_TAG;
+  default:
+    break;
+  }
+
+  // Major 7: simple values and floats
+  switch (info)
+  {
+  case 20:
+  case 21:
+    _value = info == 21;
+    return _type = AT_CBOR_BOOL;
+  case 22:
+    return _type = AT_CBOR_NULL;
+  case 23:
+    return _type = AT_CBOR_UNDEFINED;
+  case 25:
+    _float = halfToDouble((uint16_t)v);
+    return _type = AT_CBOR_FLOAT;
+  case 26:
+  {
+    uint32_t bits = (uint32_t)v;
+    float f;
+    memcpy(&f, &bits, 4);
+    _float = f;
+    return _type = AT_CBOR_FLOAT;
+  }
+  case 27:
+    memcpy(&_float, &v, 8);
+    return _type = AT_CBOR_FLOAT;
+  default:
+    return _type = AT_CBOR_INVALID;
+  }
+}
+
+// Items still owed by a container head, bounded by the bytes
+// left since each item takes at least one. A tag is followed
+// by exactly one item; its count is the tag number.
+static bool addPending(AT_cbor_type_t type, uint64_t count, uint64_t &pending, size_t remaining)
+{
+  if (type != AT_CBOR_ARRAY && type != AT_CBOR_MAP && type != AT_CBOR_TAG)
+    return true;
+  if (type != AT_CBOR_TAG && count > remaining)
+    return false;
+  uint64_t add = type == AT_CBOR_ARRAY ? count : type == AT_CBOR_MAP ? count * 2 : 1;
+  if (add > remaining - pending)
+    return false;
+  pending += add;
+  return true;
+}
+
+bool AT_CborReader::skip()
+{
+  uint64_t pending = 0;
+  if (!addPending(_type, _value, pending, remaining()))
+    return false;
+
+  while (pending)
+  {
+    AT_cbor_type_t t = next();
+    if (t == AT_CBOR_END || t == AT_CBOR_INVALID)
+      return false;
+    pending--;
+    if (!addPending(t, _value, pending, remaining()))
+      return false;
+  }
+  return true;
+}
+
+bool AT_CborReader::wellFormed(const uint8_t *data, size_t len)
+{
+  AT_CborReader r(data, len);
+  AT_cbor_type_t t = r.next();
+  if (t == AT_CBOR_END || t == AT_CBOR_INVALID)
+    return false;
+  return r.skip() && r.remaining() == 0;
+}
+
+int64_t AT_CborReader::toInt() const
+{
+  switch (_type)
+  {
+  case AT_CBOR_UINT:
+    return (int64_t)_value;
+  case AT_CBOR_NEGINT:
+    return -1 - (int64_t)_value;
+  case AT_CBOR_FLOAT:
+    return (int64_t)_float;
+  default:
+    return 0;
+  }
+}
+
+double AT_CborReader::toDouble() const
+{
+  if (_type == AT_CBOR_FLOAT)
+    return _float;
+  if (_type == AT_CBOR_NEGINT)
+    return -1.0 - (double)_value;
+  return _type == AT_CBOR_UINT ? (double)_value : 0;
+}
+
+bool AT_CborReader::textEquals(const char *s) const
+{
+  size_t n = strlen(s);
+  return _type == AT_CBOR_TEXT && _value == n && memcmp(_str, s, n) == 0;
+}
+
+// =====================================================
+// AT_LIB PAYLOAD CODECS
+// Topic filters pick the codec; the first match wins and
+// other topics use the default (JSON, as before codecs).
+// Received payloads are unframed and checked before any
+// handler sees them; published ones are framed on the
+// way out, after the outbox, which keeps them as given.
+// =====================================================
+bool AT_Lib::setCodec(const char *filter, uint8_t codec)
+{
+  AT_GUARD();
+  if (!AT_TopicTable::valid(filter) || strlen(filter) >= AT_MQTT_FILTER_MAX)
+  {
+    AT_LOGW("[CODEC] Invalid filter");
+    return false;
+  }
+
+  for (uint8_t i = 0; i < _codecCount; i++)
+  {
+    if (strcmp(_codecs[i].filter, filter) == 0)
+    {
+      _codecs[i].codec = codec;
+      _codecVersion++;
+      return true;
+    }
+  }
+  if (_codecCount >= AT_CODEC_ROUTES)
+  {
+    AT_LOGW("[CODEC] Codec table full");
+    return false;
+  }
+  strcpy(_codecs[_codecCount].filter, filter);
+  _codecs[_codecCount].codec = codec;
+  _codecCount++;
+  _codecVersion++;
+  return true;
+}
+
+uint8_t AT_Lib::codecFor(const char *topic) const
+{
+  for (uint8_t i = 0; i < _codecCount; i++)
+    if (AT_TopicTable::matches(_codecs[i].filter, topic))
+      return _codecs[i].codec;
+  return _defaultCodec;
+}
+
+// The payload as it goes on the air; nullptr when its frame
+// would not fit a publish
+// A channel looks its codec up again only after the table changed
+const uint8_t *AT_Lib::encodePayload(AT_PublishChannel &channel, const uint8_t *payload, uint16_t &length)
+{
+  if (channel._codecVersion != _codecVersion)
+  {
+    channel._codec = codecFor(channel._topic);
+    channel._codecVersion = _codecVersion;
+  }
+  if (!(channel._codec & AT_CODEC_LZ))
+    return payload;
+
+  int32_t n = AT_lzCompress(payload, length, _codecTx, MQTT_PAYLOAD_MAX);
+  if (n < 0)
+  {
+    AT_LOGW("[CODEC] Payload for %s too large once framed", channel._topic);
+    return nullptr;
+  }
+  if ((uint32_t)n < length)
+    _stats.codecSaved += length - n;
+  length = n;
+  return _codecTx;
+}
+
+bool AT_Lib::decodePayload(const char *topic, const char *&payload, uint16_t &length)
+{
+  uint8_t codec = codecFor(topic);
+  if (codec & AT_CODEC_LZ)
+  {
+    int32_t n = AT_lzDecompress((const uint8_t *)payload, length, (uint8_t *)_codecRx, MQTT_PAYLOAD_MAX);
+    if (n < 0)
+      return false;
+    _codecRx[n] = '\0';
+    payload = _codecRx;
+    length = n;
+  }
+  return AT_codecValid(codec, (const uint8_t *)payload, length);
+}
@@ -0,0 +1,144 @@
+#ifndef AT_CODEC_H
+#define AT_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Payload codec of a topic: a format, optionally LZ-framed */
+typedef enum
+{
+  AT_CODEC_JSON = 0x00, /**< JSON object or array */
+  AT_CODEC_CBOR = 0x01, /**< One well-formed CBOR item (RFC 8949) */
+  AT_CODEC_RAW = 0x02,  /**< Any non-empty bytes */
+  AT_CODEC_LZ = 0x80    /**< Flag: payload travels as an LZ frame */
+} AT_codec_t;
+
+#define AT_CODEC_FORMAT(codec) ((codec) & 0x7F)
+
+/* Checks a decoded payload against the format of `codec` */
+bool AT_codecValid(uint8_t codec, const uint8_t *data, size_t len);
+
+/* =====================================================
+ * LZ FRAME
+ * <method> <body>
+ *   0x00  stored: the payload as is
+ *   0x01  LZSS: <length u16 LE> then groups of a flag byte
+ *         (bit set = literal, LSB first) and 8 items:
+ *           literal  1 byte
+ *           match    2 bytes, <offset-1 : 12> <length-3 : 4>
+ * Offsets reach back 4 KiB, matches are 3..18 bytes. The
+ * compressor keeps a 512-byte hash table on the stack and
+ * stores when LZSS would not be smaller.
+ * ===================================================== */
+#define AT_LZ_STORED 0x00
+#define AT_LZ_LZSS 0x01
+
+/* Frame length, or -1 when it does not fit `cap` */
+int32_t AT_lzCompress(const uint8_t *in, size_t len, uint8_t *out, size_t cap);
+/* Payload length, or -1 when the frame is corrupt or too big */
+int32_t AT_lzDecompress(const uint8_t *in, size_t len, uint8_t *out, size_t cap);
+
+/* =====================================================
+ * CBOR WRITER
+ * Streams items into a caller buffer; never allocates.
+ * Containers have definite lengths, given up front. An
+ * item that does not fit sets the error, after which
+ * nothing more is written.
+ * ===================================================== */
+class AT_CborWriter
+{
+public:
+  AT_CborWriter(uint8_t *buffer, size_t size) : _buf(buffer), _cap(size) {}
+
+  AT_CborWriter &map(uint32_t pairs) { return head(5, pairs); }
+  AT_CborWriter &array(uint32_t items) { return head(4, items); }
+  AT_CborWriter &key(const char *text) { return string(text); }
+
+  AT_CborWriter &string(const char *text) { return string(text, text ? strlen(text) : 0); }
+  AT_CborWriter &string(const char *text, size_t len);
+  AT_CborWriter &bytes(const uint8_t *data, size_t len);
+  AT_CborWriter &integer(int64_t value);
+  AT_CborWriter &uinteger(uint64_t value) { return head(0, value); }
+  /* float32 when it holds `value` exactly, else float64 */
+  AT_CborWriter &number(double value);
+  AT_CborWriter &boolean(bool value) { return put(value ? 0xF5 : 0xF4); }
+  AT_CborWriter &null() { return put(0xF6); }
+
+  bool ok() const { return !_error; }
+  size_t length() const { return _len; }
+  const uint8_t *data() const { return _buf; }
+  void reset()
+  {
+    _len = 0;
+    _error = false;
+  }
+
+private:
+  AT_CborWriter &head(uint8_t major, uint64_t value);
+  AT_CborWriter &put(uint8_t b);
+  AT_CborWriter &write(const void *data, size_t len);
+
+  uint8_t *_buf;
+  size_t _cap;
+  size_t _len = 0;
+  bool _error = false;
+};
+
+typedef enum
+{
+  AT_CBOR_UINT = 0,
+  AT_CBOR_NEGINT,
+  AT_CBOR_BYTES,
+  AT_CBOR_TEXT,
+  AT_CBOR_ARRAY,
+  AT_CBOR_MAP,
+  AT_CBOR_TAG,
+  AT_CBOR_FLOAT,
+  AT_CBOR_BOOL,
+  AT_CBOR_NULL,
+  AT_CBOR_UNDEFINED,
+  AT_CBOR_END,    /**< No more bytes */
+  AT_CBOR_INVALID /**< Malformed or unsupported (indefinite length) */
+} AT_cbor_type_t;
+
+/* =====================================================
+ * CBOR READER
+ * Pull parser over a received payload. next() reads one
+ * item head; strings are views into the payload and a
+ * container only announces its count, its items follow
+ * as further next() calls (skip() passes over them).
+ * ===================================================== */
+class AT_CborReader
+{
+public:
+  AT_CborReader(const uint8_t *data, size_t len) : _p(data), _end(data + len) {}
+
+  AT_cbor_type_t next();
+  /* Passes over the items of the container just read */
+  bool skip();
+
+  AT_cbor_type_t type() const { return _type; }
+  uint64_t count() const { return _value; } // array items, map pairs, string bytes
+  int64_t toInt() const;
+  double toDouble() const;
+  bool toBool() const { return _type == AT_CBOR_BOOL && _value; }
+  const char *text() const { return (const char *)_str; } // not NUL-terminated, count() bytes
+  const uint8_t *bytes() const { return _str; }
+  bool textEquals(const char *s) const;
+
+  size_t remaining() const { return _end - _p; }
+
+  /* Exactly one complete item with definite lengths */
+  static bool wellFormed(const uint8_t *data, size_t len);
+
+private:
+  const uint8_t *_p;
+  const uint8_t *_end;
+  AT_cbor_type_t _type = AT_CBOR_END;
+  uint64_t _value = 0;
+  double _float = 0;
+  const uint8_t *_str = nullptr;
+};
+
+#endif /* AT_CODEC_H */
@@ -1,52 +1,486 @@
-#include "AT_Lib.h"
+#include "AT_lib.h"
 #include <time.h>
+#include <stdarg.h>
 #include "Sim76xx_mqtt_errors.h"
 
+static_assert(AT_URC_USER_MAX <= 20, "user URC routes share a 32-bit match mask with built-in tokens");
+
 AT_Lib::AT_Lib(HardwareSerial &modemSerial, Stream &debugSerial)
-    : _modemSerial(modemSerial), _debugSerial(debugSerial) {}
+    : _modemSerial(modemSerial), _modemUart(&modemSerial), _debugSerial(debugSerial)
+{
+  buildMatcher();
+}
+
+AT_Lib::AT_Lib(Stream &modemStream, Stream &debugSerial)
+    : _modemSerial(modemStream), _modemUart(nullptr), _debugSerial(debugSerial)
+{
+  buildMatcher();
+}
+
+#if AT_UART_EVENTS
+AT_Lib::AT_Lib(AT_UartEvents &modemUart, Stream &debugSerial)
+    : _modemSerial(modemUart), _modemUart(nullptr), _modemEvents(&modemUart), _debugSerial(debugSerial)
+{
+  buildMatcher();
+}
+#endif
 
 bool AT_Lib::begin(unsigned long baud, int8_t rxPin, int8_t txPin)
 {
-  _modemSerial.begin(baud, SERIAL_8N1, rxPin, txPin);
-  delay(100);
+  _baseBaud = _baud = baud;
+  _rxPin = rxPin;
+  _txPin = txPin;
+  if (_modemUart)
+  {
+    _modemUart->begin(baud, SERIAL_8N1, rxPin, txPin);
+    delay(100);
+  }
+#if AT_UART_EVENTS
+  if (_modemEvents && !_modemEvents->begin(baud, rxPin, txPin))
+  {
+    AT_LOGE("[UART] Driver install failed");
+    return false;
+  }
+#endif
   return true;
 }
 
+bool AT_Lib::begin(unsigned long baud, int8_t rxPin, int8_t txPin, unsigned long fastBaud,
+                   int8_t rtsPin, int8_t ctsPin)
+{
+  _fastBaud = fastBaud;
+  _rtsPin = rtsPin;
+  _ctsPin = ctsPin;
+  _linkPending = true;
+  return begin(baud, rxPin, txPin);
+}
+
+// =====================================================
+// UART LINK
+// AT+IPR and AT+IFC answer OK at the old settings and
+// switch right after, so the local UART follows the OK.
+// =====================================================
+bool AT_Lib::setBaudRate(unsigned long baud, uint32_t timeout)
+{
+  AT_GUARD();
+  if (baud == _baud)
+    return true;
+
+  if (command(AT_Cmd::SET_BAUD, timeout, baud) != AT_RESULT_OK)
+  {
+    AT_LOGW("[UART] Modem rejected %lu baud", baud);
+    return false;
+  }
+
+  unsigned long oldBaud = _baud;
+  switchBaud(baud);
+  if (probeLink(timeout))
+  {
+    AT_LOGI("[UART] Link running at %lu baud", baud);
+    return true;
+  }
+
+  // The modem may have switched while the wiring cannot keep up:
+  // ask it back at the new rate, then verify at the old one
+  AT_LOGW("[UART] No answer at %lu baud, falling back", baud);
+  command(AT_Cmd::SET_BAUD, 200, oldBaud);
+  switchBaud(oldBaud);
+  if (!probeLink(timeout))
+    AT_LOGE("[UART][ERROR] Link lost after baud change");
+  return false;
+}
+
+bool AT_Lib::enableFlowControl(int8_t rtsPin, int8_t ctsPin, uint32_t timeout)
+{
+  AT_GUARD();
+#if defined(ARDUINO_ARCH_ESP32)
+  if (rtsPin < 0 || ctsPin < 0 || !(_modemUart || _modemEvents))
+    return false;
+
+  // RTS/CTS in both directions
+  if (command(AT_Cmd::SET_FLOW, timeout, 2, 2) != AT_RESULT_OK)
+  {
+    AT_LOGW("[UART] Modem rejected hardware flow control");
+    return false;
+  }
+
+  _modemSerial.flush();
+  setUartFlowControl(rtsPin, ctsPin);
+  _rtsPin = rtsPin;
+  _ctsPin = ctsPin;
+  AT_LOGI("[UART] RTS/CTS flow control enabled");
+  return probeLink(timeout);
+#else
+  AT_LOGW("[UART] Hardware flow control needs an ESP32 UART");
+  return false;
+#endif
+}
+
+void AT_Lib::switchBaud(unsigned long baud)
+{
+  _baud = baud;
+  if (!_modemUart && !_modemEvents)
+    return;
+
+  _modemSerial.flush();
+  delay(20); // let the modem finish switching after its OK
+  setUartBaud(baud);
+
+  // Anything in flight was sampled at the wrong rate
+  while (_modemSerial.available())
+    _modemSerial.read();
+  _rx.clear();
+  _lineLen = 0;
+  _match.reset();
+}
+
+// Local side of the link, on whichever driver runs the UART
+void AT_Lib::setUartBaud(unsigned long baud)
+{
+#if AT_UART_EVENTS
+  if (_modemEvents)
+  {
+    _modemEvents->setBaudRate(baud);
+    return;
+  }
+#endif
+#if defined(ARDUINO_ARCH_ESP32)
+  _modemUart->updateBaudRate(baud);
+#else
+  _modemUart->begin(baud, SERIAL_8N1, _rxPin, _txPin);
+#endif
+}
+
+void AT_Lib::setUartFlowControl(int8_t rtsPin, int8_t ctsPin)
+{
+#if AT_UART_EVENTS
+  if (_modemEvents)
+  {
+    _modemEvents->setFlowControl(rtsPin, ctsPin);
+    return;
+  }
+#endif
+#if defined(ARDUINO_ARCH_ESP32)
+  if (!_modemUart)
+    return;
+  if (rtsPin < 0 || ctsPin < 0)
+  {
+    _modemUart->setHwFlowCtrlMode(UART_HW_FLOWCTRL_DISABLE, 64);
+    return;
+  }
+  _modemUart->setPins(_rxPin, _txPin, ctsPin, rtsPin);
+  _modemUart->setHwFlowCtrlMode(UART_HW_FLOWCTRL_CTS_RTS, 64);
+#endif
+}
+
+bool AT_Lib::probeLink(uint32_t timeout)
+{
+  uint32_t start = millis();
+  do
+  {
+    if (command(AT_Cmd::PING, 200) == AT_RESULT_OK)
+      return true;
+  } while (millis() - start < timeout);
+  return false;
+}
+
+// Applies the link settings passed to begin() once the modem answers
+void AT_Lib::applyLink()
+{
+  _linkPending = false;
+
+  if (_rtsPin >= 0 && _ctsPin >= 0)
+    enableFlowControl(_rtsPin, _ctsPin);
+  if (_fastBaud)
+    setBaudRate(_fastBaud);
+}
+
+// =====================================================
+// LOGGING
+// Only reached through the AT_LOGx macros, so anything
+// above AT_LOG_LEVEL or the runtime level costs nothing
+// =====================================================
+void AT_Lib::logPrintf(AT_log_level_t level, const char *format, ...)
+{
+  char msg[AT_LOG_LINE_MAX];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(msg, sizeof(msg), format, args);
+  va_end(args);
+
+  if (n < 0)
+    return;
+
+  if (_logSink)
+    _logSink(level, msg, _logUser);
+  else
+    _debugSerial.println(msg);
+}
+
 // =====================================================
 // BASIC COMMAND SEND
 // =====================================================
-String AT_Lib::sendCommand(const char *command, uint32_t timeout)
+String AT_Lib::sendCommand(const char *command, uint32_t timeout, const char *terminator, AT_result_t *resultOut)
 {
-  _modemSerial.println(command);
-  return readUntilTimeout(timeout);
+  AT_GUARD();
+  AT_result_t result = this->command(command, timeout, terminator);
+  if (resultOut)
+  {
+    *resultOut = result;
+  }
+  return String(_resp);
 }
 
 String AT_Lib::sendFormatted(const char *format, const char *value, uint32_t timeout)
 {
+  AT_GUARD();
   char buffer[128];
   snprintf(buffer, sizeof(buffer), format, value);
   return sendCommand(buffer, timeout);
 }
 
+// Heap-free variant: the response stays in the internal
+// buffer and is read back through response().
+AT_result_t AT_Lib::command(const char *command, uint32_t timeout, const char *terminator)
+{
+  AT_GUARD();
+  writeCommand(command);
+  return awaitResult(timeout, terminator);
+}
+
+// Blocking helpers never interleave with a transaction chain
+// the async engine has already started.
+void AT_Lib::writeCommand(const char *command)
+{
+  waitAsyncIdle();
+  AT_LOGT(">> %s", command);
+  statBegin(command);
+  modemPrint(command);
+  modemPrint("\r\n");
+}
+
+// A line prebuilt from a table entry, e.g. by a publish channel
+void AT_Lib::writeLine(const char *line, AT_cmd_family_t family)
+{
+  waitAsyncIdle();
+  AT_LOGT(">> %s", line);
+  statBegin(family);
+  modemPrint(line);
+  modemPrint("\r\n");
+}
+
+// Table commands are rendered straight from their entry
+// and go out in a single write, line ending included.
+bool AT_Lib::writeArgs(const AT_CmdDef &cmd, const AT_Arg *args, uint8_t count)
+{
+  char line[AT_CMD_LINE_MAX];
+  size_t len = AT_formatCommand(line, sizeof(line) - 2, cmd, args, count);
+  if (!len)
+  {
+    AT_LOGE("[CMD] %s: arguments do not match or line too long", cmd.text);
+    _respLen = 0;
+    _resp[0] = '\0';
+    return false;
+  }
+
+  waitAsyncIdle();
+  AT_LOGT(">> %s", line);
+  statBegin(cmd.family);
+  line[len++] = '\r';
+  line[len++] = '\n';
+  modemWrite((const uint8_t *)line, len);
+  return true;
+}
+
+AT_result_t AT_Lib::commandArgs(const AT_CmdDef &cmd, uint32_t timeout, const AT_Arg *args, uint8_t count)
+{
+  AT_GUARD();
+  if (!writeArgs(cmd, args, count))
+    return AT_RESULT_ERROR;
+  return awaitResult(timeout ? timeout : cmd.timeout,
+                     (cmd.flags & AT_CMD_FLAG_RESULT) ? cmd.response : nullptr);
+}
+
+// Every byte to the modem goes through here
+void AT_Lib::modemWrite(const uint8_t *data, size_t len)
+{
+  size_t n = _modemSerial.write(data, len);
+  _stats.bytesOut += n;
+  if (_trace)
+    _trace->record(AT_TRACE_TX, data, n);
+}
+
+void AT_Lib::modemPrint(const char *text)
+{
+  modemWrite((const uint8_t *)text, strlen(text));
+}
+
 // =====================================================
-// TIMEOUT-BASED READER
+// RESPONSE READER
+// Returns as soon as a final result code arrives instead
+// of always waiting out the timeout.
 // =====================================================
-String AT_Lib::readUntilTimeout(uint32_t timeout)
+#define TOKEN(t) ((AT_match_mask_t)1 << (t))
+
+AT_result_t AT_Lib::classifyLine(const char *line, const char *terminator) const
 {
-  String response = "";
-  uint32_t start = millis();
+  if (terminator && strncmp(line, terminator, strlen(terminator)) == 0)
+    return AT_RESULT_TERMINATOR;
+  if (_lineTokens & TOKEN(TOK_ERROR))
+    return AT_RESULT_ERROR;
+  if (_lineTokens & TOKEN(TOK_CME_ERROR))
+    return AT_RESULT_CME_ERROR;
+  if (_lineTokens & TOKEN(TOK_CMS_ERROR))
+    return AT_RESULT_CMS_ERROR;
+  // With a terminator pending, OK only acknowledges the command
+  if (!terminator && (_lineTokens & TOKEN(TOK_OK)))
+    return AT_RESULT_OK;
+  return AT_RESULT_TIMEOUT;
+}
 
-  while (millis() - start < timeout)
+String AT_Lib::readResponse(uint32_t timeout, const char *terminator, AT_result_t *resultOut)
+{
+  AT_GUARD();
+  AT_result_t result = awaitResult(timeout, terminator);
+  if (resultOut)
   {
-    while (_modemSerial.available())
+    *resultOut = result;
+  }
+  return String(_resp);
+}
+
+// Moves whatever the UART has into the receive ring
+void AT_Lib::pumpModem()
+{
+  uint8_t seen[32]; // batched for the trace
+  size_t n = 0;
+
+  while (_rx.space() && _modemSerial.available())
+  {
+    uint8_t b = _modemSerial.read();
+    _rx.push(b);
+    _stats.bytesIn++;
+
+    if (_trace)
     {
-      char c = _modemSerial.read();
-      response += c;
-      _debugSerial.write(c);
+      seen[n++] = b;
+      if (n == sizeof(seen))
+      {
+        _trace->record(AT_TRACE_RX, seen, n);
+        n = 0;
+      }
     }
   }
-  _debugSerial.println();
-  return response;
+
+  if (n)
+    _trace->record(AT_TRACE_RX, seen, n);
+}
+
+// Sleeps until the modem sends something or `ms` passes. Without
+// an event-driven UART it returns at once and waits keep polling.
+void AT_Lib::waitModem(uint32_t ms)
+{
+#if AT_UART_EVENTS
+  if (_modemEvents && !_rx.available())
+    _modemEvents->wait(ms);
+#endif
+}
+
+void AT_Lib::appendResponse(char c)
+{
+  if (_respLen < AT_RESPONSE_MAX - 1)
+  {
+    _resp[_respLen++] = c;
+  }
+  else
+  {
+    _respTruncated = true;
+  }
+}
+
+void AT_Lib::beginResponse(const char *terminator)
+{
+  _respLen = 0;
+  _respLineStart = 0;
+  _respTruncated = false;
+  _respTerminator = terminator;
+  _resp[0] = '\0';
+}
+
+// Consumes whatever is in the receive ring. Returns the final
+// result once seen, AT_RESULT_TIMEOUT while still pending.
+AT_result_t AT_Lib::collectResponse()
+{
+  AT_result_t result = AT_RESULT_TIMEOUT;
+
+  int b;
+  while (result == AT_RESULT_TIMEOUT && (b = _rx.pop()) >= 0)
+  {
+    char c = (char)b;
+
+    // Binary MQTT RX data is never part of a response
+    if (feedMqttData(c))
+      continue;
+
+    appendResponse(c);
+
+    if (c == '>' && _lineLen == 0)
+    {
+      result = AT_RESULT_PROMPT;
+      break;
+    }
+
+    if (!feedLine(c))
+    {
+      if (c == '\n')
+        _respLineStart = _respLen;
+      continue;
+    }
+    AT_LOGT("<< %s", _line);
+
+    // URCs interleaved with the response are routed as they
+    // arrive; MQTT RX headers are cut out of the response.
+    result = classifyLine(_line, _respTerminator);
+    if (result != AT_RESULT_TIMEOUT)
+      break;
+
+    if (dispatchLine(_line, strlen(_line)))
+      _respLen = _respLineStart;
+    _respLineStart = _respLen;
+  }
+
+  _resp[_respLen] = '\0';
+  return result;
+}
+
+void AT_Lib::endResponse()
+{
+  if (_respTruncated)
+  {
+    _stats.responseTruncated++;
+    AT_LOGW("[AT] Response truncated");
+  }
+}
+
+AT_result_t AT_Lib::awaitResult(uint32_t timeout, const char *terminator)
+{
+  AT_GUARD();
+  AT_result_t result = AT_RESULT_TIMEOUT;
+  uint32_t start = millis();
+
+  beginResponse(terminator);
+  for (uint32_t elapsed = 0; elapsed < timeout; elapsed = millis() - start)
+  {
+    pumpModem();
+    result = collectResponse();
+    if (result != AT_RESULT_TIMEOUT)
+      break;
+    waitModem(timeout - elapsed);
+  }
+  endResponse();
+  statEnd(result);
+
+  return result;
 }
 
 // =====================================================
@@ -54,28 +488,40 @@ String AT_Lib::readUntilTimeout(uint32_t timeout)
 // =====================================================
 bool AT_Lib::waitForPBDONE(uint32_t timeout)
 {
-  _debugSerial.println("Waiting for PB DONE...");
+  AT_GUARD();
+  AT_LOGI("Waiting for PB DONE...");
 
   uint32_t start = millis();
-  String buffer = "";
 
   while (millis() - start < timeout)
   {
-    while (_modemSerial.available())
+    pumpModem();
+
+    int b;
+    while ((b = _rx.pop()) >= 0)
     {
-      char c = _modemSerial.read();
-      buffer += c;
-      _debugSerial.write(c);
+      char c = (char)b;
+      if (feedMqttData(c))
+        continue;
+
+      if (!feedLine(c))
+        continue;
+      AT_LOGT("<< %s", _line);
 
-      if (buffer.indexOf("PB DONE") >= 0)
+      if (_lineTokens & TOKEN(TOK_PB_DONE))
       {
-        _debugSerial.println("\n[PBDONE] Modem finished booting!");
+        AT_LOGI("[PBDONE] Modem finished booting!");
         return true;
       }
+      dispatchLine(_line, strlen(_line));
     }
+
+    uint32_t elapsed = millis() - start;
+    if (elapsed < timeout)
+      waitModem(timeout - elapsed);
   }
 
-  _debugSerial.println("\n[ERROR] Timeout waiting for PB DONE!");
+  AT_LOGE("[ERROR] Timeout waiting for PB DONE!");
   return false;
 }
 
@@ -85,277 +531,756 @@ bool AT_Lib::waitForPBDONE(uint32_t timeout)
 // =====================================================
 bool AT_Lib::modemReady(uint32_t timeout)
 {
+  AT_GUARD();
   uint32_t start = millis();
 
   while (millis() - start < timeout)
   {
-    _debugSerial.println("Checking modem ready...");
-    String res = sendCommand("AT", 300);
-
-    if (res.indexOf("OK") >= 0)
+    AT_LOGD("Checking modem ready...");
+    if (command(AT_Cmd::PING, 0) == AT_RESULT_OK)
     {
-      _debugSerial.println("[READY] Modem responded to AT.");
+      AT_LOGI("[READY] Modem responded to AT.");
+      if (_linkPending)
+        applyLink();
       return true;
     }
     delay(200);
   }
 
-  _debugSerial.println("[ERROR] Modem not responding to AT.");
-  return false;
+  AT_LOGE("[ERROR] Modem not responding to AT.");
+  return false;
+}
+
+// =====================================================
+// LINE ASSEMBLER
+// Every byte read from the modem passes through here
+// exactly once. Returns true when _line holds a complete
+// line (CR/LF stripped, NUL terminated).
+// =====================================================
+bool AT_Lib::feedLine(char c)
+{
+  if (c == '\r')
+    return false;
+
+  if (c == '\n')
+  {
+    _line[_lineLen] = '\0';
+    bool complete = _lineLen > 0;
+    _lineLen = 0;
+    _lineTokens = _match.matched();
+    _match.reset();
+    if (_lineTruncated)
+    {
+      _stats.lineTruncated++;
+      _lineTruncated = false;
+    }
+    return complete;
+  }
+
+  _match.feed(c);
+  if (_lineLen < AT_LINE_MAX - 1)
+  {
+    _line[_lineLen++] = c;
+  }
+  else
+  {
+    _lineTruncated = true;
+  }
+  return false;
+}
+
+// =====================================================
+// URC DISPATCH TABLE
+// Built-in routes, matched by prefix before user routes
+// =====================================================
+const AT_Lib::UrcRoute AT_Lib::URC_ROUTES[URC_ROUTE_COUNT] = {
+    {"+CMQTTRX", &AT_Lib::handleMqttRx},
+    {"+CMTI:", &AT_Lib::handleCmti},
+    {"+CMQTTCONNLOST:", &AT_Lib::handleConnLost},
+    {"+CTZV:", &AT_Lib::handleCtzv},
+    {"+CREG:", &AT_Lib::handleCreg},
+    {"+CMQTTNONET", &AT_Lib::handleNoNet},
+    {"+CMQTTPUB:", &AT_Lib::handlePubResult},
+};
+
+bool AT_Lib::onURC(const char *prefix, urc_callback_t cb)
+{
+  AT_GUARD();
+  if (!prefix || !prefix[0] || !cb)
+    return false;
+
+  UserUrc *freeSlot = nullptr;
+  for (uint8_t i = 0; i < AT_URC_USER_MAX; i++)
+  {
+    if (_userUrcs[i].cb && strcmp(_userUrcs[i].prefix, prefix) == 0)
+    {
+      _userUrcs[i].cb = cb;
+      return true;
+    }
+    if (!_userUrcs[i].cb && !freeSlot)
+      freeSlot = &_userUrcs[i];
+  }
+
+  if (!freeSlot)
+  {
+    AT_LOGW("[URC] Route table full");
+    return false;
+  }
+
+  freeSlot->prefix = prefix;
+  freeSlot->prefixLen = strlen(prefix);
+  freeSlot->cb = cb;
+  if (!buildMatcher())
+  {
+    freeSlot->cb = nullptr;
+    buildMatcher();
+    AT_LOGW("[URC] Out of matcher nodes, raise AT_MATCH_NODES");
+    return false;
+  }
+  return true;
+}
+
+bool AT_Lib::removeURC(const char *prefix)
+{
+  AT_GUARD();
+  for (uint8_t i = 0; i < AT_URC_USER_MAX; i++)
+  {
+    if (_userUrcs[i].cb && strcmp(_userUrcs[i].prefix, prefix) == 0)
+    {
+      _userUrcs[i].cb = nullptr;
+      buildMatcher();
+      return true;
+    }
+  }
+  return false;
+}
+
+// Every route prefix and result code in one trie, so feedLine()
+// knows which routes a line takes by the time it ends
+bool AT_Lib::buildMatcher()
+{
+  _match.clear();
+  bool ok = _match.add("OK", TOK_OK, true) &&
+            _match.add("ERROR", TOK_ERROR, true) &&
+            _match.add("+CME ERROR:", TOK_CME_ERROR, false) &&
+            _match.add("+CMS ERROR:", TOK_CMS_ERROR, false) &&
+            _match.add("PB DONE", TOK_PB_DONE, true);
+  for (uint8_t i = 0; ok && i < URC_ROUTE_COUNT; i++)
+    ok = _match.add(URC_ROUTES[i].prefix, TOK_ROUTE + i, false);
+  for (uint8_t i = 0; ok && i < AT_URC_USER_MAX; i++)
+    if (_userUrcs[i].cb)
+      ok = _match.add(_userUrcs[i].prefix, TOK_USER + i, false);
+
+  // Catch up on a line that is half read
+  for (uint16_t i = 0; i < _lineLen; i++)
+    _match.feed(_line[i]);
+  return ok;
+}
+
+// Routes the line feedLine() just completed. Returns true if it
+// was an MQTT RX header and must not be treated as a response.
+bool AT_Lib::dispatchLine(const char *line, uint16_t len)
+{
+  if (_lineTokens < TOKEN(TOK_ROUTE))
+    return false; // result code or nothing known
+
+  bool rxBlock = false;
+  for (uint8_t i = 0; i < URC_ROUTE_COUNT; i++)
+  {
+    const UrcRoute &route = URC_ROUTES[i];
+    if (_lineTokens & TOKEN(TOK_ROUTE + i))
+    {
+      urc_handler_t handler = route.handler;
+      (this->*handler)(line, len);
+      rxBlock = (handler == &AT_Lib::handleMqttRx);
+      break;
+    }
+  }
+
+  for (uint8_t i = 0; i < AT_URC_USER_MAX; i++)
+  {
+    if (_userUrcs[i].cb && (_lineTokens & TOKEN(TOK_USER + i)))
+    {
+#if AT_RTOS
+      // The callback task matches the routes again
+      if (_readerTask)
+      {
+        postEvent(RTOS_EV_URC, 0, nullptr, nullptr, line, len);
+        break;
+      }
+#endif
+      _userUrcs[i].cb(line);
+    }
+  }
+
+  return rxBlock;
+}
+
+// =====================================================
+// MQTT RX URC HANDLER
+// =====================================================
+// Headers announce exact byte counts; the topic and payload
+// that follow are read raw by feedMqttData(), so newlines,
+// whitespace and binary data survive unchanged.
+//   +CMQTTRXSTART: <id>,<topic_total_len>,<payload_total_len>
+//   +CMQTTRXTOPIC: <id>,<sub_topic_len>     + raw topic
+//   +CMQTTRXPAYLOAD: <id>,<sub_payload_len> + raw payload
+//   +CMQTTRXEND: <id>
+static uint32_t rxHeaderLen(const char *line, uint16_t len, uint8_t field)
+{
+  AT_Fields f;
+  f.parse(AT_Slice(line, len));
+  return (uint32_t)f.toInt(field);
+}
+
+void AT_Lib::handleMqttRx(const char *line, uint16_t len)
+{
+  AT_LOGD("%s", line);
+
+  MqttClient *c = mqttClient(rxHeaderLen(line, len, 0));
+  if (!c)
+  {
+    // Still swallow the raw bytes so they are not read as lines
+    if (strncmp(line, "+CMQTTRXTOPIC:", 14) == 0 || strncmp(line, "+CMQTTRXPAYLOAD:", 16) == 0)
+      _mqttRawSkip = rxHeaderLen(line, len, 1);
+    return;
+  }
+
+  // ================================
+  // START OF MQTT RX
+  // ================================
+  if (strncmp(line, "+CMQTTRXSTART:", 14) == 0)
+  {
+    // The tail slot is free unless poll() is behind by a whole
+    // queue; the new message is dropped then, so the one being
+    // delivered is never overwritten
+    c->rxDiscard = c->rxCount == AT_MQTT_RX_QUEUE && !c->chunkCallback;
+    if (c->rxDiscard)
+    {
+      _stats.mqttRxDropped++;
+      AT_LOGW("[MQTT] RX queue full, message dropped");
+    }
+    c->rxState = RX_HEADER;
+    c->received = 0;
+    c->expectedLen = 0;
+    c->rxTotal = rxHeaderLen(line, len, 2);
+    c->rxTopicLen = 0;
+    c->rxChunkLen = 0;
+    c->rxOverflow = false;
+    if (!c->rxDiscard)
+    {
+      c->rxIn().topic[0] = 0;
+      c->rxIn().payload[0] = 0;
+    }
+    return;
+  }
+
+  // ================================
+  // TOPIC HEADER
+  // ================================
+  if (strncmp(line, "+CMQTTRXTOPIC:", 14) == 0)
+  {
+    c->expectedLen = rxHeaderLen(line, len, 1);
+    c->rxState = c->expectedLen ? RX_TOPIC : RX_HEADER;
+    _mqttRaw = c->expectedLen ? c : nullptr;
+    return;
+  }
+
+  // ================================
+  // PAYLOAD HEADER
+  // ================================
+  if (strncmp(line, "+CMQTTRXPAYLOAD:", 16) == 0)
+  {
+    c->expectedLen = rxHeaderLen(line, len, 1);
+    c->rxState = c->expectedLen ? RX_PAYLOAD : RX_HEADER;
+    _mqttRaw = c->expectedLen ? c : nullptr;
+    return;
+  }
+
+  // ================================
+  // END OF MQTT RX
+  // Buffered delivery is deferred to poll() so a callback never
+  // runs in the middle of another command's response.
+  // ================================
+  if (strncmp(line, "+CMQTTRXEND:", 12) == 0)
+  {
+    c->rxState = RX_IDLE;
+    if (c->rxDiscard)
+      return;
+
+    if (c->rxOverflow)
+    {
+      _stats.mqttRxOverflow++;
+      c->rxChunkLen = 0;
+      if (!c->chunkCallback && c->received > MQTT_PAYLOAD_MAX)
+        AT_LOGW("[MQTT] Payload of %lu bytes exceeds buffer, dropped", (unsigned long)c->received);
+      return;
+    }
+
+    if (c->chunkCallback)
+    {
+      flushMqttChunk(*c);
+      if (c->rxTotal == 0)
+        c->chunkCallback(c->rxIn().topic, (const uint8_t *)c->rxIn().payload, 0, 0, 0);
+      return;
+    }
+    c->rxIn().len = c->received;
+    c->rxCount++;
+#if AT_RTOS
+    // Queued right away, so a blocking command in another task
+    // cannot hold the message until the RX queue fills up
+    if (_readerTask)
+      deliverMqtt();
+#endif
+  }
+}
+
+// Consumes one byte of announced topic/payload data.
+// Returns false when no raw data is expected.
+bool AT_Lib::feedMqttData(char ch)
+{
+  if (_mqttRawSkip)
+  {
+    _mqttRawSkip--;
+    return true;
+  }
+
+  MqttClient *c = _mqttRaw;
+  if (!c)
+    return false;
+
+  RxMessage &m = c->rxIn();
+  if (c->rxDiscard)
+  {
+    // Read past, nowhere to keep it
+  }
+  else if (c->rxState == RX_TOPIC)
+  {
+    if (c->rxTopicLen < MQTT_TOPIC_MAX - 1)
+    {
+      m.topic[c->rxTopicLen++] = ch;
+      m.topic[c->rxTopicLen] = '\0';
+    }
+    else if (!c->rxOverflow)
+    {
+      // A cut topic could match the wrong filter
+      c->rxOverflow = true;
+      AT_LOGW("[MQTT] Topic longer than %u bytes, message dropped", MQTT_TOPIC_MAX - 1);
+    }
+  }
+  else if (c->chunkCallback)
+  {
+    m.payload[c->rxChunkLen++] = ch;
+    c->received++;
+    if (c->rxChunkLen == MQTT_PAYLOAD_MAX)
+      flushMqttChunk(*c);
+  }
+  else
+  {
+    if (c->received < MQTT_PAYLOAD_MAX)
+    {
+      m.payload[c->received] = ch;
+      m.payload[c->received + 1] = '\0';
+    }
+    else
+    {
+      c->rxOverflow = true;
+    }
+    c->received++;
+  }
+
+  if (--c->expectedLen == 0)
+  {
+    // Stream each sub-payload as soon as it is complete
+    if (c->rxState == RX_PAYLOAD && c->chunkCallback)
+      flushMqttChunk(*c);
+    c->rxState = RX_HEADER;
+    _mqttRaw = nullptr;
+  }
+  return true;
+}
+
+// Streaming mode: hands the staged bytes to the chunk callback.
+// Runs inside the reader, so the callback must not send AT commands.
+void AT_Lib::flushMqttChunk(MqttClient &c)
+{
+  if (!c.rxChunkLen || c.rxOverflow)
+  {
+    c.rxChunkLen = 0;
+    return;
+  }
+
+  uint32_t offset = c.received - c.rxChunkLen;
+  c.chunkCallback(c.rxIn().topic, (const uint8_t *)c.rxIn().payload, c.rxChunkLen, offset, c.rxTotal);
+  c.rxChunkLen = 0;
+}
+
+// Hands the queued messages over in arrival order. Each stays in
+// its slot until its callback returns, so a message read meanwhile
+// (a blocking command inside the callback) cannot overwrite it.
+void AT_Lib::deliverMqtt()
+{
+  if (_mqttDelivering)
+    return;
+  _mqttDelivering = true;
+
+  for (uint8_t i = 0; i < AT_MQTT_CLIENTS; i++)
+  {
+    MqttClient &c = _mqtt[i];
+    while (c.rxCount)
+    {
+      RxMessage &m = c.rxQueue[c.rxHead];
+      const char *payload = m.payload;
+      uint16_t len = m.len;
+      if (m.topic[0] && len && decodePayload(m.topic, payload, len))
+      {
+#if AT_RTOS
+        // Handed to the callback task; kept for a retry while its
+        // queue is full, which also stalls the reader (backpressure)
+        if (_readerTask)
+        {
+          if (!postEvent(RTOS_EV_MQTT, i, m.topic, nullptr, payload, len))
+            break;
+        }
+        else
+#endif
+        if (!c.topics.dispatch(m.topic, payload, len) && c.callback)
+          c.callback(m.topic, payload, len);
+      }
+      else
+      {
+        AT_LOGW("[MQTT] Payload not valid for its topic's codec, ignored");
+        _stats.mqttRxInvalid++;
+      }
+      c.rxHead = (c.rxHead + 1) % AT_MQTT_RX_QUEUE;
+      c.rxCount--;
+    }
+  }
+  _mqttDelivering = false;
+}
+
+// =====================================================
+// MQTT CLIENT CONTEXTS
+// One per modem client index; RX state, subscriptions,
+// callbacks and connection state never mix between them
+// =====================================================
+AT_Lib::MqttClient *AT_Lib::mqttClient(uint8_t clientId)
+{
+  if (clientId >= AT_MQTT_CLIENTS)
+  {
+    AT_LOGW("[MQTT] Invalid client index %u", clientId);
+    return nullptr;
+  }
+  return &_mqtt[clientId];
+}
+
+void AT_Lib::onMQTTReceived(mqtt_rx_callback_t cb)
+{
+  AT_GUARD();
+  for (uint8_t i = 0; i < AT_MQTT_CLIENTS; i++)
+    _mqtt[i].callback = cb;
+}
+
+void AT_Lib::onMQTTReceived(uint8_t clientId, mqtt_rx_callback_t cb)
+{
+  AT_GUARD();
+  if (MqttClient *c = mqttClient(clientId))
+    c->callback = cb;
+}
+
+void AT_Lib::onMQTTChunk(mqtt_chunk_callback_t cb)
+{
+  AT_GUARD();
+  for (uint8_t i = 0; i < AT_MQTT_CLIENTS; i++)
+    _mqtt[i].chunkCallback = cb;
+}
+
+void AT_Lib::onMQTTChunk(uint8_t clientId, mqtt_chunk_callback_t cb)
+{
+  AT_GUARD();
+  if (MqttClient *c = mqttClient(clientId))
+    c->chunkCallback = cb;
+}
+
+const AT_TopicTable &AT_Lib::mqttSubscriptions(uint8_t clientId) const
+{
+  return _mqtt[clientId < AT_MQTT_CLIENTS ? clientId : 0].topics;
+}
+
+SIM76xx_mqtt_state_t AT_Lib::mqttState(uint8_t clientId) const
+{
+  return clientId < AT_MQTT_CLIENTS ? _mqtt[clientId].state : MQTT_STATE_IDLE;
 }
 
 // =====================================================
-// Non-blocking MQTT Poll
+// SMS URC HANDLER
+// +CMTI: "SM",<index> → queued, read later from poll()
 // =====================================================
-static bool isLikelyJson(const char *buf, uint16_t len)
+void AT_Lib::handleCmti(const char *line, uint16_t len)
 {
-  if (len < 2)
-    return false;
+  AT_Fields f;
+  if (!f.parse(AT_Slice(line, len), "+CMTI:") || !f[1].isInt())
+    return;
+
+  uint8_t index = f.toInt(1);
 
-  // Trim leading whitespace
-  while (len && (*buf == ' ' || *buf == '\n' || *buf == '\r' || *buf == '\t'))
+  AT_LOGD("[SMS] index no: %u", index);
+
+  if (_smsPendingCount >= AT_SMS_PENDING_MAX)
   {
-    buf++;
-    len--;
+    _stats.smsDropped++;
+    AT_LOGW("[SMS] Pending queue full, index dropped");
+    return;
   }
 
-  return (buf[0] == '{' && buf[len - 1] == '}') ||
-         (buf[0] == '[' && buf[len - 1] == ']');
+  _smsPending[(_smsPendingHead + _smsPendingCount) % AT_SMS_PENDING_MAX] = index;
+  _smsPendingCount++;
 }
 
-void AT_Lib::mqttPoll()
+void AT_Lib::deliverSMS()
 {
-  while (_modemSerial.available())
-  {
-    String line = _modemSerial.readStringUntil('\n');
-    line.trim();
-    _debugSerial.println(line);
+  // One AT+CMGR in flight at a time; the completion queues
+  // the delete and frees the slot for the next index.
+  if (!_smsPendingCount || _smsReadIndex >= 0)
+    return;
 
-    // ================================
-    // START OF MQTT RX
-    // ================================
-    if (line.startsWith("+CMQTTRXSTART"))
-    {
-      rxState = RX_IDLE;
-      received = 0;
-      rxTopic[0] = 0;
-      rxPayload[0] = 0;
-      continue;
-    }
+  if (!commandAsync(AT_Cmd::SMS_READ, onSmsRead, this, 0, _smsPending[_smsPendingHead]))
+    return;
 
-    // ================================
-    // TOPIC HEADER
-    // ================================
-    if (line.startsWith("+CMQTTRXTOPIC:"))
-    {
-      rxState = RX_TOPIC;
-      continue;
-    }
+  _smsReadIndex = _smsPending[_smsPendingHead];
+  _smsPendingHead = (_smsPendingHead + 1) % AT_SMS_PENDING_MAX;
+  _smsPendingCount--;
+}
 
-    // ================================
-    // PAYLOAD HEADER
-    // ================================
-    if (line.startsWith("+CMQTTRXPAYLOAD:"))
-    {
-      rxState = RX_PAYLOAD;
-      received = 0;
-      rxPayload[0] = 0;
-      continue;
-    }
+void AT_Lib::onSmsRead(const AT_Completion &done, void *user)
+{
+  ((AT_Lib *)user)->smsRead(done);
+}
 
-    // ================================
-    // END OF MQTT RX
-    // ================================
-    if (line.startsWith("+CMQTTRXEND"))
-    {
-      if (_mqttCallback &&
-          rxTopic[0] &&
-          rxPayload[0] &&
-          isLikelyJson(rxPayload, received))
-      {
-        _mqttCallback(rxTopic, rxPayload, received);
-      }
-      else
-      {
-        _debugSerial.println("[MQTT] Invalid or empty payload ignored");
-      }
+void AT_Lib::smsRead(const AT_Completion &done)
+{
+  uint8_t index = _smsReadIndex;
+  _smsReadIndex = -1;
 
-      rxState = RX_IDLE;
-      received = 0;
-      continue;
-    }
+  // Read again first, ahead of any newer index
+  if (!done.ok && _smsReadTries < AT_SMS_READ_RETRIES && _smsPendingCount < AT_SMS_PENDING_MAX)
+  {
+    _smsReadTries++;
+    _smsPendingHead = (_smsPendingHead + AT_SMS_PENDING_MAX - 1) % AT_SMS_PENDING_MAX;
+    _smsPending[_smsPendingHead] = index;
+    _smsPendingCount++;
+    return;
+  }
+  _smsReadTries = 0;
 
-    // ================================
-    // DATA LINES
-    // ================================
-    if (rxState == RX_TOPIC)
-    {
-      line.toCharArray(rxTopic, sizeof(rxTopic));
-    }
-    else if (rxState == RX_PAYLOAD)
-    {
-      uint16_t len = line.length();
+  char sender[AT_SMS_SENDER_MAX];
+  char time[AT_SMS_TIME_MAX];
+  char msg[AT_SMS_BODY_MAX];
+  if (!done.ok ||
+      !parseSMS(done.response, sender, sizeof(sender), time, sizeof(time), msg, sizeof(msg)))
+  {
+    // Not deleted: the message stays on the SIM for readSMS()
+    _stats.smsDropped++;
+    AT_LOGW("[SMS] Index %u %s, left on the SIM", index, done.ok ? "not parsed" : "not read");
+    return;
+  }
 
-      if ((received + len) < (MQTT_PAYLOAD_MAX - 1))
-      {
-        memcpy(rxPayload + received, line.c_str(), len);
-        received += len;
-        rxPayload[received] = '\0';
-      }
-      else
-      {
-        _debugSerial.println("[MQTT] Payload overflow, truncated");
-      }
-    }
+  commandAsync(AT_Cmd::SMS_DELETE, nullptr, nullptr, 3000, index, 0);
+
+#if AT_RTOS
+  if (_readerTask)
+  {
+    postEvent(RTOS_EV_SMS, 0, sender, time, msg, strlen(msg));
+    return;
+  }
+#endif
+  if (_smsCallback)
+  {
+    _smsCallback(sender, time, msg);
   }
 }
 
 // =====================================================
-// Non-blocking SMS Poll (process one line per call)
+// CONNECTION / NETWORK URC HANDLERS
 // =====================================================
-void AT_Lib::smsPoll()
+void AT_Lib::handleConnLost(const char *line, uint16_t len)
 {
-    static String rx;
-
-    while (_modemSerial.available())
-    {
-        char c = _modemSerial.read();
-
-        // Ignore CR/LF
-        if (c == '\r' || c == '\n')
-            continue;
+  // +CMQTTCONNLOST: <client_index>,<cause>
+  AT_LOGD("%s", line);
 
-        rx += c;
+  AT_Fields f;
+  f.parse(AT_Slice(line, len));
 
-        // Prevent buffer overflow / heap abuse
-        if (rx.length() > 128)
-            rx.remove(0, rx.length() - 128);
+  // The client stays acquired after the broker link drops
+  if (f[0].isInt())
+    mqttLinkDown(f.toInt(0), MQTT_STATE_ACQUIRED, "connection lost");
+}
 
-        // Look for +CMTI indication
-        int p = rx.indexOf("+CMTI:");
-        if (p < 0)
-            continue;
+void AT_Lib::handleNoNet(const char *line, uint16_t len)
+{
+  // The modem stops the MQTT service along with the network
+  for (uint8_t i = 0; i < AT_MQTT_CLIENTS; i++)
+    mqttLinkDown(i, MQTT_STATE_IDLE, "no network");
+}
 
-        // Find comma separating storage and index
-        int comma = rx.indexOf(',', p);
-        if (comma < 0)
-            continue;
+void AT_Lib::handleCtzv(const char *line, uint16_t len)
+{
+  // +CTZV: <tz> in quarters of an hour, e.g. "+CTZV: +12"
+  AT_Fields f;
+  if (f.parse(AT_Slice(line, len), "+CTZV:") && f[0].isInt())
+    _networkTimezone = f.toInt(0);
+}
 
-        // Parse index digits
-        int i = comma + 1;
-        while (i < rx.length() && isDigit(rx[i]))
-            i++;
+void AT_Lib::handleCreg(const char *line, uint16_t len)
+{
+  // URC:      +CREG: <stat>[,<lac>,<ci>]
+  // Response: +CREG: <n>,<stat>[,<lac>,<ci>]
+  // Only the response form has an unquoted second field.
+  AT_Fields f;
+  f.parse(AT_Slice(line, len), "+CREG:");
+  uint8_t stat = f[1].isInt() ? 1 : 0;
+  if (f[stat].isInt())
+    _networkRegistration = f.toInt(stat);
+}
 
-        // Index not fully received yet
-        if (i == comma + 1)
-            continue;
+// =====================================================
+// Unified poll() → one reader for MQTT + SMS + URCs
+// =====================================================
+void AT_Lib::drainModem()
+{
+  for (pumpModem(); _rx.available(); pumpModem())
+  {
+    int b;
+    while ((b = _rx.pop()) >= 0)
+    {
+      if (feedMqttData((char)b))
+        continue;
 
-        uint8_t index = rx.substring(comma + 1, i).toInt();
+      if (feedLine((char)b))
+      {
+        dispatchLine(_line, strlen(_line));
 
-        _debugSerial.print("[SMS] index no: ");
-        _debugSerial.println(index);
+        // A client's RX queue full: leave the rest in _rx until
+        // deliverMqtt() has handed its messages over
+        for (uint8_t i = 0; i < AT_MQTT_CLIENTS; i++)
+          if (_mqtt[i].rxCount == AT_MQTT_RX_QUEUE)
+            return;
+      }
+    }
+  }
+}
 
-        String sender, time, msg;
-        if (readSMS(index, sender, time, msg))
-        {
-            if (_smsCallback)
-            {
-                _smsCallback(
-                    sender.c_str(),
-                    time.c_str(),
-                    msg.c_str()
-                );
-            }
-
-            deleteSMS(index);
-        }
+void AT_Lib::poll()
+{
+#if AT_RTOS
+  if (_readerTask)
+    return;
+#endif
+  AT_GUARD();
+  pollStep();
+}
 
-        // Remove processed portion from buffer
-        rx.remove(0, i);
-    }
+void AT_Lib::pollStep()
+{
+  // An active transaction owns the response buffer and routes
+  // URCs itself; otherwise drain straight into the dispatcher.
+  asyncStep();
+  if (asyncIdle())
+    drainModem();
+  deliverMqtt();
+  deliverSMS();
+  superviseStep();
+  publishStep();
+  telemetryStep();
+  outboxStep();
 }
 
+// Kept for existing sketches; both share the single dispatcher
+void AT_Lib::mqttPoll()
+{
+  poll();
+}
 
-// =====================================================
-// Unified poll() → MQTT + SMS
-// =====================================================
-void AT_Lib::poll()
+void AT_Lib::smsPoll()
 {
-  mqttPoll();
-  smsPoll();
+  poll();
 }
 
 bool AT_Lib::syncTimeOnTimezone(uint32_t timeout)
 {
-  _debugSerial.println("[TIME] Checking timezone auto-update status...");
+  AT_GUARD();
+  AT_LOGI("[TIME] Checking timezone auto-update status...");
 
-  String tzr = sendCommand("AT+CTZR?", 1000);
+  command(AT_Cmd::TZ_REPORT_QUERY, 0);
   bool ctzuEnabled = false;
 
   // Expected: +CTZR: 1
-  if (tzr.indexOf("+CTZR:") >= 0)
+  AT_Fields tzr;
+  if (tzr.parse(response().findLine(AT_Cmd::TZ_REPORT_QUERY.response), AT_Cmd::TZ_REPORT_QUERY.response))
   {
-    int idx = tzr.indexOf(":");
-    if (idx > 0)
-    {
-      int val = tzr.substring(idx + 1).toInt();
-      ctzuEnabled = (val == 1);
-    }
+    ctzuEnabled = (tzr.toInt(0) == 1);
   }
 
   if (!ctzuEnabled)
   {
-    _debugSerial.println("[TIME] CTZU disabled. Enabling and rebooting...");
+    AT_LOGI("[TIME] CTZU disabled. Enabling and rebooting...");
 
-    sendCommand("AT+CTZU=1", 1000);
-    sendCommand("AT&W", 1000);
+    command(AT_Cmd::TZ_UPDATE, 0, 1);
+    command(AT_Cmd::SAVE_PROFILE, 0);
 
     if (!rebootModem(timeout))
     {
-      _debugSerial.println("[TIME][ERROR] Modem reboot failed.");
+      AT_LOGE("[TIME][ERROR] Modem reboot failed.");
       return false;
     }
   }
   else
   {
-    _debugSerial.println("[TIME] CTZU already enabled.");
+    AT_LOGI("[TIME] CTZU already enabled.");
   }
 
-  _debugSerial.println("[TIME] Reading network time...");
-  String resp = sendCommand("AT+CCLK?", timeout);
-
-  int q1 = resp.indexOf('"');
-  int q2 = resp.lastIndexOf('"');
+  AT_LOGI("[TIME] Reading network time...");
+  command(AT_Cmd::CLOCK_QUERY, timeout);
+  return applyNetworkTime(response());
+}
 
-  if (q1 < 0 || q2 <= q1)
+// =====================================================
+// APPLY NETWORK TIME
+// Parses a +CCLK response and sets the system clock
+// =====================================================
+bool AT_Lib::applyNetworkTime(AT_Slice response)
+{
+  AT_Fields f;
+  f.parse(response.findLine(AT_Cmd::CLOCK_QUERY.response), AT_Cmd::CLOCK_QUERY.response);
+  if (f[0].type != AT_FIELD_STRING)
   {
-    _debugSerial.println("[TIME][ERROR] Invalid CCLK response.");
+    AT_LOGE("[TIME][ERROR] Invalid CCLK response.");
     return false;
   }
 
-  String t = resp.substring(q1 + 1, q2);
+  AT_Slice t = f.text(0);
 
   // Expected: yy/MM/dd,hh:mm:ss±zz
-  if (t.length() < 17)
+  if (t.len < 17)
   {
-    _debugSerial.println("[TIME][ERROR] Time string malformed.");
+    AT_LOGE("[TIME][ERROR] Time string malformed.");
     return false;
   }
 
   struct tm tm{};
-  tm.tm_year = t.substring(0, 2).toInt() + 100;
-  tm.tm_mon = t.substring(3, 5).toInt() - 1;
-  tm.tm_mday = t.substring(6, 8).toInt();
-  tm.tm_hour = t.substring(9, 11).toInt();
-  tm.tm_min = t.substring(12, 14).toInt();
-  tm.tm_sec = t.substring(15, 17).toInt();
+  tm.tm_year = t.sub(0, 2).toInt() + 100;
+  tm.tm_mon = t.sub(3, 5).toInt() - 1;
+  tm.tm_mday = t.sub(6, 8).toInt();
+  tm.tm_hour = t.sub(9, 11).toInt();
+  tm.tm_min = t.sub(12, 14).toInt();
+  tm.tm_sec = t.sub(15, 17).toInt();
 
   time_t epoch = mktime(&tm);
 
   // Sanity check (Nov 2023+)
   if (epoch < 1700000000)
   {
-    _debugSerial.println("[TIME][ERROR] Network time not valid.");
+    AT_LOGE("[TIME][ERROR] Network time not valid.");
     return false;
   }
 
@@ -365,19 +1290,26 @@ bool AT_Lib::syncTimeOnTimezone(uint32_t timeout)
 
   settimeofday(&now, nullptr);
 
-  _debugSerial.print("[TIME] Synced successfully. Epoch=");
-  _debugSerial.println(epoch);
+  AT_LOGI("[TIME] Synced successfully. Epoch=%lu", (unsigned long)epoch);
 
   return true;
 }
 
 bool AT_Lib::rebootModem(uint32_t timeout)
 {
-  _debugSerial.println("[MODEM] Rebooting modem...");
-  sendCommand("AT+CFUN=1,1", 1000);
+  AT_LOGI("[MODEM] Rebooting modem...");
+  command(AT_Cmd::REBOOT, 0, 1, 1);
 
   delay(2000); // modem resets UART
 
+  // The modem comes back at its boot rate without flow control
+  if (_baud != _baseBaud || _fastBaud || (_rtsPin >= 0 && _ctsPin >= 0))
+  {
+    setUartFlowControl(-1, -1);
+    switchBaud(_baseBaud);
+    _linkPending = true;
+  }
+
   return waitForPBDONE(timeout) && modemReady(timeout);
 }
 
@@ -387,15 +1319,21 @@ bool AT_Lib::rebootModem(uint32_t timeout)
 // =====================================================
 String AT_Lib::listCertificates(uint32_t timeout)
 {
-  _debugSerial.println("Fetching list of certificates...");
-  String response = sendCommand("AT+CCERTLIST", timeout);
+  AT_GUARD();
+  AT_LOGI("Fetching list of certificates...");
+  command(AT_Cmd::CERT_LIST, timeout);
 
   // Optional: you can parse the response here if needed
   // Example: split lines, extract names, etc.
 
-  _debugSerial.println("[CERT LIST]");
-  _debugSerial.println(response);
-  return response;
+  AT_LOGI("[CERT LIST]");
+  AT_Slice line;
+  uint16_t pos = 0;
+  while (response().nextLine(pos, line))
+  {
+    AT_LOGI("%.*s", line.len, line.ptr);
+  }
+  return String(_resp);
 }
 
 // =====================================================
@@ -404,66 +1342,36 @@ String AT_Lib::listCertificates(uint32_t timeout)
 // =====================================================
 bool AT_Lib::uploadCertificate(const char *filename, const uint8_t *data, uint32_t length, uint32_t timeout)
 {
-  _debugSerial.printf("Uploading certificate: %s (%u bytes)\n", filename, length);
+  AT_GUARD();
+  AT_LOGI("Uploading certificate: %s (%lu bytes)", filename, (unsigned long)length);
 
   // Send AT+CCERTDOWN command with filename and length
-  String cmd;
-  cmd = "AT+CCERTDOWN=\"" + String(filename) + "\"," + String(length);
-  _modemSerial.println(cmd);
-
   // Wait for '>' prompt from modem
-  uint32_t start = millis();
-  bool ready = false;
-  while (millis() - start < timeout)
-  {
-    if (_modemSerial.available())
-    {
-      String resp = _modemSerial.readStringUntil('\n');
-      _debugSerial.println(resp);
-      if (resp.indexOf('>') >= 0)
-      {
-        ready = true;
-        break;
-      }
-    }
-  }
-
-  if (!ready)
+  if (!writeCommand(AT_Cmd::CERT_DOWNLOAD, filename, (unsigned long)length) || !waitPrompt(timeout))
   {
-    _debugSerial.println("[ERROR] Modem not ready for certificate upload!");
+    AT_LOGE("[ERROR] Modem not ready for certificate upload!");
     return false;
   }
 
   // Send raw certificate bytes
-  for (uint32_t i = 0; i < length; i++)
-  {
-    _modemSerial.write(data[i]);
-  }
+  modemWrite(data, length);
 
-  _debugSerial.println("\n[INFO] Certificate bytes sent, waiting for OK...");
+  AT_LOGI("[INFO] Certificate bytes sent, waiting for OK...");
 
   // Wait for final OK or error
-  start = millis();
-  while (millis() - start < timeout)
+  AT_result_t result = awaitResult(timeout);
+  if (result == AT_RESULT_OK)
   {
-    if (_modemSerial.available())
-    {
-      String resp = _modemSerial.readStringUntil('\n');
-      _debugSerial.println(resp);
-      if (resp.indexOf("OK") >= 0)
-      {
-        _debugSerial.println("[SUCCESS] Certificate uploaded!");
-        return true;
-      }
-      if (resp.indexOf("ERROR") >= 0)
-      {
-        _debugSerial.println("[ERROR] Certificate upload failed!");
-        return false;
-      }
-    }
+    AT_LOGI("[SUCCESS] Certificate uploaded!");
+    return true;
+  }
+  if (result != AT_RESULT_TIMEOUT)
+  {
+    AT_LOGE("[ERROR] Certificate upload failed!");
+    return false;
   }
 
-  _debugSerial.println("[ERROR] Timeout waiting for modem response after upload!");
+  AT_LOGE("[ERROR] Timeout waiting for modem response after upload!");
   return false;
 }
 
@@ -473,13 +1381,15 @@ bool AT_Lib::uploadCertificate(const char *filename, const uint8_t *data, uint32
 // =====================================================
 bool AT_Lib::uploadCertificateIfMissing(const char *filename, const uint8_t *data, uint32_t length, uint32_t timeout)
 {
+  AT_GUARD();
   // Step 1: List existing certificates
-  String certs = listCertificates(timeout);
+  AT_LOGI("Fetching list of certificates...");
+  command(AT_Cmd::CERT_LIST, timeout);
 
   // Step 2: Check if the certificate is already present
-  if (certs.indexOf(filename) >= 0)
+  if (response().indexOf(filename) >= 0)
   {
-    _debugSerial.printf("[INFO] Certificate '%s' already exists, skipping upload.\n", filename);
+    AT_LOGI("[INFO] Certificate '%s' already exists, skipping upload.", filename);
     return true; // Already present, consider success
   }
 
@@ -493,81 +1403,70 @@ bool AT_Lib::uploadCertificateIfMissing(const char *filename, const uint8_t *dat
 // =====================================================
 bool AT_Lib::deleteCertificate(const char *filename)
 {
-  String cmd = "AT+CCERTDELE=\"";
-  cmd += filename;
-  cmd += "\"";
-
-  String res = sendCommand(cmd.c_str(), 3000);
-
-  if (res.indexOf("OK") >= 0)
+  AT_GUARD();
+  if (command(AT_Cmd::CERT_DELETE, 0, filename) == AT_RESULT_OK)
   {
-    _debugSerial.println("[DELETE OK] Certificate deleted.");
+    AT_LOGI("[DELETE OK] Certificate deleted.");
     return true;
   }
 
-  _debugSerial.println("[DELETE FAIL] Certificate NOT deleted.");
+  AT_LOGW("[DELETE FAIL] Certificate NOT deleted.");
   return false;
 }
 
 // =====================================================
 // PARSE MQTT RESULTS
 // =====================================================
-bool AT_Lib::parseMqttResult(const String &response, const char *prefix, SIM76xx_mqtt_err_t *errOut)
+bool AT_Lib::parseMqttResult(AT_Slice response, const AT_CmdDef &cmd, SIM76xx_mqtt_err_t *errOut)
 {
-  String tag = String("+") + prefix + ":";
-
-  int idx = response.indexOf(tag);
-  if (idx < 0)
+  const char *prefix = cmd.text + 3; // "CMQTTxxx" for the log
+  AT_Slice line = response.findLine(cmd.response);
+  if (line.empty())
   {
-    _debugSerial.printf("[MQTT] %s not found\n", prefix);
+    AT_LOGW("[MQTT] %s not found", prefix);
     return false;
   }
 
-  int lineEnd = response.indexOf('\n', idx);
-  String line = (lineEnd > 0) ? response.substring(idx, lineEnd) : response.substring(idx);
-
-  int comma = line.indexOf(',');
-  if (comma < 0)
+  // +CMQTTxxx: <client_index>,<err>
+  AT_Fields f;
+  f.parse(line, cmd.response);
+  if (!f[1].isInt())
   {
-    _debugSerial.printf("[MQTT] %s malformed\n", prefix);
+    AT_LOGW("[MQTT] %s malformed", prefix);
     return false;
   }
 
-  int err = line.substring(comma + 1).toInt();
+  int err = f.toInt(1);
   SIM76xx_mqtt_err_t mqttErr = (SIM76xx_mqtt_err_t)err;
 
   if (errOut)
   {
     *errOut = mqttErr;
   }
+  statMqttResult(err);
+  noteMqttResult(cmd.response, f.toInt(0), err);
 
-  _debugSerial.printf("[MQTT %s] %d → %s\n",
-                      prefix,
-                      err,
-                      SIM76xx_mqtt_err_str(mqttErr));
+  if (mqttErr == SIM76xx_MQTT_OK)
+    AT_LOGD("[MQTT %s] %d → %s", prefix, err, SIM76xx_mqtt_err_str(mqttErr));
+  else
+    AT_LOGW("[MQTT %s] %d → %s", prefix, err, SIM76xx_mqtt_err_str(mqttErr));
 
   return (mqttErr == SIM76xx_MQTT_OK);
 }
 
 // =====================================================
 // WAIT FOR PROMPT FROM MODEM
-// use this to tell next commant to wait for a specified
-// promt before timeout.
+// use this to tell next commant to wait for the '>'
+// data prompt. Fails early if the modem answers ERROR.
 // =====================================================
-bool AT_Lib::waitPrompt(char prompt, uint32_t timeout)
+bool AT_Lib::waitPrompt(uint32_t timeout)
 {
-  uint32_t start = millis();
-  while (millis() - start < timeout)
-  {
-    if (_modemSerial.available())
-    {
-      char c = _modemSerial.read();
-      _debugSerial.write(c);
-      if (c == prompt)
-        return true;
-    }
-  }
-  return false;
+  AT_result_t result = awaitResult(timeout);
+  if (result == AT_RESULT_TIMEOUT)
+    _stats.promptTimeouts++;
+  else if (result != AT_RESULT_PROMPT)
+    _stats.promptMissing++;
+  return result == AT_RESULT_PROMPT;
 }
 
 // =====================================================
@@ -576,8 +1475,16 @@ bool AT_Lib::waitPrompt(char prompt, uint32_t timeout)
 // =====================================================
 bool AT_Lib::mqttStart(uint32_t timeout)
 {
-  String r = sendCommand("AT+CMQTTSTART", timeout);
-  return r.indexOf("OK") >= 0;
+  AT_GUARD();
+  if (command(AT_Cmd::MQTT_START, timeout) != AT_RESULT_OK)
+    return false;
+
+  for (uint8_t i = 0; i < AT_MQTT_CLIENTS; i++)
+  {
+    if (_mqtt[i].state == MQTT_STATE_IDLE)
+      _mqtt[i].state = MQTT_STATE_STARTED;
+  }
+  return true;
 }
 
 // =====================================================
@@ -586,8 +1493,16 @@ bool AT_Lib::mqttStart(uint32_t timeout)
 // =====================================================
 bool AT_Lib::mqttStop(uint32_t timeout)
 {
-  String r = sendCommand("AT+CMQTTSTOP", timeout);
-  return r.indexOf("OK") >= 0;
+  AT_GUARD();
+  if (command(AT_Cmd::MQTT_STOP, timeout) != AT_RESULT_OK)
+    return false;
+
+  for (uint8_t i = 0; i < AT_MQTT_CLIENTS; i++)
+  {
+    _mqtt[i].state = MQTT_STATE_IDLE;
+    _mqtt[i].supervised = false;
+  }
+  return true;
 }
 
 // =====================================================
@@ -597,11 +1512,16 @@ bool AT_Lib::mqttStop(uint32_t timeout)
 // =====================================================
 bool AT_Lib::mqttAcquire(uint8_t clientId, const char *clientName)
 {
-  char cmd[64];
-  snprintf(cmd, sizeof(cmd), "AT+CMQTTACCQ=%d,\"%s\"", clientId, clientName);
+  AT_GUARD();
+  MqttClient *c = mqttClient(clientId);
+  if (!c)
+    return false;
 
-  String r = sendCommand(cmd, 3000);
-  return r.indexOf("OK") >= 0;
+  if (command(AT_Cmd::MQTT_ACQUIRE, 0, clientId, clientName) != AT_RESULT_OK)
+    return false;
+
+  c->state = MQTT_STATE_ACQUIRED;
+  return true;
 }
 
 // =====================================================
@@ -611,57 +1531,158 @@ bool AT_Lib::mqttAcquire(uint8_t clientId, const char *clientName)
 // =====================================================
 bool AT_Lib::mqttConnect(uint8_t clientId, const char *uri, const char *user, const char *pass, uint16_t keepAlive, bool cleanSession, uint32_t timeout)
 {
-  // Build full connect command with username and password directly
-  char cmd[256];
-  snprintf(cmd, sizeof(cmd), "AT+CMQTTCONNECT=%d,\"%s\",%u,%d,\"%s\",\"%s\"", clientId, uri, keepAlive, cleanSession ? 1 : 0, user, pass);
+  AT_GUARD();
+  if (!mqttClient(clientId))
+    return false;
 
-  // Send command to modem
-  String r = sendCommand(cmd, timeout);
+  // Connect with username and password directly
+  command(AT_Cmd::MQTT_CONNECT, timeout, clientId, uri, keepAlive, cleanSession ? 1 : 0, user, pass);
 
-  // Parse result
-  return parseMqttResult(r, "CMQTTCONNECT");
+  // Parse result; a good one moves the client to CONNECTED
+  return parseMqttResult(response(), AT_Cmd::MQTT_CONNECT);
 }
 
 // =====================================================
 // MQTT SUBSCRIBE
 // This subscribe the mqtt client to the server
-// call this once
+// call this once per topic filter; `cb` gets the
+// messages matching it ('+' and '#' allowed)
 // =====================================================
 bool AT_Lib::mqttSubscribe(uint8_t clientId, const char *topic, uint8_t qos, mqtt_rx_callback_t cb, uint32_t timeout)
 {
+  AT_GUARD();
   if (!topic || strlen(topic) == 0)
   {
-    _debugSerial.println("[MQTT] Empty topic rejected");
+    AT_LOGW("[MQTT] Empty topic rejected");
     return false;
   }
 
-  _mqttCallback = cb;
+  AT_MqttSub sub = {topic, qos, cb};
+  return mqttSubscribeMany(clientId, &sub, 1, nullptr, timeout) == 1;
+}
 
-  // 1. Set the topic
-  char cmd[64];
-  snprintf(cmd, sizeof(cmd), "AT+CMQTTSUBTOPIC=%d,%u,%u", clientId, strlen(topic), qos);
-  _modemSerial.println(cmd);
+// =====================================================
+// MQTT SUBSCRIBE MANY
+// Stages every filter with AT+CMQTTSUBTOPIC, then one
+// AT+CMQTTSUB sends them in a single SUBSCRIBE packet,
+// so the batch costs one network round trip.
+// The modem reports one result for the whole packet;
+// `results` (optional, `count` entries) gets it for each
+// staged topic, or the local error for skipped ones.
+// Returns the number of topics subscribed.
+// =====================================================
+uint8_t AT_Lib::mqttSubscribeMany(uint8_t clientId, const AT_MqttSub *subs, uint8_t count,
+                                  SIM76xx_mqtt_err_t *results, uint32_t timeout)
+{
+  AT_GUARD();
+  // 0 = skipped, 1 = staged and new, 2 = staged, already registered
+  uint8_t staged[AT_MQTT_SUBS_MAX];
+  uint8_t stagedCount = 0;
+  // What a registered filter had before this batch, put back on failure
+  uint8_t prevQos[AT_MQTT_SUBS_MAX];
+  mqtt_rx_callback_t prevCb[AT_MQTT_SUBS_MAX];
+  bool aborted = false;
+
+  MqttClient *c = mqttClient(clientId);
+  if (!c)
+    return 0;
+  AT_TopicTable &table = c->topics;
+
+  if (count > AT_MQTT_SUBS_MAX)
+  {
+    AT_LOGW("[MQTT] Too many topics in one batch");
+    return 0;
+  }
 
-  // Wait for '>' prompt
-  if (!waitPrompt('>', timeout))
-    return false;
+  for (uint8_t i = 0; i < count; i++)
+  {
+    const AT_MqttSub &sub = subs[i];
+    SIM76xx_mqtt_err_t err = SIM76xx_MQTT_FAILED;
+    staged[i] = 0;
+
+    const AT_TopicTable::Entry *prev = sub.topic ? table.find(sub.topic) : nullptr;
+    bool known = prev != nullptr;
+    if (known)
+    {
+      prevQos[i] = prev->qos;
+      prevCb[i] = prev->cb;
+    }
+    if (aborted)
+    {
+      // Modem state unknown after a missed prompt
+    }
+    else if (!AT_TopicTable::valid(sub.topic))
+    {
+      AT_LOGW("[MQTT] Invalid topic filter rejected");
+      err = SIM76xx_MQTT_INVALID_PARAM;
+    }
+    else if (!table.add(sub.topic, sub.qos, sub.cb))
+    {
+      AT_LOGW("[MQTT] Subscription table full");
+    }
+    else
+    {
+      AT_Arg args[] = {clientId, (unsigned)strlen(sub.topic), sub.qos};
+      AT_result_t r = stageMqttTopic(AT_Cmd::MQTT_SUB_TOPIC, args, 3, sub.topic, timeout);
+      if (r == AT_RESULT_OK)
+      {
+        staged[i] = known ? 2 : 1;
+        stagedCount++;
+      }
+      else
+      {
+        AT_LOGW("[MQTT] Failed to set subscribe topic");
+        aborted = (r == AT_RESULT_TIMEOUT);
+        if (known)
+          table.add(sub.topic, prevQos[i], prevCb[i]);
+        else
+          table.remove(sub.topic);
+      }
+    }
+
+    if (results)
+      results[i] = err;
+  }
+
+  if (!stagedCount)
+    return 0;
 
-  // Send the topic string
-  _modemSerial.print(topic);
+  // One SUBSCRIBE for everything staged
+  command(AT_Cmd::MQTT_SUBSCRIBE, timeout, clientId);
 
-  // Wait for OK after topic is set
-  String res = readUntilTimeout(timeout);
-  if (res.indexOf("OK") < 0)
+  SIM76xx_mqtt_err_t err = SIM76xx_MQTT_FAILED;
+  bool ok = parseMqttResult(response(), AT_Cmd::MQTT_SUBSCRIBE, &err);
+
+  for (uint8_t i = 0; i < count; i++)
   {
-    _debugSerial.println("[MQTT] Failed to set subscribe topic");
-    return false;
+    if (!staged[i])
+      continue;
+    if (results)
+      results[i] = err;
+    if (ok)
+      continue;
+    if (staged[i] == 1)
+      table.remove(subs[i].topic);
+    else
+      table.add(subs[i].topic, prevQos[i], prevCb[i]);
   }
+  return ok ? stagedCount : 0;
+}
+
+// Sends one AT+CMQTT(UN)SUBTOPIC entry and its topic
+AT_result_t AT_Lib::stageMqttTopic(const AT_CmdDef &cmd, const AT_Arg *args, uint8_t count,
+                                   const char *topic, uint32_t timeout)
+{
+  if (!writeArgs(cmd, args, count))
+    return AT_RESULT_ERROR;
 
-  // 2. Subscribe
-  snprintf(cmd, sizeof(cmd), "AT+CMQTTSUB=%d", clientId);
-  String r2 = sendCommand(cmd, timeout);
+  // Wait for '>' prompt
+  if (!waitPrompt(timeout))
+    return AT_RESULT_TIMEOUT;
 
-  return parseMqttResult(r2, "CMQTTSUB");
+  // Send the topic string and wait for OK
+  modemPrint(topic);
+  return awaitResult(timeout);
 }
 
 // =====================================================
@@ -672,52 +1693,74 @@ bool AT_Lib::mqttSubscribe(uint8_t clientId, const char *topic, uint8_t qos, mqt
 // =====================================================
 bool AT_Lib::mqttPublish(uint8_t clientId, const char *topic, const uint8_t *payload, uint16_t length, uint8_t qos, uint32_t timeout)
 {
-  if (!topic || strlen(topic) == 0 || strlen(topic) > 128)
+  AT_GUARD();
+  AT_PublishChannel channel;
+  return prepareChannel(channel, clientId, topic, topic ? strlen(topic) : 0, qos, false, timeout) &&
+         publishNow(channel, payload, length);
+}
+
+bool AT_Lib::publishNow(AT_PublishChannel &channel, const uint8_t *payload, uint16_t length)
+{
+  if (!payload || length == 0 || length > MQTT_PAYLOAD_MAX)
   {
-    _debugSerial.println("[MQTT] Invalid topic");
+    AT_LOGW("[MQTT] Invalid payload length");
     return false;
   }
-  if (!payload || length == 0 || length > 1024)
-  {
-    _debugSerial.println("[MQTT] Invalid payload length");
+
+  if (outboxWanted(channel._client))
+    return outboxStore(channel, payload, length);
+  if (sendPublish(channel, payload, length))
+    return true;
+  // The result code may have just taken the link down
+  return outboxWanted(channel._client) && outboxStore(channel, payload, length);
+}
+
+bool AT_Lib::sendPublish(AT_PublishChannel &channel, const uint8_t *payload, uint16_t length)
+{
+  uint32_t timeout = channel._timeout ? channel._timeout : AT_Cmd::MQTT_PUBLISH.timeout;
+
+  // Its +CMQTTPUB: would otherwise be taken for a pipelined one's.
+  // The link may go meanwhile; the caller then stores it.
+  waitPublishes();
+  if (outboxWanted(channel._client))
     return false;
-  }
 
-  char cmd[64];
+  // Framed once queued work is done: its callbacks may publish
+  // through the same frame buffer
+  waitAsyncIdle();
+  payload = encodePayload(channel, payload, length);
+  if (!payload)
+    return false;
 
   // 1. Set topic
-  snprintf(cmd, sizeof(cmd), "AT+CMQTTTOPIC=%d,%u", clientId, strlen(topic));
-  _modemSerial.println(cmd);
-  if (!waitPrompt('>', timeout))
+  writeLine(channel._topicLine, AT_FAMILY_MQTT_PUBLISH);
+  if (!waitPrompt(timeout))
     return false;
-  _modemSerial.print(topic);
+  modemWrite((const uint8_t *)channel._topic, channel._topicLen);
 
-  String res = readUntilTimeout(timeout);
-  if (res.indexOf("OK") < 0)
+  if (awaitResult(timeout) != AT_RESULT_OK)
   {
-    _debugSerial.println("[MQTT] Failed to set topic");
+    AT_LOGW("[MQTT] Failed to set topic");
     return false;
   }
 
   // 2. Set payload
-  snprintf(cmd, sizeof(cmd), "AT+CMQTTPAYLOAD=%d,%u", clientId, length);
-  _modemSerial.println(cmd);
-  if (!waitPrompt('>', timeout))
+  writeLine(channel.payloadLine(length), AT_FAMILY_MQTT_PUBLISH);
+  if (!waitPrompt(timeout))
     return false;
-  _modemSerial.write(payload, length);
+  modemWrite(payload, length);
 
-  res = readUntilTimeout(timeout);
-  if (res.indexOf("OK") < 0)
+  if (awaitResult(timeout) != AT_RESULT_OK)
   {
-    _debugSerial.println("[MQTT] Failed to set payload");
+    AT_LOGW("[MQTT] Failed to set payload");
     return false;
   }
 
   // 3. Publish
-  snprintf(cmd, sizeof(cmd), "AT+CMQTTPUB=%d,%d,60", clientId, qos);
-  res = sendCommand(cmd, timeout);
+  writeLine(channel._pubLine, AT_FAMILY_MQTT_PUBLISH);
+  awaitResult(timeout, AT_Cmd::MQTT_PUBLISH.response);
 
-  return parseMqttResult(res, "CMQTTPUB");
+  return parseMqttResult(response(), AT_Cmd::MQTT_PUBLISH);
 }
 
 // =====================================================
@@ -726,17 +1769,87 @@ bool AT_Lib::mqttPublish(uint8_t clientId, const char *topic, const uint8_t *pay
 // =====================================================
 bool AT_Lib::mqttUnsubscribe(uint8_t clientId, const char *topic, uint32_t timeout)
 {
-  char cmd[64];
-  snprintf(cmd, sizeof(cmd),
-           "AT+CMQTTUNSUB=%d,%u", clientId, strlen(topic));
+  AT_GUARD();
+  return mqttUnsubscribeMany(clientId, &topic, 1, nullptr, timeout) == 1;
+}
 
-  _modemSerial.println(cmd);
-  if (!waitPrompt('>', timeout))
-    return false;
-  _modemSerial.print(topic);
+// =====================================================
+// MQTT UNSUBSCRIBE MANY
+// Same batching as mqttSubscribeMany, with
+// AT+CMQTTUNSUBTOPIC entries and one AT+CMQTTUNSUB.
+// =====================================================
+uint8_t AT_Lib::mqttUnsubscribeMany(uint8_t clientId, const char *const *topics, uint8_t count,
+                                    SIM76xx_mqtt_err_t *results, uint32_t timeout)
+{
+  AT_GUARD();
+  bool staged[AT_MQTT_SUBS_MAX];
+  uint8_t stagedCount = 0;
+  bool aborted = false;
+
+  MqttClient *c = mqttClient(clientId);
+  if (!c)
+    return 0;
+  AT_TopicTable &table = c->topics;
+
+  if (count > AT_MQTT_SUBS_MAX)
+  {
+    AT_LOGW("[MQTT] Too many topics in one batch");
+    return 0;
+  }
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    const char *topic = topics[i];
+    SIM76xx_mqtt_err_t err = SIM76xx_MQTT_FAILED;
+    staged[i] = false;
+
+    if (aborted)
+    {
+      // Modem state unknown after a missed prompt
+    }
+    else if (!AT_TopicTable::valid(topic))
+    {
+      AT_LOGW("[MQTT] Invalid topic filter rejected");
+      err = SIM76xx_MQTT_INVALID_PARAM;
+    }
+    else
+    {
+      AT_Arg args[] = {clientId, (unsigned)strlen(topic)};
+      AT_result_t r = stageMqttTopic(AT_Cmd::MQTT_UNSUB_TOPIC, args, 2, topic, timeout);
+      if (r == AT_RESULT_OK)
+      {
+        staged[i] = true;
+        stagedCount++;
+      }
+      else
+      {
+        AT_LOGW("[MQTT] Failed to set unsubscribe topic");
+        aborted = (r == AT_RESULT_TIMEOUT);
+      }
+    }
+
+    if (results)
+      results[i] = err;
+  }
+
+  if (!stagedCount)
+    return 0;
+
+  command(AT_Cmd::MQTT_UNSUBSCRIBE, timeout, clientId, 0);
+
+  SIM76xx_mqtt_err_t err = SIM76xx_MQTT_FAILED;
+  bool ok = parseMqttResult(response(), AT_Cmd::MQTT_UNSUBSCRIBE, &err);
 
-  String r = readUntilTimeout(timeout);
-  return parseMqttResult(r, "CMQTTUNSUB");
+  for (uint8_t i = 0; i < count; i++)
+  {
+    if (!staged[i])
+      continue;
+    if (results)
+      results[i] = err;
+    if (ok)
+      table.remove(topics[i]);
+  }
+  return ok ? stagedCount : 0;
 }
 
 // =====================================================
@@ -746,18 +1859,17 @@ bool AT_Lib::mqttUnsubscribe(uint8_t clientId, const char *topic, uint32_t timeo
 // =====================================================
 bool AT_Lib::mqttDisconnect(uint8_t clientId, uint32_t timeout)
 {
-  char cmd[32];
-  snprintf(cmd, sizeof(cmd),
-           "AT+CMQTTDISC=%d,60", clientId);
-
-  String r = sendCommand(cmd, timeout);
-  return parseMqttResult(r, "CMQTTDISC");
+  AT_GUARD();
+  mqttUnsupervise(clientId);
+  command(AT_Cmd::MQTT_DISCONNECT, timeout, clientId, 60);
+  return parseMqttResult(response(), AT_Cmd::MQTT_DISCONNECT);
 }
 
 bool AT_Lib::enableSMS()
 {
-  return sendCommand("AT+CMGF=1", 2000).indexOf("OK") >= 0 &&
-         sendCommand("AT+CNMI=2,1,0,0,0", 2000).indexOf("OK") >= 0;
+  AT_GUARD();
+  return command(AT_Cmd::SMS_FORMAT, 0, 1) == AT_RESULT_OK &&
+         command(AT_Cmd::SMS_NOTIFY, 0, 2, 1, 0, 0, 0) == AT_RESULT_OK;
 }
 
 // =====================================================
@@ -765,94 +1877,80 @@ bool AT_Lib::enableSMS()
 // =====================================================
 bool AT_Lib::sendSMS(const char *phoneNumber, const char *message, uint32_t timeout)
 {
+  AT_GUARD();
   if (!phoneNumber || !message || strlen(message) == 0)
   {
-    _debugSerial.println("[SMS] Invalid phone number or message");
+    AT_LOGW("[SMS] Invalid phone number or message");
     return false;
   }
 
   // 1. Set SMS text mode
-  if (sendCommand("AT+CMGF=1", 2000).indexOf("OK") < 0)
+  if (command(AT_Cmd::SMS_FORMAT, 0, 1) != AT_RESULT_OK)
   {
-    _debugSerial.println("[SMS] Failed to set text mode");
+    AT_LOGW("[SMS] Failed to set text mode");
     return false;
   }
 
-  // 2. Set destination number
-  char cmd[48];
-  snprintf(cmd, sizeof(cmd), "AT+CMGS=\"%s\"", phoneNumber);
-
-  _modemSerial.println(cmd);
-
-  // 3. Wait for '>' prompt
-  if (!waitPrompt('>', timeout))
+  // 2. Set destination number, 3. wait for '>' prompt
+  if (!writeCommand(AT_Cmd::SMS_SEND, phoneNumber) || !waitPrompt(timeout))
   {
-    _debugSerial.println("[SMS] No prompt from modem");
+    AT_LOGW("[SMS] No prompt from modem");
     return false;
   }
 
   // 4. Send message body
-  _modemSerial.print(message);
+  modemPrint(message);
 
   // 5. End messge with CTRL+Z
-  _modemSerial.write(0x1A);
+  modemWrite((const uint8_t *)"\x1A", 1);
 
   // 6. Wait for response
-  String r = readUntilTimeout(timeout);
-
-  if (r.indexOf("+CMGS:") >= 0 && r.indexOf("OK") >= 0)
+  if (awaitResult(timeout) == AT_RESULT_OK && response().indexOf(AT_Cmd::SMS_SEND.response) >= 0)
   {
-    _debugSerial.println("[SMS] Sent successfuly");
+    AT_LOGI("[SMS] Sent successfuly");
     return true;
   }
 
-  _debugSerial.println("[SMS] Send failed");
+  AT_LOGW("[SMS] Send failed");
   return false;
 }
 
-bool AT_Lib::readSMS(uint8_t index, String &outSender, String &outTime, String &outMsg)
+bool AT_Lib::readSMS(uint8_t index, char *outSender, size_t senderLen,
+                     char *outTime, size_t timeLen, char *outMsg, size_t msgLen)
 {
-  char cmd[16];
-  snprintf(cmd, sizeof(cmd), "AT+CMGR=%d", index);
+  AT_GUARD();
+  if (command(AT_Cmd::SMS_READ, 0, index) != AT_RESULT_OK)
+    return false;
 
-  String r = sendCommand(cmd, 5000);
+  return parseSMS(response(), outSender, senderLen, outTime, timeLen, outMsg, msgLen);
+}
 
-  int hdr = r.indexOf("+CMGR:");
+// =====================================================
+// PARSE +CMGR RESPONSE (TEXT MODE)
+// =====================================================
+bool AT_Lib::parseSMS(AT_Slice r, char *outSender, size_t senderLen,
+                      char *outTime, size_t timeLen, char *outMsg, size_t msgLen)
+{
+  int hdr = r.indexOf(AT_Cmd::SMS_READ.response);
   if (hdr < 0)
     return false;
 
-  // Collect quoted fields
-  String fields[4];
-  int fieldIndex = 0;
-  int pos = hdr;
-
-  while (fieldIndex < 4)
-  {
-    int start = r.indexOf('"', pos);
-    if (start < 0)
-      break;
-
-    int end = r.indexOf('"', start + 1);
-    if (end < 0)
-      break;
-
-    fields[fieldIndex++] = r.substring(start + 1, end);
-    pos = end + 1;
-  }
+  // +CMGR: <stat>,<oa>,[<alpha>],<scts>[,...]
+  // The alpha field may be "" or left out entirely
+  AT_Slice header;
+  uint16_t pos = hdr;
+  r.nextLine(pos, header);
 
-  if (fieldIndex < 4)
+  AT_Fields fields;
+  fields.parse(header, AT_Cmd::SMS_READ.response);
+  if (fields[1].type != AT_FIELD_STRING || fields[3].type != AT_FIELD_STRING)
   {
-    _debugSerial.println("[SMS] CMGR header parse failed");
+    AT_LOGW("[SMS] CMGR header parse failed");
     return false;
   }
 
-  // Assign correct fields
-  // fields[0] = REC UNREAD
-  // fields[1] = sender
-  // fields[2] = alpha
-  // fields[3] = timestamp
-  outSender = fields[1];
-  outTime = fields[3];
+  fields[1].copyTo(outSender, senderLen);
+  fields[3].copyTo(outTime, timeLen);
 
   // Message body
   int bodyStart = r.indexOf('\n', hdr);
@@ -864,21 +1962,36 @@ bool AT_Lib::readSMS(uint8_t index, String &outSender, String &outTime, String &
   if (bodyEnd < 0)
     return false;
 
-  outMsg = r.substring(bodyStart, bodyEnd);
-  outMsg.trim();
+  r.sub(bodyStart, bodyEnd).trim().copyTo(outMsg, msgLen);
+
+  return true;
+}
+
+bool AT_Lib::readSMS(uint8_t index, String &outSender, String &outTime, String &outMsg)
+{
+  AT_GUARD();
+  char sender[AT_SMS_SENDER_MAX];
+  char time[AT_SMS_TIME_MAX];
+  char msg[AT_SMS_BODY_MAX];
+
+  if (!readSMS(index, sender, sizeof(sender), time, sizeof(time), msg, sizeof(msg)))
+    return false;
 
+  outSender = sender;
+  outTime = time;
+  outMsg = msg;
   return true;
 }
 
 bool AT_Lib::deleteSMS(uint8_t index)
 {
-  char cmd[16];
-  snprintf(cmd, sizeof(cmd), "AT+CMGD=%d", index);
-  return sendCommand(cmd, 3000).indexOf("OK") >= 0;
+  AT_GUARD();
+  return command(AT_Cmd::SMS_DELETE, 3000, index, 0) == AT_RESULT_OK;
 }
 
 bool AT_Lib::deleteAllSMS()
 {
+  AT_GUARD();
   // 4 = delete all messages
-  return sendCommand("AT+CMGD=1,4", 5000).indexOf("OK") >= 0;
+  return command(AT_Cmd::SMS_DELETE, 0, 1, 4) == AT_RESULT_OK;
 }
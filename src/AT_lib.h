@@ -3,6 +3,28 @@
 
 #include <Arduino.h>
 #include "Sim76xx_mqtt_errors.h"
+#include "AT_buffer.h"
+#include "AT_cmd.h"
+#include "AT_topics.h"
+#include "AT_match.h"
+#include "AT_log.h"
+#include "AT_stats.h"
+#include "AT_trace.h"
+#include "AT_uart.h"
+#include "AT_outbox.h"
+#include "AT_telemetry.h"
+#include "AT_codec.h"
+
+#ifndef AT_RTOS
+#define AT_RTOS 0 // 1: beginTasks() runs a reader and a callback task (FreeRTOS)
+#endif
+
+#if AT_RTOS
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <freertos/queue.h>
+#endif
 
 /* =====================================================
  * MQTT STATE MACHINE
@@ -16,11 +38,265 @@ typedef enum
   MQTT_STATE_SUBSCRIBED
 } SIM76xx_mqtt_state_t;
 
+/* =====================================================
+ * AT RESPONSE RESULT
+ * Which final result code ended a response read
+ * ===================================================== */
+typedef enum
+{
+  AT_RESULT_TIMEOUT = 0, /**< No final result code before timeout */
+  AT_RESULT_OK,          /**< OK */
+  AT_RESULT_ERROR,       /**< ERROR */
+  AT_RESULT_CME_ERROR,   /**< +CME ERROR: <err> */
+  AT_RESULT_CMS_ERROR,   /**< +CMS ERROR: <err> */
+  AT_RESULT_PROMPT,      /**< '>' data prompt */
+  AT_RESULT_TERMINATOR   /**< Caller-supplied terminator line */
+} AT_result_t;
+
+/* =====================================================
+ * ASYNC COMPLETION
+ * Passed to the callback of an async transaction
+ * ===================================================== */
+typedef struct
+{
+  AT_result_t result; /**< Final result code of the last step that ran */
+  int code;           /**< +CMQTTxxx <err>, +CME/+CMS error, else 0 */
+  bool ok;            /**< Operation succeeded */
+  AT_Slice response;  /**< Raw response, valid only inside the callback */
+} AT_Completion;
+
+/* =====================================================
+ * MQTT SUBSCRIPTION
+ * One entry of a mqttSubscribeMany() batch
+ * ===================================================== */
+typedef struct
+{
+  const char *topic;     /**< Topic filter, '+' and '#' allowed */
+  uint8_t qos;           /**< Requested QoS 0..2 */
+  mqtt_rx_callback_t cb; /**< Handler, or nullptr for onMQTTReceived */
+} AT_MqttSub;
+
 /* =====================================================
  * CALLBACK TYPES
  * ===================================================== */
-typedef void (*mqtt_rx_callback_t)(const char *topic, const char *payload, uint16_t payloadLen);
+/* mqtt_rx_callback_t comes from AT_topics.h */
+/* Streaming receive: called per chunk; offset + chunkLen == total on the last one */
+typedef void (*mqtt_chunk_callback_t)(const char *topic, const uint8_t *chunk, uint16_t chunkLen,
+                                      uint32_t offset, uint32_t total);
 typedef void (*sms_rx_callback_t)(const char *sender, const char *timestamp, const char *message);
+typedef void (*urc_callback_t)(const char *line);
+typedef void (*at_async_callback_t)(const AT_Completion &done, void *user);
+
+/* =====================================================
+ * BUFFER LIMITS
+ * ===================================================== */
+#ifndef AT_LINE_MAX
+#define AT_LINE_MAX 256 // longest modem line kept for parsing
+#endif
+
+#ifndef AT_RX_BUFFER_SIZE
+#define AT_RX_BUFFER_SIZE 512 // UART receive ring, power of two
+#endif
+
+#ifndef AT_RESPONSE_MAX
+#define AT_RESPONSE_MAX 1024 // one command response, excess is truncated
+#endif
+
+#ifndef AT_SMS_SENDER_MAX
+#define AT_SMS_SENDER_MAX 32
+#endif
+
+#ifndef AT_SMS_TIME_MAX
+#define AT_SMS_TIME_MAX 32
+#endif
+
+#ifndef AT_SMS_BODY_MAX
+#define AT_SMS_BODY_MAX 256
+#endif
+
+#ifndef AT_ASYNC_QUEUE_LEN
+#define AT_ASYNC_QUEUE_LEN 8 // queued transactions (a publish takes 3)
+#endif
+
+#ifndef AT_ASYNC_CMD_MAX
+#define AT_ASYNC_CMD_MAX 192 // longest queued command line
+#endif
+
+#ifndef AT_ASYNC_DATA_SIZE
+#define AT_ASYNC_DATA_SIZE 2048 // prompt payloads (topics, bodies) of queued transactions
+#endif
+
+#ifndef AT_URC_USER_MAX
+#define AT_URC_USER_MAX 8 // user-registered URC prefixes
+#endif
+
+#ifndef AT_MQTT_CLIENTS
+#define AT_MQTT_CLIENTS 2 // SIM7600 MQTT client indices 0..1
+#endif
+
+#ifndef AT_MQTT_RX_QUEUE
+#define AT_MQTT_RX_QUEUE 4 // complete messages per client waiting for poll()
+#endif
+
+#ifndef AT_SMS_PENDING_MAX
+#define AT_SMS_PENDING_MAX 8 // +CMTI indices waiting for readSMS()
+#endif
+
+#ifndef AT_SMS_READ_RETRIES
+#define AT_SMS_READ_RETRIES 2 // AT+CMGR attempts after a failed one, per index
+#endif
+
+#ifndef AT_MQTT_BACKOFF_MIN
+#define AT_MQTT_BACKOFF_MIN 1000 // first reconnect delay (ms), before jitter
+#endif
+
+#ifndef AT_MQTT_BACKOFF_MAX
+#define AT_MQTT_BACKOFF_MAX 60000 // reconnect delay cap (ms)
+#endif
+
+#ifndef AT_MQTT_CHECK_INTERVAL
+#define AT_MQTT_CHECK_INTERVAL 30000 // AT+CMQTTCONNECT? liveness check (ms), 0 = off
+#endif
+
+#ifndef AT_MQTT_RELEASE_AFTER
+#define AT_MQTT_RELEASE_AFTER 4 // failed reconnects before the client is released and acquired anew
+#endif
+
+#ifndef AT_MQTT_PUB_TIMEOUT
+#define AT_MQTT_PUB_TIMEOUT 60 // <pub_timeout> (s) of AT+CMQTTPUB, the modem's wait for the broker
+#endif
+
+#ifndef AT_MQTT_PUB_WINDOW_MAX
+#define AT_MQTT_PUB_WINDOW_MAX 4 // most pipelined publishes between queueing and their result
+#endif
+
+#ifndef AT_MQTT_PUB_RETRIES
+#define AT_MQTT_PUB_RETRIES 2 // resends of a pipelined publish that timed out
+#endif
+
+#ifndef AT_MQTT_PUB_RETRY_DATA
+#define AT_MQTT_PUB_RETRY_DATA 1024 // copies of pipelined topics + payloads kept for resends
+#endif
+
+#ifndef AT_CODEC_ROUTES
+#define AT_CODEC_ROUTES 8 // topic filters with their own payload codec
+#endif
+
+#ifndef AT_OUTBOX_DRAIN_RATE
+#define AT_OUTBOX_DRAIN_RATE 4 // stored publishes sent per second once reconnected, 0 = no limit
+#endif
+
+#ifndef AT_OUTBOX_RATE_WINDOW
+#define AT_OUTBOX_RATE_WINDOW 10000 // longest stretch of a drain the rate is measured over (ms)
+#endif
+
+/* =====================================================
+ * MQTT SESSION
+ * What the supervisor reconnects a client with. The
+ * strings are not copied and must stay valid.
+ * ===================================================== */
+struct AT_MqttSession
+{
+  const char *clientName = nullptr;
+  const char *uri = nullptr;
+  const char *user = "";
+  const char *pass = "";
+  uint16_t keepAlive = 60;
+  bool cleanSession = true;
+  uint32_t backoffMinMs = AT_MQTT_BACKOFF_MIN;
+  uint32_t backoffMaxMs = AT_MQTT_BACKOFF_MAX;
+  uint32_t checkIntervalMs = AT_MQTT_CHECK_INTERVAL;
+};
+
+/* =====================================================
+ * PUBLISH CHANNEL
+ * One topic published again and again. openChannel()
+ * checks and copies the topic once and renders its
+ * AT+CMQTTTOPIC and AT+CMQTTPUB lines, so a publish on
+ * the channel only appends the payload length to the
+ * AT+CMQTTPAYLOAD line. The codec is looked up again
+ * only after setCodec() / setDefaultCodec().
+ * ===================================================== */
+class AT_PublishChannel
+{
+public:
+  static const uint16_t TOPIC_MAX = 128; // same limit as mqttPublish()
+
+  bool isOpen() const { return _topicLen != 0; }
+  void close() { _topicLen = 0; }
+  const char *topic() const { return _topic; }
+  uint8_t clientId() const { return _client; }
+  uint8_t qos() const { return _qos; }
+  bool retained() const { return _retain; }
+
+private:
+  friend class AT_Lib;
+  static const uint8_t LINE_MAX = 32;
+
+  const char *payloadLine(uint16_t length);
+
+  char _topic[TOPIC_MAX + 1] = {};
+  uint16_t _topicLen = 0;
+  uint8_t _client = 0;
+  uint8_t _qos = 0;
+  bool _retain = false;
+  uint32_t _timeout = 0;
+  uint8_t _codec = AT_CODEC_JSON;
+  uint16_t _codecVersion = 0; // of the codec table _codec was found in
+  char _topicLine[LINE_MAX] = {};   // AT+CMQTTTOPIC=<client>,<topic_len>
+  char _pubLine[LINE_MAX] = {};     // AT+CMQTTPUB=<client>,<qos>,<pub_timeout>[,1]
+  char _payloadLine[LINE_MAX] = {}; // AT+CMQTTPAYLOAD=<client>, then the length
+  uint8_t _payloadPrefix = 0;
+};
+
+#if AT_RTOS
+#ifndef AT_RTOS_READER_STACK
+#define AT_RTOS_READER_STACK 4096
+#endif
+
+#ifndef AT_RTOS_READER_PRIORITY
+#define AT_RTOS_READER_PRIORITY 5 // above loop() (1), so UART data is parsed promptly
+#endif
+
+#ifndef AT_RTOS_CALLBACK_STACK
+#define AT_RTOS_CALLBACK_STACK 6144 // user handlers run here
+#endif
+
+#ifndef AT_RTOS_CALLBACK_PRIORITY
+#define AT_RTOS_CALLBACK_PRIORITY 2
+#endif
+
+#ifndef AT_RTOS_EVENT_QUEUE_LEN
+#define AT_RTOS_EVENT_QUEUE_LEN 8 // messages / SMS / URCs waiting for the callback task
+#endif
+
+#ifndef AT_RTOS_IDLE_MS
+#define AT_RTOS_IDLE_MS 10 // reader wake-up period when nothing notifies it
+#endif
+
+/* =====================================================
+ * RTOS TASK SETTINGS
+ * Core -1 leaves a task unpinned
+ * ===================================================== */
+struct AT_RtosConfig
+{
+  uint32_t readerStack = AT_RTOS_READER_STACK;
+  UBaseType_t readerPriority = AT_RTOS_READER_PRIORITY;
+  int8_t readerCore = -1;
+  uint32_t callbackStack = AT_RTOS_CALLBACK_STACK;
+  UBaseType_t callbackPriority = AT_RTOS_CALLBACK_PRIORITY;
+  int8_t callbackCore = -1;
+  uint8_t eventQueueLen = AT_RTOS_EVENT_QUEUE_LEN;
+};
+
+/* Serializes a public call against the reader task and other callers */
+#define AT_GUARD() Guard _guard(_lock)
+#else
+#define AT_GUARD() \
+  do               \
+  {                \
+  } while (0)
+#endif
 
 /* =====================================================
  * AT LIB CLASS
@@ -29,21 +305,115 @@ class AT_Lib
 {
 public:
   AT_Lib(HardwareSerial &modemSerial, Stream &debugSerial);
+  /* Any stream as the modem, e.g. an AT_TraceReplay; begin() and
+   * the UART link settings then only keep track of the rate */
+  AT_Lib(Stream &modemStream, Stream &debugSerial);
+#if AT_UART_EVENTS
+  /* ESP-IDF UART driver: blocking calls and the RTOS reader sleep
+   * until a line or prompt arrives instead of polling the UART */
+  AT_Lib(AT_UartEvents &modemUart, Stream &debugSerial);
+#endif
 
   bool begin(unsigned long baud, int8_t rxPin, int8_t txPin);
+  /* Same, and once modemReady() succeeds: RTS/CTS when both pins are
+   * given, then AT+IPR up to `fastBaud`, verified with AT and dropped
+   * back to `baud` if the modem stops answering. Re-applied after a
+   * modem reboot, since both settings are volatile on the SIM7600. */
+  bool begin(unsigned long baud, int8_t rxPin, int8_t txPin, unsigned long fastBaud,
+             int8_t rtsPin = -1, int8_t ctsPin = -1);
+
+  /* UART link */
+  bool setBaudRate(unsigned long baud, uint32_t timeout = 1000);
+  bool enableFlowControl(int8_t rtsPin, int8_t ctsPin, uint32_t timeout = 1000);
+  unsigned long baudRate() const { return _baud; }
 
   /* Basic AT helpers */
-  String sendCommand(const char *command, uint32_t timeout = 500);
+  String sendCommand(const char *command, uint32_t timeout = 500,
+                     const char *terminator = nullptr, AT_result_t *resultOut = nullptr);
   String sendFormatted(const char *format, const char *value, uint32_t timeout = 500);
 
+  /* Reads until a final result code, a '>' prompt or a line starting
+   * with `terminator`. When a terminator is given, OK does not end the
+   * read (the modem reports +CMQTTxxx results after OK). */
+  String readResponse(uint32_t timeout, const char *terminator = nullptr, AT_result_t *resultOut = nullptr);
+
+  /* Heap-free variants: the response is kept in a fixed internal
+   * buffer and stays valid until the next command. */
+  AT_result_t command(const char *command, uint32_t timeout = 500, const char *terminator = nullptr);
+  AT_result_t awaitResult(uint32_t timeout, const char *terminator = nullptr);
+  AT_Slice response() const { return AT_Slice(_resp, _respLen); }
+
+  /* Table commands (AT_cmd.h), e.g. command(AT_Cmd::SMS_READ, 0, 3).
+   * Arguments are checked against the entry's spec; a timeout of 0
+   * takes the entry's default, and an entry flagged RESULT reads on
+   * past OK to its result line. */
+  template <typename... Args>
+  AT_result_t command(const AT_CmdDef &cmd, uint32_t timeout, Args... args)
+  {
+    const AT_Arg list[] = {AT_Arg(), AT_Arg(args)...};
+    return commandArgs(cmd, timeout, list + 1, sizeof...(Args));
+  }
+
+  /* =================================================
+   * ASYNC API
+   * Work is queued and advanced by poll(); the callback
+   * fires once the last step completes or any step fails.
+   * Payloads are copied, so callers may reuse buffers.
+   * Blocking calls first finish a started chain, then run
+   * ahead of transactions still waiting in the queue.
+   * ================================================= */
+  bool commandAsync(const char *cmd, at_async_callback_t cb = nullptr, void *user = nullptr,
+                    uint32_t timeout = 500, const char *terminator = nullptr);
+  bool mqttPublishAsync(uint8_t clientId, const char *topic, const uint8_t *payload, uint16_t length,
+                        uint8_t qos, at_async_callback_t cb, void *user = nullptr, uint32_t timeout = 5000);
+  bool mqttConnectAsync(uint8_t clientId, const char *uri, const char *user, const char *pass,
+                        uint16_t keepAlive, bool cleanSession, at_async_callback_t cb, void *cbUser = nullptr,
+                        uint32_t timeout = 10000);
+  bool mqttSubscribeAsync(uint8_t clientId, const char *topic, uint8_t qos, mqtt_rx_callback_t rxCb,
+                          at_async_callback_t cb, void *user = nullptr, uint32_t timeout = 5000);
+  bool sendSMSAsync(const char *phoneNumber, const char *message, at_async_callback_t cb,
+                    void *user = nullptr, uint32_t timeout = 15000);
+  bool syncTimeAsync(at_async_callback_t cb, void *user = nullptr, uint32_t timeout = 5000);
+
+  template <typename... Args>
+  bool commandAsync(const AT_CmdDef &cmd, at_async_callback_t cb, void *user, uint32_t timeout, Args... args)
+  {
+    const AT_Arg list[] = {AT_Arg(), AT_Arg(args)...};
+    return commandAsyncArgs(cmd, cb, user, timeout, list + 1, sizeof...(Args));
+  }
+
+  bool asyncIdle() const;
+  uint8_t asyncPending() const { return _asyncCount; }
+
+  /* Pipelined publishing: with a window above 1, up to `window`
+   * mqttPublishAsync() calls may be between queueing and their
+   * result at once. AT+CMQTTPUB completes at OK, so the next
+   * topic and payload are loaded while the broker acknowledges;
+   * the callback fires on the later +CMQTTPUB: <client>,<err>.
+   * That result names no message, so results are matched to
+   * publishes per client in send order. A publish that timed out
+   * is sent again, up to `retries` times, when its topic and
+   * payload fit the AT_MQTT_PUB_RETRY_DATA copy. Blocking
+   * publishes first wait for the client's pipelined ones. */
+  bool setPublishWindow(uint8_t window, uint8_t retries = AT_MQTT_PUB_RETRIES);
+  uint8_t publishesInFlight() const;
+
   /* Modem lifecycle */
   bool waitForPBDONE(uint32_t timeout = 15000);
   bool modemReady(uint32_t timeout = 15000);
 
-  /* Polling */
-  void mqttPoll(); // only MQTT
-  void smsPoll();  // only SMS
-  void poll();     // both MQTT + SMS non-blocking
+  /* Polling
+   * All three drain the modem through one URC dispatcher;
+   * mqttPoll()/smsPoll() are kept for existing sketches. */
+  void mqttPoll();
+  void smsPoll();
+  void poll(); // MQTT + SMS + URCs, non-blocking; no-op while beginTasks() runs
+
+  /* URC routing
+   * `prefix` must outlive the registration (use a literal).
+   * User routes also see lines handled by built-in routes. */
+  bool onURC(const char *prefix, urc_callback_t cb);
+  bool removeURC(const char *prefix);
 
   bool syncTimeOnTimezone(uint32_t timeout = 30000);
 
@@ -64,64 +434,648 @@ public:
   bool mqttSubscribe(uint8_t clientId, const char *topic, uint8_t qos, mqtt_rx_callback_t cb,
                      uint32_t timeout = 5000);
   bool mqttUnsubscribe(uint8_t clientId, const char *topic, uint32_t timeout = 5000);
+  /* Batched: N topics in one SUBSCRIBE / UNSUBSCRIBE packet.
+   * Return the number of topics done; `results` is per topic. */
+  uint8_t mqttSubscribeMany(uint8_t clientId, const AT_MqttSub *subs, uint8_t count,
+                            SIM76xx_mqtt_err_t *results = nullptr, uint32_t timeout = 5000);
+  uint8_t mqttUnsubscribeMany(uint8_t clientId, const char *const *topics, uint8_t count,
+                              SIM76xx_mqtt_err_t *results = nullptr, uint32_t timeout = 5000);
   bool mqttPublish(uint8_t clientId, const char *topic, const uint8_t *payload, uint16_t length,
                    uint8_t qos = 0, uint32_t timeout = 5000);
+  /* Publish channels: the per-topic work of mqttPublish() done
+   * once (see AT_PublishChannel). publish() / publishAsync()
+   * then behave like mqttPublish() / mqttPublishAsync(), outbox
+   * included; a retained channel keeps that flag when stored. */
+  bool openChannel(AT_PublishChannel &channel, uint8_t clientId, const char *topic, uint8_t qos = 1,
+                   bool retain = false, uint32_t timeout = 5000);
+  bool publish(AT_PublishChannel &channel, const uint8_t *payload, uint16_t length);
+  bool publishAsync(AT_PublishChannel &channel, const uint8_t *payload, uint16_t length,
+                    at_async_callback_t cb = nullptr, void *user = nullptr);
   bool mqttDisconnect(uint8_t clientId, uint32_t timeout = 5000);
 
+  /* Supervision: poll() keeps the client connected. A lost link
+   * (+CMQTTCONNLOST, +CMQTTNONET, a result code meaning no
+   * connection, a failed AT+CMQTTCONNECT? check) is rebuilt with
+   * start / acquire / connect after a jittered exponential
+   * backoff, then every filter in the client's topic table is
+   * subscribed again. mqttDisconnect() and mqttStop() end it. */
+  bool mqttSupervise(uint8_t clientId, const AT_MqttSession &session);
+  void mqttUnsupervise(uint8_t clientId);
+
+  /* Store and forward: with an outbox attached, mqttPublish() and
+   * mqttPublishAsync() store the message instead of failing while
+   * the client is below MQTT_STATE_CONNECTED, and so does a
+   * blocking publish that finds the link gone. poll() sends the
+   * stored ones once the client is back, oldest first, at most
+   * `perSecond` a second and only while the async queue is empty,
+   * so live publishes go ahead of the backlog. A publish already
+   * queued when the link drops still fails to its callback. */
+  void setOutbox(AT_Outbox *outbox, uint16_t perSecond = AT_OUTBOX_DRAIN_RATE);
+  AT_Outbox *outbox() const { return _outbox; }
+
+  /* Telemetry batching: record() adds a sample to the attached
+   * buffer instead of publishing it, and poll() publishes each
+   * topic's samples as one message once the batch is full or
+   * its window is over (see AT_Telemetry for the format).
+   * Batches go out like mqttPublishAsync(), to the outbox while
+   * the link is down; without one they wait for the link.
+   * flushTelemetry() sends every batch at the next poll(). */
+  void setTelemetry(AT_Telemetry *telemetry, uint8_t clientId = 0, uint8_t qos = 1);
+  AT_Telemetry *telemetry() const { return _telemetry; }
+  bool record(const char *topic, double value);
+  bool record(const char *topic, long value);
+  bool record(const char *topic, unsigned long value);
+  bool record(const char *topic, int value) { return record(topic, (long)value); }
+  bool record(const char *topic, unsigned value) { return record(topic, (unsigned long)value); }
+  void flushTelemetry();
+
+  /* Payload codecs: topics matching `filter` carry `codec`, an
+   * AT_codec_t format optionally or'ed with AT_CODEC_LZ. Received
+   * payloads are unframed and must pass the format check
+   * (AT_codecValid) before a handler sees them; publishes to an
+   * LZ topic are framed on the way out. The first matching
+   * filter wins; other topics use the default, AT_CODEC_JSON.
+   * AT_CborWriter / AT_CborReader build and read CBOR payloads. */
+  bool setCodec(const char *filter, uint8_t codec);
+  void setDefaultCodec(uint8_t codec)
+  {
+    AT_GUARD();
+    _defaultCodec = codec;
+    _codecVersion++;
+  }
+  uint8_t codecFor(const char *topic) const;
+
   /* SMS API */
   bool enableSMS();
   bool sendSMS(const char *phoneNumber, const char *message, uint32_t timeout = 15000);
 
-  void onMQTTReceived(mqtt_rx_callback_t cb) { _mqttCallback = cb; }
-  void onSMSReceived(sms_rx_callback_t cb) { _smsCallback = cb; }
+  /* Fallback for messages no subscription handler claimed;
+   * without a client index it applies to every client */
+  void onMQTTReceived(mqtt_rx_callback_t cb);
+  void onMQTTReceived(uint8_t clientId, mqtt_rx_callback_t cb);
+  /* Filters registered by mqttSubscribe / mqttSubscribeAsync */
+  const AT_TopicTable &mqttSubscriptions(uint8_t clientId = 0) const;
+  /* Streaming mode: payloads of any size are handed over in chunks
+   * as they arrive, instead of buffered delivery from poll().
+   * Runs inside the reader, so it must not send AT commands. */
+  void onMQTTChunk(mqtt_chunk_callback_t cb);
+  void onMQTTChunk(uint8_t clientId, mqtt_chunk_callback_t cb);
+  /* Delivered messages are deleted from the SIM. One that cannot
+   * be read or parsed is counted in smsDropped and left there for
+   * readSMS() with the index from the warning. */
+  void onSMSReceived(sms_rx_callback_t cb)
+  {
+    AT_GUARD();
+    _smsCallback = cb;
+  }
 
+  bool readSMS(uint8_t index, char *outSender, size_t senderLen,
+               char *outTime, size_t timeLen, char *outMsg, size_t msgLen);
   bool readSMS(uint8_t index, String &outSender, String &outTime, String &outMsg);
   bool deleteSMS(uint8_t index);
   bool deleteAllSMS();
 
   /* State access */
-  SIM76xx_mqtt_state_t mqttState() const { return _mqttState; }
+  SIM76xx_mqtt_state_t mqttState(uint8_t clientId = 0) const;
+  int8_t networkRegistration() const { return _networkRegistration; } // last +CREG <stat>, -1 if unknown
+  int8_t networkTimezone() const { return _networkTimezone; }         // last +CTZV, quarters of an hour
+
+  /* Logging: runtime level, capped by the compile-time AT_LOG_LEVEL.
+   * A sink replaces the debug stream as the destination. */
+  void setLogLevel(AT_log_level_t level)
+  {
+    AT_GUARD();
+    _logLevel = level;
+  }
+  AT_log_level_t logLevel() const { return _logLevel; }
+  void setLogSink(at_log_sink_t sink, void *user = nullptr)
+  {
+    AT_GUARD();
+    _logSink = sink;
+    _logUser = user;
+  }
+
+  /* Metrics: latency per command family, UART bytes, timeouts,
+   * MQTT result codes and buffer overflows. stats() is a copy,
+   * so it can be formatted (AT_statsToJson) and published. */
+  AT_Stats stats() const
+  {
+    AT_GUARD();
+    AT_Stats s = _stats;
+    s.outboxDepth = _outbox ? _outbox->depth() : 0;
+    return s;
+  }
+  void resetStats();
+
+  /* Records every byte to and from the modem; nullptr stops */
+  void setTrace(AT_TraceRecorder *trace)
+  {
+    AT_GUARD();
+    _trace = trace;
+  }
+  AT_TraceRecorder *trace() const { return _trace; }
+
+#if AT_RTOS
+  /* =================================================
+   * RTOS MODE
+   * A reader task parses modem output and advances async
+   * work, so poll() is no longer needed. MQTT messages, SMS
+   * and user URCs go through a queue to a callback task,
+   * where handlers may call any blocking API. Every public
+   * call takes one recursive mutex, so any task can send
+   * commands. Async completions and onMQTTChunk() still run
+   * on the reader task. Start after begin(); endTasks() must
+   * not be called from a handler.
+   * ================================================= */
+  bool beginTasks(const AT_RtosConfig &config = AT_RtosConfig());
+  void endTasks();
+  bool tasksRunning() const { return _readerTask != nullptr; }
+#endif
 
 private:
   /* Core serial interfaces */
-  HardwareSerial &_modemSerial;
+  Stream &_modemSerial;
+  HardwareSerial *_modemUart; // nullptr when the modem is a plain stream
+  AT_UartEvents *_modemEvents = nullptr;
   Stream &_debugSerial;
+  AT_TraceRecorder *_trace = nullptr;
+
+  /* UART link */
+  unsigned long _baseBaud = 0; // rate the modem boots with
+  unsigned long _baud = 0;     // current rate on both ends
+  unsigned long _fastBaud = 0; // negotiated by modemReady(), 0 = off
+  int8_t _rxPin = -1;
+  int8_t _txPin = -1;
+  int8_t _rtsPin = -1;
+  int8_t _ctsPin = -1;
+  bool _linkPending = false; // fast baud / flow control not applied yet
+
+  /* Logging */
+  AT_log_level_t _logLevel = (AT_log_level_t)AT_LOG_LEVEL;
+  at_log_sink_t _logSink = nullptr;
+  void *_logUser = nullptr;
+  void logPrintf(AT_log_level_t level, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+  /* Metrics */
+  AT_Stats _stats = {};
+  AT_cmd_family_t _statFamily = AT_FAMILY_GENERIC;
+  uint32_t _statStart = 0;
+  bool _statPending = false; // command written, final result not seen yet
+  void statBegin(const char *command);
+  void statBegin(AT_cmd_family_t family);
+  void statEnd(AT_result_t result);
+  void statMqttResult(int err);
 
   /* MQTT RX state machine */
   enum RxState
   {
     RX_IDLE,
-    RX_TOPIC,
-    RX_PAYLOAD
+    RX_HEADER, // inside +CMQTTRXSTART .. +CMQTTRXEND
+    RX_TOPIC,  // reading expectedLen raw topic bytes
+    RX_PAYLOAD // reading expectedLen raw payload bytes
   };
-  RxState rxState = RX_IDLE;
-  uint16_t expectedLen = 0;
-  uint16_t received = 0;
   static const uint16_t MQTT_TOPIC_MAX = 128;
   static const uint16_t MQTT_PAYLOAD_MAX = 1024;
 
-  char rxTopic[MQTT_TOPIC_MAX];
-  char rxPayload[MQTT_PAYLOAD_MAX];
+  /* One received message; assembled in place at the queue's tail */
+  struct RxMessage
+  {
+    uint16_t len = 0;
+    char topic[MQTT_TOPIC_MAX];
+    char payload[MQTT_PAYLOAD_MAX + 1];
+  };
+
+  /* Per-client MQTT context, indexed by <client_index> */
+  struct MqttClient
+  {
+    RxState rxState = RX_IDLE;
+    uint32_t expectedLen = 0; // raw bytes left in the current block
+    uint32_t received = 0;    // payload bytes seen so far
+    uint32_t rxTotal = 0;     // payload length from +CMQTTRXSTART
+    uint16_t rxTopicLen = 0;
+    uint16_t rxChunkLen = 0;
+    bool rxOverflow = false;
+    bool rxDiscard = false; // queue was full at +CMQTTRXSTART
+    RxMessage rxQueue[AT_MQTT_RX_QUEUE];
+    uint8_t rxHead = 0;  // oldest complete message
+    uint8_t rxCount = 0; // complete messages waiting for poll()
+    RxMessage &rxIn() { return rxQueue[(rxHead + rxCount) % AT_MQTT_RX_QUEUE]; }
+
+    AT_TopicTable topics; // subscriptions with per-filter handlers
+    mqtt_rx_callback_t callback = nullptr;
+    mqtt_chunk_callback_t chunkCallback = nullptr;
+    SIM76xx_mqtt_state_t state = MQTT_STATE_IDLE;
+
+    /* Supervisor */
+    AT_MqttSession session;
+    bool supervised = false;
+    bool supArmed = false;       // reconnect scheduled at supRetryAt
+    bool supResubscribe = false; // topic table not yet restored
+    bool supLost = false;        // link went down since the last connect
+    uint8_t supFailures = 0;     // failed reconnects in a row
+    uint8_t supResubNext = 0;    // next topic table entry to restore
+    uint8_t supReleasedAt = 0;   // supFailures when last released
+    uint32_t supRetryAt = 0;
+    uint32_t supCheckAt = 0;
+  };
+  MqttClient _mqtt[AT_MQTT_CLIENTS];
+  MqttClient *_mqttRaw = nullptr; // client whose raw bytes are being read
+  uint32_t _mqttRawSkip = 0;      // raw bytes announced for an unknown client
+  bool _mqttDelivering = false;   // inside deliverMqtt()'s callbacks
+
+  /* Supervisor: one step in flight across all clients */
+  enum SupStep
+  {
+    SUP_START,
+    SUP_RELEASE,
+    SUP_ACQUIRE,
+    SUP_CONNECT,
+    SUP_RESUBSCRIBE,
+    SUP_CHECK
+  };
+  int8_t _supClient = -1;
+  SupStep _supStep = SUP_START;
+  uint8_t _supResubEnd = 0; // topic table entry after the batch in flight
+  uint32_t _supRng = 0;
 
-  typedef void (*mqtt_rx_callback_t)(const char *topic,
-                                     const char *payload,
-                                     uint16_t length);
+  /* Async transaction queue */
+  enum AsyncState
+  {
+    ASYNC_IDLE,
+    ASYNC_WAIT_PROMPT,
+    ASYNC_WAIT_RESULT
+  };
+  enum AsyncFlags
+  {
+    TX_CHAINED = 0x01, // more steps of the same operation follow
+    TX_CTRL_Z = 0x02   // terminate prompt data with CTRL+Z (SMS)
+  };
+  struct AsyncTx
+  {
+    char cmd[AT_ASYNC_CMD_MAX];
+    const AT_CmdDef *def; // table entry, nullptr for raw commands
+    uint16_t dataOff;
+    uint16_t dataLen;
+    const char *terminator;
+    uint32_t timeout;
+    at_async_callback_t cb;
+    void *user;
+    uint8_t flags;
+  };
+  struct AsyncMark
+  {
+    uint8_t count;
+    uint16_t dataHead;
+    uint16_t dataTail;
+    uint16_t dataUsed;
+    uint16_t dataWrap;
+    bool dataWrapped;
+  };
+  AsyncTx _asyncQueue[AT_ASYNC_QUEUE_LEN];
+  uint8_t _asyncHead = 0;
+  uint8_t _asyncCount = 0;
+  AsyncState _asyncState = ASYNC_IDLE;
+  bool _asyncChainOpen = false;
+  uint32_t _asyncStart = 0;
 
-  /* SMS buffer */
-  String smsLineBuffer = "";
+  uint8_t _asyncData[AT_ASYNC_DATA_SIZE];
+  uint16_t _dataHead = 0;
+  uint16_t _dataTail = 0;
+  uint16_t _dataUsed = 0;
+  uint16_t _dataWrap = 0;
+  bool _dataWrapped = false;
+
+  /* Async subscribes in queue order, with the table entry
+   * to put back if the SUB fails (each takes 2 transactions) */
+  struct SubUndo
+  {
+    char filter[AT_MQTT_FILTER_MAX];
+    uint8_t client;
+    uint8_t qos;
+    mqtt_rx_callback_t cb;
+    bool known; // the filter was in the table before
+    uint8_t prevQos;
+    mqtt_rx_callback_t prevCb;
+    at_async_callback_t userCb;
+    void *user;
+  };
+  SubUndo _subUndo[AT_ASYNC_QUEUE_LEN / 2];
+  uint8_t _subUndoHead = 0;
+  uint8_t _subUndoCount = 0;
+
+  /* Outbox drain: one stored publish in flight at a time */
+  AT_Outbox *_outbox = nullptr;
+  uint16_t _outboxRate = AT_OUTBOX_DRAIN_RATE;
+  bool _outboxBusy = false;
+  uint32_t _outboxSeq = 0;    // record in flight
+  uint32_t _outboxNextAt = 0; // rate limit
+  uint32_t _outboxDropBase = 0; // _outbox->dropped() already counted
+  bool _outboxWindowOpen = false; // drain rate being measured
+  uint32_t _outboxWindowAt = 0;
+  uint32_t _outboxWindowSent = 0;
+
+  /* Payload codecs */
+  struct CodecRoute
+  {
+    char filter[AT_MQTT_FILTER_MAX];
+    uint8_t codec;
+  };
+  CodecRoute _codecs[AT_CODEC_ROUTES];
+  uint8_t _codecCount = 0;
+  uint8_t _defaultCodec = AT_CODEC_JSON;
+  uint16_t _codecVersion = 1; // bumped on every change, for channels
+  uint8_t _codecTx[MQTT_PAYLOAD_MAX];  // framed publish payload
+  char _codecRx[MQTT_PAYLOAD_MAX + 1]; // unframed received payload
+
+  /* Telemetry batches */
+  AT_Telemetry *_telemetry = nullptr;
+  uint8_t _telemetryClient = 0;
+  uint8_t _telemetryQos = 1;
+  bool _telemetryFlush = false;
+
+  /* Pipelined publishes, from queueing to their callback.
+   * `order` is the queue order until AT+CMQTTPUB is answered,
+   * then the send order results are matched in. */
+  enum PubState
+  {
+    PUB_FREE,
+    PUB_QUEUED, // TOPIC, PAYLOAD, PUB chain in the async queue
+    PUB_SENT,   // AT+CMQTTPUB answered OK, +CMQTTPUB: pending
+    PUB_RESEND, // timed out, queued again once there is room
+    PUB_DONE    // result in, callback due from poll()
+  };
+  struct PubSlot
+  {
+    PubState state;
+    uint8_t client;
+    uint8_t qos;
+    bool retain;
+    uint8_t retries;
+    AT_result_t result;
+    int code;
+    uint32_t order;
+    uint32_t sentAt;
+    uint32_t timeout;
+    at_async_callback_t cb;
+    void *user;
+    int32_t dataOff; // topic + payload copy in _pubData, -1 if none
+    uint16_t topicLen;
+    uint16_t payloadLen;
+  };
+  PubSlot _pub[AT_MQTT_PUB_WINDOW_MAX] = {};
+  uint8_t _pubWindow = 1;
+  uint8_t _pubRetries = AT_MQTT_PUB_RETRIES;
+  uint32_t _pubOrder = 0;
+  uint8_t _pubData[AT_MQTT_PUB_RETRY_DATA];
+
+  /* syncTimeAsync() forwarding */
+  bool _timeSyncPending = false;
+  at_async_callback_t _timeSyncCb = nullptr;
+  void *_timeSyncUser = nullptr;
+
+  /* Receive ring and last command response */
+  AT_RingBuffer<AT_RX_BUFFER_SIZE> _rx;
+  char _resp[AT_RESPONSE_MAX] = {};
+  uint16_t _respLen = 0;
+  uint16_t _respLineStart = 0;
+  bool _respTruncated = false;
+  const char *_respTerminator = nullptr;
+
+  /* Line assembler shared by poll() and readResponse() */
+  char _line[AT_LINE_MAX];
+  uint16_t _lineLen = 0;
+  bool _lineTruncated = false;
+
+  /* Known line starts, matched while the line assembles;
+   * one bit per result code, built-in route and user route */
+  enum LineToken
+  {
+    TOK_OK,
+    TOK_ERROR,
+    TOK_CME_ERROR,
+    TOK_CMS_ERROR,
+    TOK_PB_DONE,
+    TOK_ROUTE,               // + index into URC_ROUTES
+    TOK_USER = TOK_ROUTE + 7 // + index into _userUrcs
+  };
+  AT_Matcher _match;
+  AT_match_mask_t _lineTokens = 0; // of the line feedLine() completed last
+
+  /* URC routing */
+  typedef void (AT_Lib::*urc_handler_t)(const char *line, uint16_t len);
+  struct UrcRoute
+  {
+    const char *prefix;
+    urc_handler_t handler;
+  };
+  struct UserUrc
+  {
+    const char *prefix;
+    uint8_t prefixLen;
+    urc_callback_t cb;
+  };
+  static const uint8_t URC_ROUTE_COUNT = TOK_USER - TOK_ROUTE;
+  static const UrcRoute URC_ROUTES[URC_ROUTE_COUNT];
+  UserUrc _userUrcs[AT_URC_USER_MAX] = {};
+
+  /* SMS indices announced by +CMTI */
+  uint8_t _smsPending[AT_SMS_PENDING_MAX];
+  uint8_t _smsPendingHead = 0;
+  uint8_t _smsPendingCount = 0;
+  int16_t _smsReadIndex = -1; // AT+CMGR in flight
+  uint8_t _smsReadTries = 0;  // failed AT+CMGR of the head index
+
+  /* Network state from URCs */
+  int8_t _networkRegistration = -1;
+  int8_t _networkTimezone = 0;
 
   /* Callbacks */
-  mqtt_rx_callback_t _mqttCallback = nullptr;
   sms_rx_callback_t _smsCallback = nullptr;
 
-  /* MQTT state */
-  SIM76xx_mqtt_state_t _mqttState = MQTT_STATE_IDLE;
+#if AT_RTOS
+  /* RTOS mode: recursive lock held for every public call; nullptr
+   * until beginTasks(), so single-task use pays nothing */
+  struct Guard
+  {
+    SemaphoreHandle_t lock;
+    explicit Guard(SemaphoreHandle_t l) : lock(l)
+    {
+      if (lock)
+        xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+    }
+    ~Guard()
+    {
+      if (lock)
+        xSemaphoreGiveRecursive(lock);
+    }
+  };
+  enum RtosEventType
+  {
+    RTOS_EV_MQTT,
+    RTOS_EV_SMS,
+    RTOS_EV_URC,
+    RTOS_EV_STOP
+  };
+  struct RtosEvent
+  {
+    uint8_t type;
+    uint8_t client;
+    uint16_t len;
+    char topic[MQTT_TOPIC_MAX]; // MQTT topic or SMS sender
+    char time[AT_SMS_TIME_MAX];
+    char data[MQTT_PAYLOAD_MAX + 1]; // payload, SMS body or URC line
+  };
+  SemaphoreHandle_t _lock = nullptr;
+  QueueHandle_t _events = nullptr;
+  TaskHandle_t _readerTask = nullptr;
+  TaskHandle_t _callbackTask = nullptr;
+  bool _rtosStop = false;
+  RtosEvent _eventOut; // filled under the lock, copied into the queue
+  RtosEvent _eventIn;  // owned by the callback task
+
+  bool postEvent(uint8_t type, uint8_t client, const char *topic, const char *time,
+                 const char *data, uint16_t len);
+  void runEvent(const RtosEvent &ev);
+  uint32_t readerWaitMs() const;
+  uint32_t outboxWaitMs() const;
+  uint32_t publishWaitMs() const;
+  uint32_t telemetryWaitMs() const;
+  void wakeReader();
+  static void readerTask(void *arg);
+  static void callbackTask(void *arg);
+#endif
 
   /* Internal helpers */
-  String readUntilTimeout(uint32_t timeout);
-  bool waitPrompt(char prompt, uint32_t timeout);
+  bool waitPrompt(uint32_t timeout);
+  void pumpModem();
+  void waitModem(uint32_t ms);
+  void setUartBaud(unsigned long baud);
+  void setUartFlowControl(int8_t rtsPin, int8_t ctsPin);
+  void appendResponse(char c);
+  void writeCommand(const char *command);
+  void writeLine(const char *line, AT_cmd_family_t family);
+  bool writeArgs(const AT_CmdDef &cmd, const AT_Arg *args, uint8_t count);
+  template <typename... Args>
+  bool writeCommand(const AT_CmdDef &cmd, Args... args)
+  {
+    const AT_Arg list[] = {AT_Arg(), AT_Arg(args)...};
+    return writeArgs(cmd, list + 1, sizeof...(Args));
+  }
+  AT_result_t commandArgs(const AT_CmdDef &cmd, uint32_t timeout, const AT_Arg *args, uint8_t count);
+  void modemWrite(const uint8_t *data, size_t len);
+  void modemPrint(const char *text);
+  void beginResponse(const char *terminator);
+  void switchBaud(unsigned long baud);
+  bool probeLink(uint32_t timeout);
+  void applyLink();
+  AT_result_t collectResponse();
+  void endResponse();
+  bool applyNetworkTime(AT_Slice response);
+  bool parseSMS(AT_Slice response, char *outSender, size_t senderLen,
+                char *outTime, size_t timeLen, char *outMsg, size_t msgLen);
+
+  /* Async engine */
+  int32_t allocAsyncData(uint16_t len);
+  void freeAsyncData(uint16_t off, uint16_t len);
+  AsyncTx *pushAsync(const char *cmd, const uint8_t *data, uint16_t dataLen,
+                     const char *terminator, uint32_t timeout);
+  AsyncTx *pushLine(const char *line, const AT_CmdDef &cmd, const uint8_t *data, uint16_t dataLen,
+                    uint32_t timeout);
+  AsyncTx *pushArgs(const AT_CmdDef &cmd, const AT_Arg *args, uint8_t count,
+                    const uint8_t *data, uint16_t dataLen, uint32_t timeout);
+  template <typename... Args>
+  AsyncTx *pushCommand(const AT_CmdDef &cmd, const uint8_t *data, uint16_t dataLen, uint32_t timeout, Args... args)
+  {
+    const AT_Arg list[] = {AT_Arg(), AT_Arg(args)...};
+    return pushArgs(cmd, list + 1, sizeof...(Args), data, dataLen, timeout);
+  }
+  bool commandAsyncArgs(const AT_CmdDef &cmd, at_async_callback_t cb, void *user, uint32_t timeout,
+                        const AT_Arg *args, uint8_t count);
+  AsyncMark markAsync() const;
+  void rollbackAsync(const AsyncMark &mark);
+  void finishAsync(AT_result_t result);
+  void asyncStep();
+  void waitAsyncIdle();
+  void smsRead(const AT_Completion &done);
+  static void onSmsRead(const AT_Completion &done, void *user);
+  static void onTimeSync(const AT_Completion &done, void *user);
+  bool feedLine(char c);
+  bool buildMatcher();
+  AT_result_t classifyLine(const char *line, const char *terminator) const;
+  bool dispatchLine(const char *line, uint16_t len);
+  void drainModem();
+  void pollStep();
+  bool feedMqttData(char c);
+  void flushMqttChunk(MqttClient &c);
+  MqttClient *mqttClient(uint8_t clientId);
+  void deliverMqtt();
+  void deliverSMS();
+
+  /* Built-in URC handlers */
+  void handleMqttRx(const char *line, uint16_t len);
+  void handleCmti(const char *line, uint16_t len);
+  void handleConnLost(const char *line, uint16_t len);
+  void handleCtzv(const char *line, uint16_t len);
+  void handleCreg(const char *line, uint16_t len);
+  void handleNoNet(const char *line, uint16_t len);
+  void handlePubResult(const char *line, uint16_t len);
+
+  /* Supervisor */
+  void superviseStep();
+  bool superviseNext(uint8_t clientId);
+  bool superviseResubscribe(uint8_t clientId);
+  uint32_t superviseBackoff(const MqttClient &c);
+  uint32_t superviseWaitMs() const;
+  void superviseDone(const AT_Completion &done);
+  static void onSuperviseStep(const AT_Completion &done, void *user);
+  void mqttLinkDown(uint8_t clientId, SIM76xx_mqtt_state_t state, const char *why);
+  void noteMqttResult(const char *result, int clientId, int err);
   bool rebootModem(uint32_t timeout = 15000);
-  bool parseMqttResult(const String &response, const char *prefix, SIM76xx_mqtt_err_t *errOut = nullptr);
+  bool parseMqttResult(AT_Slice response, const AT_CmdDef &cmd, SIM76xx_mqtt_err_t *errOut = nullptr);
+  AT_result_t stageMqttTopic(const AT_CmdDef &cmd, const AT_Arg *args, uint8_t count,
+                             const char *topic, uint32_t timeout);
+  void subscribed(const AT_Completion &done);
+  static void onSubscribed(const AT_Completion &done, void *user);
+
+  /* Outbox */
+  bool outboxWanted(uint8_t clientId);
+  bool outboxStore(const AT_PublishChannel &channel, const uint8_t *payload, uint16_t length);
+  void outboxStep();
+  void outboxDone(const AT_Completion &done);
+  static void onOutboxSent(const AT_Completion &done, void *user);
+  void noteOutboxDrops();
+  void closeOutboxWindow();
+  bool prepareChannel(AT_PublishChannel &channel, uint8_t clientId, const char *topic, uint16_t topicLen,
+                      uint8_t qos, bool retain, uint32_t timeout);
+  bool publishNow(AT_PublishChannel &channel, const uint8_t *payload, uint16_t length);
+  bool publishQueued(AT_PublishChannel &channel, const uint8_t *payload, uint16_t length,
+                     at_async_callback_t cb, void *user);
+  bool sendPublish(AT_PublishChannel &channel, const uint8_t *payload, uint16_t length);
+  bool pushPublish(AT_PublishChannel &channel, const uint8_t *payload, uint16_t length,
+                   at_async_callback_t cb, void *user);
+  AsyncTx *loadPublish(AT_PublishChannel &channel, const uint8_t *payload, uint16_t length, bool pipelined);
+
+  /* Payload codecs */
+  const uint8_t *encodePayload(AT_PublishChannel &channel, const uint8_t *payload, uint16_t &length);
+  bool decodePayload(const char *topic, const char *&payload, uint16_t &length);
+
+  /* Telemetry */
+  bool noteSample(bool recorded, const char *topic);
+  bool telemetryReady() const;
+  void telemetryStep();
+
+  /* Pipelined publish */
+  bool pipelinePublish(AT_PublishChannel &channel, const uint8_t *payload, uint16_t length,
+                       at_async_callback_t cb, void *user);
+  void retryPublish(PubSlot &slot, AT_result_t result, int code);
+  bool resendPublish(PubSlot &slot);
+  int32_t allocPubData(uint16_t len) const;
+  PubSlot *oldestPublish(PubState state, int clientId);
+  void finishPublish(PubSlot &slot, AT_result_t result, int code);
+  void publishStep();
+  void waitPublishes();
+  void publishLoaded(const AT_Completion &done);
+  static void onPublishLoaded(const AT_Completion &done, void *user);
 };
 
 #endif /* AT_LIB_H */
@@ -0,0 +1,55 @@
+#ifndef AT_LOG_H
+#define AT_LOG_H
+
+#include <stdint.h>
+
+/* =====================================================
+ * LOG LEVELS
+ * AT_LOG_LEVEL is the compile-time ceiling: calls above it
+ * compile to nothing, format strings included. Set it in
+ * the build flags, e.g. -DAT_LOG_LEVEL=AT_LOG_LEVEL_WARN.
+ * ===================================================== */
+#define AT_LOG_LEVEL_NONE 0
+#define AT_LOG_LEVEL_ERROR 1
+#define AT_LOG_LEVEL_WARN 2
+#define AT_LOG_LEVEL_INFO 3
+#define AT_LOG_LEVEL_DEBUG 4
+#define AT_LOG_LEVEL_TRACE 5 // every modem line in and out
+
+#ifndef AT_LOG_LEVEL
+#define AT_LOG_LEVEL AT_LOG_LEVEL_INFO
+#endif
+
+#ifndef AT_LOG_LINE_MAX
+#define AT_LOG_LINE_MAX 160 // formatted message, longer ones are cut
+#endif
+
+typedef enum
+{
+  AT_LOG_NONE = AT_LOG_LEVEL_NONE,
+  AT_LOG_ERROR = AT_LOG_LEVEL_ERROR,
+  AT_LOG_WARN = AT_LOG_LEVEL_WARN,
+  AT_LOG_INFO = AT_LOG_LEVEL_INFO,
+  AT_LOG_DEBUG = AT_LOG_LEVEL_DEBUG,
+  AT_LOG_TRACE = AT_LOG_LEVEL_TRACE
+} AT_log_level_t;
+
+/* Receives one formatted message, without line ending */
+typedef void (*at_log_sink_t)(AT_log_level_t level, const char *msg, void *user);
+
+/* Used inside AT_Lib members; the runtime level is checked
+ * before any formatting happens */
+#define AT_LOG_AT(level, ...)                                  \
+  do                                                           \
+  {                                                            \
+    if (AT_LOG_LEVEL >= (level) && _logLevel >= (level))       \
+      logPrintf((level), __VA_ARGS__);                         \
+  } while (0)
+
+#define AT_LOGE(...) AT_LOG_AT(AT_LOG_ERROR, __VA_ARGS__)
+#define AT_LOGW(...) AT_LOG_AT(AT_LOG_WARN, __VA_ARGS__)
+#define AT_LOGI(...) AT_LOG_AT(AT_LOG_INFO, __VA_ARGS__)
+#define AT_LOGD(...) AT_LOG_AT(AT_LOG_DEBUG, __VA_ARGS__)
+#define AT_LOGT(...) AT_LOG_AT(AT_LOG_TRACE, __VA_ARGS__)
+
+#endif /* AT_LOG_H */
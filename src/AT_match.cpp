@@ -0,0 +1,79 @@
+#include "AT_match.h"
+#include <string.h>
+
+void AT_Matcher::clear()
+{
+  _nodes[0] = Node();
+  _count = 1;
+  _exact = 0;
+  reset();
+}
+
+bool AT_Matcher::add(const char *pattern, uint8_t bit, bool exact)
+{
+  if (!pattern || !pattern[0] || bit >= 32)
+    return false;
+
+  // Walk the shared part first, so a failed add leaves no nodes
+  uint8_t node = 0;
+  const char *p = pattern;
+  for (; *p; p++)
+  {
+    uint8_t n = _nodes[node].child;
+    while (n && _nodes[n].ch != *p)
+      n = _nodes[n].next;
+    if (!n)
+      break;
+    node = n;
+  }
+  if (strlen(p) > (size_t)(AT_MATCH_NODES - _count))
+    return false;
+
+  for (; *p; p++)
+  {
+    Node &n = _nodes[_count];
+    n = Node();
+    n.ch = *p;
+    n.next = _nodes[node].child;
+    _nodes[node].child = _count;
+    node = _count++;
+  }
+
+  AT_match_mask_t b = (AT_match_mask_t)1 << bit;
+  _nodes[node].mask |= b;
+  if (exact)
+    _exact |= b;
+  else
+    _exact &= ~b;
+  return true;
+}
+
+void AT_Matcher::reset()
+{
+  _state = 0;
+  _hits = 0;
+}
+
+void AT_Matcher::feed(char c)
+{
+  if (_state == DEAD)
+    return;
+
+  uint8_t n = _nodes[_state].child;
+  while (n && _nodes[n].ch != c)
+    n = _nodes[n].next;
+  if (!n)
+  {
+    _state = DEAD;
+    return;
+  }
+  _state = n;
+  _hits |= _nodes[n].mask & ~_exact;
+}
+
+AT_match_mask_t AT_Matcher::matched() const
+{
+  if (_state == DEAD)
+    return _hits;
+  return _hits | (_nodes[_state].mask & _exact);
+}
@@ -0,0 +1,58 @@
+#ifndef AT_MATCH_H
+#define AT_MATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef AT_MATCH_NODES
+#define AT_MATCH_NODES 160 // trie nodes for built-in tokens and onURC() prefixes
+#endif
+
+#if AT_MATCH_NODES > 255
+#error "AT_MATCH_NODES must fit a uint8_t node index"
+#endif
+
+typedef uint32_t AT_match_mask_t; // one bit per pattern
+
+/* =====================================================
+ * STREAMING LINE MATCHER
+ * Trie over the start of a line, advanced one byte at a
+ * time while the line assembles, so the line is never
+ * rescanned. A prefix pattern matches every line that
+ * starts with it, an exact pattern only the whole line.
+ * Siblings are few (one per distinct next character), so
+ * each byte costs a short list walk at most.
+ * ===================================================== */
+class AT_Matcher
+{
+public:
+  AT_Matcher() { clear(); }
+
+  void clear();
+  /* `bit` 0..31 is reported by matched(); false when out of nodes */
+  bool add(const char *pattern, uint8_t bit, bool exact);
+
+  void reset(); // start of a line
+  void feed(char c);
+  AT_match_mask_t matched() const;
+
+private:
+  static const uint8_t DEAD = 0xFF;
+
+  struct Node
+  {
+    AT_match_mask_t mask; // patterns ending here
+    char ch;
+    uint8_t child; // first child, 0 = none (the root is never a child)
+    uint8_t next;  // next sibling, 0 = none
+  };
+
+  Node _nodes[AT_MATCH_NODES];
+  uint8_t _count = 0;
+  AT_match_mask_t _exact = 0; // bits of exact patterns
+
+  uint8_t _state = 0;
+  AT_match_mask_t _hits = 0; // prefix patterns passed on this line
+};
+
+#endif /* AT_MATCH_H */
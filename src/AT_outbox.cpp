@@ -0,0 +1,736 @@
+#include "AT_lib.h"
+
+// CRC-16/CCITT-FALSE, continued from `crc`
+static uint16_t crc16(uint16_t crc, const uint8_t *data, size_t len)
+{
+  while (len--)
+  {
+    crc ^= (uint16_t)*data++ << 8;
+    for (uint8_t i = 0; i < 8; i++)
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+// =====================================================
+// RAM STORAGE
+// =====================================================
+AT_OutboxRamStore::AT_OutboxRamStore(uint8_t *buffer, size_t size, uint8_t segments)
+    : _buf(buffer)
+{
+  if (segments < 2)
+    segments = 2;
+  if (segments > AT_OUTBOX_RAM_SEGMENTS)
+    segments = AT_OUTBOX_RAM_SEGMENTS;
+  _slotCount = segments;
+  _slotSize = size / segments;
+}
+
+AT_OutboxRamStore::Slot *AT_OutboxRamStore::slot(uint32_t segment)
+{
+  for (uint8_t i = 0; i < _slotCount; i++)
+  {
+    if (_slots[i].used && _slots[i].segment == segment)
+      return &_slots[i];
+  }
+  return nullptr;
+}
+
+bool AT_OutboxRamStore::append(uint32_t segment, const uint8_t *data, size_t len)
+{
+  Slot *s = slot(segment);
+  for (uint8_t i = 0; !s && i < _slotCount; i++)
+  {
+    if (!_slots[i].used)
+    {
+      s = &_slots[i];
+      s->used = true;
+      s->segment = segment;
+      s->len = 0;
+    }
+  }
+  if (!s || s->len + len > _slotSize)
+    return false;
+
+  memcpy(_buf + (s - _slots) * _slotSize + s->len, data, len);
+  s->len += len;
+  return true;
+}
+
+size_t AT_OutboxRamStore::read(uint32_t segment, uint32_t offset, uint8_t *out, size_t len)
+{
+  Slot *s = slot(segment);
+  if (!s || offset >= s->len)
+    return 0;
+  if (len > s->len - offset)
+    len = s->len - offset;
+  memcpy(out, _buf + (s - _slots) * _slotSize + offset, len);
+  return len;
+}
+
+uint32_t AT_OutboxRamStore::size(uint32_t segment)
+{
+  Slot *s = slot(segment);
+  return s ? s->len : 0;
+}
+
+void AT_OutboxRamStore::remove(uint32_t segment)
+{
+  if (Slot *s = slot(segment))
+    s->used = false;
+}
+
+bool AT_OutboxRamStore::range(uint32_t &first, uint32_t &last)
+{
+  bool any = false;
+  for (uint8_t i = 0; i < _slotCount; i++)
+  {
+    if (!_slots[i].used)
+      continue;
+    if (!any || _slots[i].segment < first)
+      first = _slots[i].segment;
+    if (!any || _slots[i].segment > last)
+      last = _slots[i].segment;
+    any = true;
+  }
+  return any;
+}
+
+#if AT_OUTBOX_LITTLEFS
+// =====================================================
+// LITTLEFS STORAGE
+// A record is written in pieces and flushed by sync(),
+// so a reset leaves at most one torn record at the end
+// of the newest file.
+// =====================================================
+AT_OutboxLittleFS::AT_OutboxLittleFS(fs::FS &fs, const char *dir, uint32_t segmentSize, uint16_t maxSegments)
+    : _fs(fs), _dir(dir), _segmentSize(segmentSize), _maxSegments(maxSegments < 2 ? 2 : maxSegments) {}
+
+void AT_OutboxLittleFS::path(char *out, size_t len, const char *name) const
+{
+  snprintf(out, len, "%s/%s", _dir, name);
+}
+
+void AT_OutboxLittleFS::segmentPath(char *out, size_t len, uint32_t segment) const
+{
+  snprintf(out, len, "%s/%08lx.seg", _dir, (unsigned long)segment);
+}
+
+void AT_OutboxLittleFS::ensureDir()
+{
+  if (_dirReady)
+    return;
+  if (!_fs.exists(_dir))
+    _fs.mkdir(_dir);
+  _dirReady = true;
+}
+
+bool AT_OutboxLittleFS::append(uint32_t segment, const uint8_t *data, size_t len)
+{
+  if (!_writeFile || _writeSeg != segment)
+  {
+    char p[64];
+    ensureDir();
+    segmentPath(p, sizeof(p), segment);
+    _writeFile.close();
+    _writeFile = _fs.open(p, FILE_APPEND);
+    _writeSeg = segment;
+  }
+  return _writeFile && _writeFile.write(data, len) == len;
+}
+
+void AT_OutboxLittleFS::sync()
+{
+  if (_writeFile)
+    _writeFile.flush();
+}
+
+size_t AT_OutboxLittleFS::read(uint32_t segment, uint32_t offset, uint8_t *out, size_t len)
+{
+  // A handle may not see appends made through another one,
+  // so the segment being written is reopened for every read
+  bool growing = _writeFile && _writeSeg == segment;
+  if (!_readFile || _readSeg != segment || growing)
+  {
+    char p[64];
+    segmentPath(p, sizeof(p), segment);
+    _readFile.close();
+    _readFile = _fs.open(p, FILE_READ);
+    _readSeg = segment;
+  }
+  if (!_readFile || !_readFile.seek(offset))
+    return 0;
+  int n = _readFile.read(out, len);
+  return n > 0 ? n : 0;
+}
+
+uint32_t AT_OutboxLittleFS::size(uint32_t segment)
+{
+  if (_writeFile && _writeSeg == segment)
+    return _writeFile.size();
+
+  char p[64];
+  segmentPath(p, sizeof(p), segment);
+  File f = _fs.open(p, FILE_READ);
+  return f ? f.size() : 0;
+}
+
+void AT_OutboxLittleFS::remove(uint32_t segment)
+{
+  if (_writeFile && _writeSeg == segment)
+    _writeFile.close();
+  if (_readFile && _readSeg == segment)
+    _readFile.close();
+
+  char p[64];
+  segmentPath(p, sizeof(p), segment);
+  _fs.remove(p);
+}
+
+bool AT_OutboxLittleFS::range(uint32_t &first, uint32_t &last)
+{
+  ensureDir();
+  File dir = _fs.open(_dir);
+  if (!dir || !dir.isDirectory())
+    return false;
+
+  bool any = false;
+  for (File f = dir.openNextFile(); f; f = dir.openNextFile())
+  {
+    // Older cores report the full path
+    const char *name = f.name();
+    const char *slash = strrchr(name, '/');
+    if (slash)
+      name = slash + 1;
+
+    char *end;
+    uint32_t seg = strtoul(name, &end, 16);
+    if (end == name || strcmp(end, ".seg") != 0)
+      continue;
+    if (!any || seg < first)
+      first = seg;
+    if (!any || seg > last)
+      last = seg;
+    any = true;
+  }
+  return any;
+}
+
+bool AT_OutboxLittleFS::saveCursor(uint32_t seq)
+{
+  char p[64];
+  ensureDir();
+  path(p, sizeof(p), "cursor");
+  File f = _fs.open(p, FILE_WRITE);
+  uint8_t raw[4] = {(uint8_t)seq, (uint8_t)(seq >> 8), (uint8_t)(seq >> 16), (uint8_t)(seq >> 24)};
+  return f && f.write(raw, 4) == 4;
+}
+
+uint32_t AT_OutboxLittleFS::loadCursor()
+{
+  char p[64];
+  path(p, sizeof(p), "cursor");
+  File f = _fs.open(p, FILE_READ);
+  uint8_t raw[4];
+  if (!f || f.read(raw, 4) != 4)
+    return 0;
+  return raw[0] | (uint32_t)raw[1] << 8 | (uint32_t)raw[2] << 16 | (uint32_t)raw[3] << 24;
+}
+#endif /* AT_OUTBOX_LITTLEFS */
+
+// =====================================================
+// RECORDS
+// =====================================================
+AT_Outbox::AT_Outbox(AT_OutboxStorage &storage, AT_outbox_policy_t policy)
+    : _store(storage), _policy(policy) {}
+
+void AT_Outbox::encodeHeader(const Header &h, uint8_t *out)
+{
+  out[0] = h.type;
+  out[1] = h.client << 4 | h.retain << 3 | h.qos;
+  out[2] = h.topicLen;
+  out[3] = h.payloadLen;
+  out[4] = h.payloadLen >> 8;
+  out[5] = h.seq;
+  out[6] = h.seq >> 8;
+  out[7] = h.seq >> 16;
+  out[8] = h.seq >> 24;
+  out[9] = h.crc;
+  out[10] = h.crc >> 8;
+}
+
+// False past the last whole record of the segment
+bool AT_Outbox::readHeader(uint32_t segment, uint32_t offset, uint32_t segmentLen, Header &h)
+{
+  uint8_t raw[AT_OUTBOX_HEADER_LEN];
+  if (offset + AT_OUTBOX_HEADER_LEN > segmentLen ||
+      _store.read(segment, offset, raw, AT_OUTBOX_HEADER_LEN) != AT_OUTBOX_HEADER_LEN)
+    return false;
+
+  h.type = raw[0];
+  h.client = raw[1] >> 4;
+  h.qos = raw[1] & 0x03;
+  h.retain = raw[1] & 0x08;
+  h.topicLen = raw[2];
+  h.payloadLen = raw[3] | raw[4] << 8;
+  h.seq = raw[5] | (uint32_t)raw[6] << 8 | (uint32_t)raw[7] << 16 | (uint32_t)raw[8] << 24;
+  h.crc = raw[9] | raw[10] << 8;
+
+  return h.type == AT_OUTBOX_REC_PUBLISH && h.topicLen && h.topicLen <= AT_OUTBOX_TOPIC_MAX &&
+         h.payloadLen <= AT_OUTBOX_PAYLOAD_MAX && offset + h.size() <= segmentLen;
+}
+
+// =====================================================
+// RECOVERY
+// Unsent records are the ones past the saved cursor. A
+// torn record at the end of the newest segment is left
+// there, and appends move on to a fresh segment.
+// =====================================================
+bool AT_Outbox::begin()
+{
+  _peeked = false;
+  _depth = _bytes = 0;
+  _unsaved = 0;
+  _sentSeq = _store.loadCursor();
+  uint32_t maxSeq = _sentSeq;
+  bool found = false;
+
+  _hasSegments = _store.range(_first, _last);
+  if (_hasSegments)
+  {
+    for (uint32_t seg = _first;; seg++)
+    {
+      uint32_t len = _store.size(seg);
+      uint32_t off = 0;
+      Header h;
+      while (readHeader(seg, off, len, h))
+      {
+        if (h.seq > maxSeq)
+          maxSeq = h.seq;
+        if (h.seq > _sentSeq)
+        {
+          if (!found)
+          {
+            _readSeg = seg;
+            _readOff = off;
+            found = true;
+          }
+          _depth++;
+        }
+        off += h.size();
+      }
+      _bytes += len;
+
+      if (seg == _last)
+      {
+        _lastLen = len;
+        _lastSealed = off != len;
+        break;
+      }
+    }
+  }
+
+  if (!found)
+  {
+    _readSeg = _last;
+    _readOff = _lastLen;
+  }
+  _nextSeq = maxSeq + 1;
+  removeSent();
+  return true;
+}
+
+// =====================================================
+// STORE
+// =====================================================
+bool AT_Outbox::openSegment()
+{
+  if (_hasSegments && _last - _first + 1 >= _store.maxSegments())
+  {
+    if (_policy == AT_OUTBOX_DROP_NEWEST || _first == _last)
+      return false;
+    evictOldest();
+  }
+
+  uint32_t seg = _last + 1;
+  if (!_hasSegments)
+  {
+    _first = seg;
+    _readSeg = seg;
+    _readOff = 0;
+    _hasSegments = true;
+  }
+  _last = seg;
+  _lastLen = 0;
+  _lastSealed = false;
+  return true;
+}
+
+void AT_Outbox::evictOldest()
+{
+  uint32_t seg = _first;
+  uint32_t len = _store.size(seg);
+  uint32_t off = 0;
+  uint32_t lost = 0;
+  Header h;
+  while (readHeader(seg, off, len, h))
+  {
+    if (h.seq > _sentSeq)
+      lost++;
+    off += h.size();
+  }
+
+  _store.remove(seg);
+  _first++;
+  _bytes -= len < _bytes ? len : _bytes;
+  _depth -= lost < _depth ? lost : _depth;
+  _dropped += lost;
+
+  if (_readSeg <= seg)
+  {
+    _readSeg = _first;
+    _readOff = 0;
+    _peeked = false;
+  }
+}
+
+bool AT_Outbox::push(uint8_t client, const char *topic, const uint8_t *payload, uint16_t length, uint8_t qos,
+                     bool retain)
+{
+  size_t topicLen = topic ? strlen(topic) : 0;
+  if (!topicLen || topicLen > AT_OUTBOX_TOPIC_MAX || !payload || !length ||
+      length > AT_OUTBOX_PAYLOAD_MAX || client > 0x0F || qos > 2)
+    return false;
+
+  Header h = {AT_OUTBOX_REC_PUBLISH, client, qos, retain, (uint8_t)topicLen, length, _nextSeq, 0};
+  uint32_t size = h.size();
+  if (size > _store.segmentSize())
+    return false;
+
+  if (!_hasSegments || _lastSealed || _lastLen + size > _store.segmentSize())
+  {
+    if (!openSegment())
+    {
+      _dropped++;
+      return false;
+    }
+  }
+
+  uint8_t raw[AT_OUTBOX_HEADER_LEN];
+  encodeHeader(h, raw);
+  uint16_t crc = crc16(0xFFFF, raw, AT_OUTBOX_HEADER_LEN - 2);
+  crc = crc16(crc, (const uint8_t *)topic, topicLen);
+  h.crc = crc16(crc, payload, length);
+  encodeHeader(h, raw);
+
+  bool ok = _store.append(_last, raw, sizeof(raw)) &&
+            _store.append(_last, (const uint8_t *)topic, topicLen) &&
+            _store.append(_last, payload, length);
+  _store.sync();
+  if (!ok)
+  {
+    // Whatever made it in is a torn record; it ends this segment
+    _lastLen = _store.size(_last);
+    _lastSealed = true;
+    _dropped++;
+    return false;
+  }
+
+  _lastLen += size;
+  _bytes += size;
+  _nextSeq++;
+  _depth++;
+  return true;
+}
+
+// =====================================================
+// DRAIN
+// =====================================================
+bool AT_Outbox::peek(AT_OutboxMessage &out)
+{
+  if (_peeked)
+  {
+    out = _msg;
+    return true;
+  }
+
+  while (_depth)
+  {
+    uint32_t len = _store.size(_readSeg);
+    Header h;
+    if (!readHeader(_readSeg, _readOff, len, h))
+    {
+      if (_readSeg >= _last)
+      {
+        // Counted records that are no longer readable
+        _depth = 0;
+        break;
+      }
+      _readSeg++;
+      _readOff = 0;
+      removeSent();
+      continue;
+    }
+
+    uint8_t raw[AT_OUTBOX_HEADER_LEN];
+    uint8_t *topic = _buf;
+    uint8_t *payload = _buf + h.topicLen + 1;
+    uint16_t crc = h.crc;
+    h.crc = 0;
+    encodeHeader(h, raw);
+    bool intact = h.seq > _sentSeq &&
+                  _store.read(_readSeg, _readOff + AT_OUTBOX_HEADER_LEN, topic, h.topicLen) == h.topicLen &&
+                  _store.read(_readSeg, _readOff + AT_OUTBOX_HEADER_LEN + h.topicLen, payload,
+                              h.payloadLen) == h.payloadLen &&
+                  crc16(crc16(crc16(0xFFFF, raw, AT_OUTBOX_HEADER_LEN - 2), topic, h.topicLen), payload,
+                        h.payloadLen) == crc;
+    if (!intact)
+    {
+      if (h.seq > _sentSeq)
+      {
+        _depth--;
+        _dropped++;
+      }
+      _readOff += h.size();
+      continue;
+    }
+
+    topic[h.topicLen] = '\0';
+    _msg.client = h.client;
+    _msg.qos = h.qos;
+    _msg.retain = h.retain;
+    _msg.topic = (const char *)topic;
+    _msg.payload = payload;
+    _msg.length = h.payloadLen;
+    _msg.seq = h.seq;
+    _peekSize = h.size();
+    _peeked = true;
+    out = _msg;
+    return true;
+  }
+
+  removeSent();
+  return false;
+}
+
+void AT_Outbox::pop()
+{
+  if (!_peeked)
+    return;
+  _peeked = false;
+
+  _sentSeq = _msg.seq;
+  _readOff += _peekSize;
+  if (_depth)
+    _depth--;
+  if (++_unsaved >= AT_OUTBOX_CURSOR_EVERY)
+    saveCursor();
+  removeSent();
+}
+
+void AT_Outbox::saveCursor()
+{
+  _store.saveCursor(_sentSeq);
+  _unsaved = 0;
+}
+
+// Deletes segments the drain has moved past, and all of
+// them once nothing is left to send. Finishing a segment
+// also saves the cursor.
+void AT_Outbox::removeSent()
+{
+  if (!_hasSegments)
+    return;
+
+  if (!_depth)
+  {
+    if (_unsaved)
+      saveCursor();
+    for (uint32_t seg = _first; seg - _first <= _last - _first; seg++)
+      _store.remove(seg);
+    _hasSegments = false;
+    _bytes = 0;
+    _lastLen = 0;
+    _lastSealed = false;
+    _readSeg = _last;
+    _readOff = 0;
+    _peeked = false;
+    return;
+  }
+
+  if (_first < _readSeg && _unsaved)
+    saveCursor();
+  while (_first < _readSeg)
+  {
+    uint32_t len = _store.size(_first);
+    _store.remove(_first);
+    _bytes -= len < _bytes ? len : _bytes;
+    _first++;
+  }
+}
+
+void AT_Outbox::clear()
+{
+  _depth = 0;
+  removeSent();
+  _sentSeq = _nextSeq - 1;
+  saveCursor();
+}
+
+// =====================================================
+// AT_LIB STORE AND FORWARD
+// Stored publishes go out through the async queue, one
+// at a time, paced by the drain rate and only into an
+// empty queue. A record leaves the outbox once the
+// broker took it, or was refused with the link still up
+// (it would hold back every record behind it).
+// =====================================================
+void AT_Lib::setOutbox(AT_Outbox *outbox, uint16_t perSecond)
+{
+  AT_GUARD();
+  _outbox = outbox;
+  _outboxRate = perSecond;
+  _outboxDropBase = outbox ? outbox->dropped() : 0;
+#if AT_RTOS
+  if (_readerTask)
+    wakeReader();
+#endif
+}
+
+bool AT_Lib::outboxWanted(uint8_t clientId)
+{
+  return _outbox && clientId < AT_MQTT_CLIENTS && _mqtt[clientId].state < MQTT_STATE_CONNECTED;
+}
+
+bool AT_Lib::outboxStore(const AT_PublishChannel &channel, const uint8_t *payload, uint16_t length)
+{
+  bool ok = _outbox->push(channel._client, channel._topic, payload, length, channel._qos, channel._retain);
+  if (ok)
+    _stats.outboxStored++;
+  else
+    AT_LOGW("[OUTBOX] Publish to %s not stored", channel._topic);
+  noteOutboxDrops();
+  return ok;
+}
+
+void AT_Lib::noteOutboxDrops()
+{
+  uint32_t dropped = _outbox->dropped();
+  if (dropped == _outboxDropBase)
+    return;
+  AT_LOGW("[OUTBOX] %lu stored publishes lost", (unsigned long)(dropped - _outboxDropBase));
+  _stats.outboxDropped += dropped - _outboxDropBase;
+  _outboxDropBase = dropped;
+}
+
+void AT_Lib::outboxStep()
+{
+  if (!_outbox)
+    return;
+
+  uint32_t now = millis();
+  if (_outboxWindowOpen && now - _outboxWindowAt >= AT_OUTBOX_RATE_WINDOW)
+    closeOutboxWindow();
+
+  if (_outboxBusy || _asyncCount || !_outbox->depth())
+    return;
+  if (_outboxRate && (int32_t)(now - _outboxNextAt) < 0)
+    return;
+
+  AT_OutboxMessage m;
+  bool found = _outbox->peek(m);
+  noteOutboxDrops();
+  if (!found)
+    return;
+
+  // Held until the client is back with its subscriptions
+  if (m.client >= AT_MQTT_CLIENTS)
+  {
+    _outbox->pop();
+    _stats.outboxDropped++;
+    return;
+  }
+  const MqttClient &c = _mqtt[m.client];
+  if (c.state < MQTT_STATE_CONNECTED || (c.supervised && c.supResubscribe))
+    return;
+
+  AT_PublishChannel channel;
+  if (!prepareChannel(channel, m.client, m.topic, strlen(m.topic), m.qos, m.retain, 0))
+  {
+    _outbox->pop();
+    _stats.outboxDropped++;
+    return;
+  }
+  if (!pushPublish(channel, m.payload, m.length, onOutboxSent, this))
+    return;
+  _outboxBusy = true;
+  _outboxSeq = m.seq;
+  if (!_outboxWindowOpen)
+  {
+    _outboxWindowOpen = true;
+    _outboxWindowAt = now;
+    _outboxWindowSent = 0;
+  }
+  if (_outboxRate)
+    _outboxNextAt = now + 1000 / _outboxRate;
+}
+
+// The drain rate is measured from the first send of a
+// backlog, over AT_OUTBOX_RATE_WINDOW or until it is empty
+void AT_Lib::closeOutboxWindow()
+{
+  uint32_t ms = millis() - _outboxWindowAt;
+  _stats.outboxDrainRate = (uint64_t)_outboxWindowSent * 60000 / (ms ? ms : 1);
+  _outboxWindowOpen = false;
+}
+
+#if AT_RTOS
+// Time until outboxStep() may send, for the reader's sleep;
+// a client coming back is seen by the reader itself
+uint32_t AT_Lib::outboxWaitMs() const
+{
+  if (!_outbox || _outboxBusy || _asyncCount || !_outbox->depth())
+    return UINT32_MAX;
+
+  bool up = false;
+  for (uint8_t i = 0; i < AT_MQTT_CLIENTS; i++)
+    up |= _mqtt[i].state >= MQTT_STATE_CONNECTED;
+  if (!up)
+    return UINT32_MAX;
+
+  int32_t left = (int32_t)(_outboxNextAt - millis());
+  return left > 0 ? left : 1;
+}
+#endif
+
+void AT_Lib::onOutboxSent(const AT_Completion &done, void *user)
+{
+  ((AT_Lib *)user)->outboxDone(done);
+}
+
+void AT_Lib::outboxDone(const AT_Completion &done)
+{
+  _outboxBusy = false;
+  AT_OutboxMessage m;
+  // Evicted while in flight when the seq no longer matches
+  if (!_outbox || !_outbox->peek(m) || m.seq != _outboxSeq)
+    return;
+
+  if (done.ok)
+  {
+    _outbox->pop();
+    _stats.outboxSent++;
+    _outboxWindowSent++;
+    if (!_outbox->depth())
+      closeOutboxWindow();
+    return;
+  }
+
+  // Link trouble: sent again once the client is back
+  if (done.result == AT_RESULT_TIMEOUT || _mqtt[m.client].state < MQTT_STATE_CONNECTED)
+    return;
+
+  AT_LOGW("[OUTBOX] Publish to %s refused (%d), dropped", m.topic, done.code);
+  _outbox->pop();
+  _stats.outboxDropped++;
+}
@@ -0,0 +1,274 @@
+#ifndef AT_OUTBOX_H
+#define AT_OUTBOX_H
+
+#include <Arduino.h>
+
+#ifndef AT_OUTBOX_LITTLEFS
+#if defined(ARDUINO_ARCH_ESP32)
+#define AT_OUTBOX_LITTLEFS 1 // AT_OutboxLittleFS, segment files on a mounted LittleFS
+#else
+#define AT_OUTBOX_LITTLEFS 0
+#endif
+#endif
+
+#ifndef AT_OUTBOX_TOPIC_MAX
+#define AT_OUTBOX_TOPIC_MAX 128 // same limits as a direct publish
+#endif
+
+#ifndef AT_OUTBOX_PAYLOAD_MAX
+#define AT_OUTBOX_PAYLOAD_MAX 1024
+#endif
+
+#ifndef AT_OUTBOX_SEGMENT
+#define AT_OUTBOX_SEGMENT 4096 // bytes per segment file before the next one starts
+#endif
+
+#ifndef AT_OUTBOX_SEGMENTS
+#define AT_OUTBOX_SEGMENTS 16 // segment files kept; the bound is about SEGMENT * SEGMENTS
+#endif
+
+#ifndef AT_OUTBOX_CURSOR_EVERY
+#define AT_OUTBOX_CURSOR_EVERY 16 // records sent between cursor saves; a reset re-sends at most this many
+#endif
+
+#ifndef AT_OUTBOX_RAM_SEGMENTS
+#define AT_OUTBOX_RAM_SEGMENTS 8 // most slots an AT_OutboxRamStore splits its buffer into
+#endif
+
+/* =====================================================
+ * OUTBOX FORMAT
+ * Segment: records back to back, never rewritten
+ * Record:  <type> <client<<4 | retain<<3 | qos> <topic_len> <payload_len u16>
+ *          <seq u32> <crc16> <topic> <payload>
+ *   type   AT_OUTBOX_REC_PUBLISH
+ *   seq    1, 2, ... across segments, in publish order
+ *   crc16  CCITT over the header before it, topic and payload
+ * Numbers are little endian. Delivery is kept apart from
+ * the log as the seq of the last record sent (the cursor),
+ * and a segment is deleted once every record in it is sent.
+ * The cursor is saved every AT_OUTBOX_CURSOR_EVERY records
+ * and when a segment is deleted, so a reset sends the
+ * records after the last save again.
+ * ===================================================== */
+#define AT_OUTBOX_REC_PUBLISH 0xA5
+#define AT_OUTBOX_HEADER_LEN 11
+
+/* What push() does when the storage is full */
+typedef enum
+{
+  AT_OUTBOX_DROP_OLDEST = 0, /**< Delete the oldest segment, unsent records and all */
+  AT_OUTBOX_DROP_NEWEST      /**< Refuse the new record */
+} AT_outbox_policy_t;
+
+/* =====================================================
+ * OUTBOX STORAGE
+ * Numbered append-only segments. Implementations only
+ * move bytes; the record format lives in AT_Outbox.
+ * ===================================================== */
+class AT_OutboxStorage
+{
+public:
+  virtual ~AT_OutboxStorage() {}
+
+  virtual bool append(uint32_t segment, const uint8_t *data, size_t len) = 0;
+  /* Called once a whole record is appended */
+  virtual void sync() {}
+  virtual size_t read(uint32_t segment, uint32_t offset, uint8_t *out, size_t len) = 0;
+  virtual uint32_t size(uint32_t segment) = 0; // 0 when missing
+  virtual void remove(uint32_t segment) = 0;
+  /* Lowest and highest segment present; false when there is none */
+  virtual bool range(uint32_t &first, uint32_t &last) = 0;
+
+  virtual bool saveCursor(uint32_t seq) = 0;
+  virtual uint32_t loadCursor() = 0; // 0 when never saved
+
+  virtual uint32_t segmentSize() const = 0;
+  virtual uint16_t maxSegments() const = 0;
+};
+
+/* =====================================================
+ * RAM STORAGE
+ * Fallback without a filesystem: rides out an outage,
+ * not a reset. The buffer is split into equal slots,
+ * one per segment.
+ * ===================================================== */
+class AT_OutboxRamStore : public AT_OutboxStorage
+{
+public:
+  AT_OutboxRamStore(uint8_t *buffer, size_t size, uint8_t segments = 4);
+
+  bool append(uint32_t segment, const uint8_t *data, size_t len) override;
+  size_t read(uint32_t segment, uint32_t offset, uint8_t *out, size_t len) override;
+  uint32_t size(uint32_t segment) override;
+  void remove(uint32_t segment) override;
+  bool range(uint32_t &first, uint32_t &last) override;
+  bool saveCursor(uint32_t seq) override
+  {
+    _cursor = seq;
+    return true;
+  }
+  uint32_t loadCursor() override { return _cursor; }
+  uint32_t segmentSize() const override { return _slotSize; }
+  uint16_t maxSegments() const override { return _slotCount; }
+
+private:
+  struct Slot
+  {
+    uint32_t segment;
+    uint32_t len;
+    bool used;
+  };
+  Slot *slot(uint32_t segment);
+
+  uint8_t *_buf;
+  uint32_t _slotSize;
+  uint8_t _slotCount;
+  Slot _slots[AT_OUTBOX_RAM_SEGMENTS] = {};
+  uint32_t _cursor = 0;
+};
+
+/* RAM storage with its own buffer */
+template <size_t N, uint8_t SEGMENTS = 4>
+class AT_OutboxRam : public AT_OutboxRamStore
+{
+public:
+  AT_OutboxRam() : AT_OutboxRamStore(_storage, N, SEGMENTS) {}
+
+private:
+  uint8_t _storage[N];
+};
+
+#if AT_OUTBOX_LITTLEFS
+#include <FS.h>
+#include <LittleFS.h>
+
+/* =====================================================
+ * LITTLEFS STORAGE
+ * One file per segment, <dir>/<segment, 8 hex>.seg, and
+ * the cursor in <dir>/cursor. Mount the filesystem
+ * (LittleFS.begin()) before AT_Outbox::begin().
+ * ===================================================== */
+class AT_OutboxLittleFS : public AT_OutboxStorage
+{
+public:
+  explicit AT_OutboxLittleFS(fs::FS &fs = LittleFS, const char *dir = "/outbox",
+                             uint32_t segmentSize = AT_OUTBOX_SEGMENT, uint16_t maxSegments = AT_OUTBOX_SEGMENTS);
+
+  bool append(uint32_t segment, const uint8_t *data, size_t len) override;
+  void sync() override;
+  size_t read(uint32_t segment, uint32_t offset, uint8_t *out, size_t len) override;
+  uint32_t size(uint32_t segment) override;
+  void remove(uint32_t segment) override;
+  bool range(uint32_t &first, uint32_t &last) override;
+  bool saveCursor(uint32_t seq) override;
+  uint32_t loadCursor() override;
+  uint32_t segmentSize() const override { return _segmentSize; }
+  uint16_t maxSegments() const override { return _maxSegments; }
+
+private:
+  void path(char *out, size_t len, const char *name) const;
+  void segmentPath(char *out, size_t len, uint32_t segment) const;
+  void ensureDir();
+
+  fs::FS &_fs;
+  const char *_dir;
+  uint32_t _segmentSize;
+  uint16_t _maxSegments;
+  bool _dirReady = false;
+
+  /* Kept open between calls: appends go to the newest
+   * segment and the drain reads the oldest one */
+  File _writeFile;
+  uint32_t _writeSeg = 0;
+  File _readFile;
+  uint32_t _readSeg = 0;
+};
+#endif /* AT_OUTBOX_LITTLEFS */
+
+/* One stored publish; pointers stay valid until the next peek() */
+typedef struct
+{
+  uint8_t client;
+  uint8_t qos;
+  bool retain;
+  const char *topic;
+  const uint8_t *payload;
+  uint16_t length;
+  uint32_t seq;
+} AT_OutboxMessage;
+
+/* =====================================================
+ * OUTBOX
+ * Publishes kept while the link is down, oldest first.
+ * Attach with AT_Lib::setOutbox(); the library stores
+ * into it and drains it from poll().
+ * ===================================================== */
+class AT_Outbox
+{
+public:
+  explicit AT_Outbox(AT_OutboxStorage &storage, AT_outbox_policy_t policy = AT_OUTBOX_DROP_OLDEST);
+
+  /* Scans the storage for records left unsent before a reset */
+  bool begin();
+
+  bool push(uint8_t client, const char *topic, const uint8_t *payload, uint16_t length, uint8_t qos,
+            bool retain = false);
+  /* Oldest unsent record; the same one until pop() */
+  bool peek(AT_OutboxMessage &out);
+  /* The peeked record was delivered */
+  void pop();
+  void clear();
+
+  uint32_t depth() const { return _depth; } // records not yet sent
+  uint32_t bytes() const { return _bytes; } // storage used, sent records included
+  uint32_t dropped() const { return _dropped; } // lost to the bound or found corrupt
+  uint32_t capacity() const { return (uint32_t)_store.segmentSize() * _store.maxSegments(); }
+
+private:
+  struct Header
+  {
+    uint8_t type;
+    uint8_t client;
+    uint8_t qos;
+    bool retain;
+    uint8_t topicLen;
+    uint16_t payloadLen;
+    uint32_t seq;
+    uint16_t crc;
+    uint32_t size() const { return AT_OUTBOX_HEADER_LEN + topicLen + payloadLen; }
+  };
+
+  bool readHeader(uint32_t segment, uint32_t offset, uint32_t segmentLen, Header &h);
+  static void encodeHeader(const Header &h, uint8_t *out);
+  bool openSegment();
+  void evictOldest();
+  void removeSent();
+  void saveCursor();
+
+  AT_OutboxStorage &_store;
+  AT_outbox_policy_t _policy;
+
+  bool _hasSegments = false;
+  uint32_t _first = 0; // oldest segment
+  uint32_t _last = 0;  // newest segment, the one appended to
+  uint32_t _lastLen = 0;
+  bool _lastSealed = false; // ends in a torn record, append to a new one
+
+  uint32_t _readSeg = 0; // next record to send
+  uint32_t _readOff = 0;
+  uint32_t _sentSeq = 0;
+  uint32_t _nextSeq = 1;
+  uint16_t _unsaved = 0; // records sent since the cursor was saved
+
+  bool _peeked = false;
+  AT_OutboxMessage _msg = {};
+  uint32_t _peekSize = 0;
+
+  uint32_t _depth = 0;
+  uint32_t _bytes = 0;
+  uint32_t _dropped = 0;
+
+  uint8_t _buf[AT_OUTBOX_TOPIC_MAX + 1 + AT_OUTBOX_PAYLOAD_MAX];
+};
+
+#endif /* AT_OUTBOX_H */
@@ -0,0 +1,402 @@
+#include "AT_lib.h"
+#include "Sim76xx_mqtt_errors.h"
+
+// =====================================================
+// PUBLISH CHANNELS
+// mqttPublish() and mqttPublishAsync() go through a
+// channel prepared on the stack; openChannel() keeps one
+// for the caller, so the checks and the TOPIC / PUB lines
+// are not redone per message.
+// =====================================================
+bool AT_Lib::openChannel(AT_PublishChannel &channel, uint8_t clientId, const char *topic, uint8_t qos,
+                         bool retain, uint32_t timeout)
+{
+  AT_GUARD();
+  channel.close();
+  return prepareChannel(channel, clientId, topic, topic ? strlen(topic) : 0, qos, retain, timeout);
+}
+
+bool AT_Lib::publish(AT_PublishChannel &channel, const uint8_t *payload, uint16_t length)
+{
+  AT_GUARD();
+  if (!channel.isOpen())
+  {
+    AT_LOGW("[MQTT] Publish on a channel not open");
+    return false;
+  }
+  return publishNow(channel, payload, length);
+}
+
+bool AT_Lib::publishAsync(AT_PublishChannel &channel, const uint8_t *payload, uint16_t length,
+                          at_async_callback_t cb, void *user)
+{
+  AT_GUARD();
+  if (!channel.isOpen())
+  {
+    AT_LOGW("[MQTT] Publish on a channel not open");
+    return false;
+  }
+  return publishQueued(channel, payload, length, cb, user);
+}
+
+// `topic` need not be NUL-terminated: resends pass their copy
+bool AT_Lib::prepareChannel(AT_PublishChannel &channel, uint8_t clientId, const char *topic, uint16_t topicLen,
+                            uint8_t qos, bool retain, uint32_t timeout)
+{
+  if (topicLen == 0 || topicLen > AT_PublishChannel::TOPIC_MAX)
+  {
+    AT_LOGW("[MQTT] Invalid topic");
+    return false;
+  }
+  if (qos > 2)
+  {
+    AT_LOGW("[MQTT] Invalid QoS %u", qos);
+    return false;
+  }
+
+  const AT_Arg topicArgs[] = {clientId, topicLen};
+  const AT_Arg pubArgs[] = {clientId, qos, AT_MQTT_PUB_TIMEOUT, 1};
+  const AT_Arg payloadArgs[] = {clientId, 0};
+  size_t prefix = AT_formatCommand(channel._payloadLine, sizeof(channel._payloadLine), AT_Cmd::MQTT_PAYLOAD,
+                                   payloadArgs, 2);
+  if (!AT_formatCommand(channel._topicLine, sizeof(channel._topicLine), AT_Cmd::MQTT_TOPIC, topicArgs, 2) ||
+      !AT_formatCommand(channel._pubLine, sizeof(channel._pubLine),
+                        retain ? AT_Cmd::MQTT_PUBLISH_RETAINED : AT_Cmd::MQTT_PUBLISH, pubArgs, retain ? 4 : 3) ||
+      !prefix)
+  {
+    AT_LOGE("[MQTT] Publish lines for client %u too long", clientId);
+    return false;
+  }
+
+  memcpy(channel._topic, topic, topicLen);
+  channel._topic[topicLen] = '\0';
+  channel._topicLen = topicLen;
+  channel._client = clientId;
+  channel._qos = qos;
+  channel._retain = retain;
+  channel._timeout = timeout;
+  channel._codecVersion = 0; // looked up at the first publish
+  channel._payloadPrefix = prefix - 1; // the length placeholder "0"
+  return true;
+}
+
+// The payload length goes after the prebuilt prefix
+const char *AT_PublishChannel::payloadLine(uint16_t length)
+{
+  char digits[5];
+  uint8_t n = 0;
+  do
+  {
+    digits[n++] = '0' + length % 10;
+    length /= 10;
+  } while (length);
+
+  char *p = _payloadLine + _payloadPrefix;
+  while (n)
+    *p++ = digits[--n];
+  *p = '\0';
+  return _payloadLine;
+}
+
+// =====================================================
+// PIPELINED PUBLISH
+// Each publish still goes out as TOPIC, PAYLOAD, PUB in
+// the async queue, but PUB completes at its OK:
+//   QUEUED → (OK) → SENT → (+CMQTTPUB:) → DONE → callback
+// so the next publish is loaded while the broker answers
+// the previous ones. +CMQTTPUB: <client>,<err> carries no
+// message id; results are matched per client in the order
+// the publishes were sent. Timed-out publishes whose data
+// fit the retry copy go round again as RESEND.
+// =====================================================
+// The modem gives up after <pub_timeout>; past that and the
+// command timeout on top, no result is coming
+static uint32_t resultWaitMs(uint32_t timeout)
+{
+  return (uint32_t)AT_MQTT_PUB_TIMEOUT * 1000 + (timeout ? timeout : AT_Cmd::MQTT_PUBLISH.timeout);
+}
+
+bool AT_Lib::setPublishWindow(uint8_t window, uint8_t retries)
+{
+  AT_GUARD();
+  if (window == 0 || window > AT_MQTT_PUB_WINDOW_MAX)
+  {
+    AT_LOGW("[MQTT] Publish window must be 1..%u", AT_MQTT_PUB_WINDOW_MAX);
+    return false;
+  }
+  if (publishesInFlight())
+  {
+    AT_LOGW("[MQTT] Publish window not changed with publishes in flight");
+    return false;
+  }
+  _pubWindow = window;
+  _pubRetries = retries;
+  return true;
+}
+
+uint8_t AT_Lib::publishesInFlight() const
+{
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < AT_MQTT_PUB_WINDOW_MAX; i++)
+    if (_pub[i].state != PUB_FREE)
+      n++;
+  return n;
+}
+
+bool AT_Lib::pipelinePublish(AT_PublishChannel &channel, const uint8_t *payload, uint16_t length,
+                             at_async_callback_t cb, void *user)
+{
+  PubSlot *slot = nullptr;
+  for (uint8_t i = 0; i < AT_MQTT_PUB_WINDOW_MAX && !slot; i++)
+    if (_pub[i].state == PUB_FREE)
+      slot = &_pub[i];
+  if (!slot || publishesInFlight() >= _pubWindow)
+  {
+    AT_LOGW("[MQTT] Publish window full");
+    return false;
+  }
+
+  AsyncTx *pub = loadPublish(channel, payload, length, true);
+  if (!pub)
+    return false;
+  pub->cb = onPublishLoaded;
+  pub->user = this;
+
+  uint16_t topicLen = channel._topicLen;
+  slot->dataOff = _pubRetries ? allocPubData(topicLen + length) : -1;
+  if (slot->dataOff >= 0)
+  {
+    memcpy(_pubData + slot->dataOff, channel._topic, topicLen);
+    memcpy(_pubData + slot->dataOff + topicLen, payload, length);
+  }
+  slot->state = PUB_QUEUED;
+  slot->client = channel._client;
+  slot->qos = channel._qos;
+  slot->retain = channel._retain;
+  slot->retries = 0;
+  slot->order = _pubOrder++;
+  slot->timeout = channel._timeout;
+  slot->cb = cb;
+  slot->user = user;
+  slot->topicLen = topicLen;
+  slot->payloadLen = length;
+  return true;
+}
+
+// First fit between the copies of the slots in use; -1 when
+// the publish can go out but not be sent again
+int32_t AT_Lib::allocPubData(uint16_t len) const
+{
+  int32_t at = 0;
+  for (;;)
+  {
+    if (at + len > AT_MQTT_PUB_RETRY_DATA)
+      return -1;
+
+    int32_t next = -1;
+    for (uint8_t i = 0; i < AT_MQTT_PUB_WINDOW_MAX; i++)
+    {
+      const PubSlot &s = _pub[i];
+      if (s.state == PUB_FREE || s.dataOff < 0)
+        continue;
+      int32_t end = s.dataOff + s.topicLen + s.payloadLen;
+      if (s.dataOff < at + len && end > at && end > next)
+        next = end;
+    }
+    if (next < 0)
+      return at;
+    at = next;
+  }
+}
+
+// Oldest slot in `state`, of `clientId` unless it is -1
+AT_Lib::PubSlot *AT_Lib::oldestPublish(PubState state, int clientId)
+{
+  PubSlot *oldest = nullptr;
+  for (uint8_t i = 0; i < AT_MQTT_PUB_WINDOW_MAX; i++)
+  {
+    PubSlot &s = _pub[i];
+    if (s.state != state || (clientId >= 0 && s.client != clientId))
+      continue;
+    if (!oldest || (int32_t)(s.order - oldest->order) < 0)
+      oldest = &s;
+  }
+  return oldest;
+}
+
+void AT_Lib::onPublishLoaded(const AT_Completion &done, void *user)
+{
+  ((AT_Lib *)user)->publishLoaded(done);
+}
+
+// Chains complete in queue order, so this is the oldest one queued
+void AT_Lib::publishLoaded(const AT_Completion &done)
+{
+  PubSlot *slot = oldestPublish(PUB_QUEUED, -1);
+  if (!slot)
+    return;
+
+  if (done.ok)
+  {
+    slot->state = PUB_SENT;
+    slot->order = _pubOrder++;
+    slot->sentAt = millis();
+    return;
+  }
+  if (done.result == AT_RESULT_TIMEOUT)
+    retryPublish(*slot, done.result, done.code);
+  else
+    finishPublish(*slot, done.result, done.code);
+}
+
+void AT_Lib::handlePubResult(const char *line, uint16_t len)
+{
+  // +CMQTTPUB: <client_index>,<err>
+  AT_Fields f;
+  if (!f.parse(AT_Slice(line, len), AT_Cmd::MQTT_PUBLISH.response) || !f[1].isInt())
+    return;
+
+  PubSlot *slot = oldestPublish(PUB_SENT, f.toInt(0));
+  if (!slot)
+  {
+    AT_LOGD("[MQTT] Unmatched %s", line);
+    return;
+  }
+
+  int err = f.toInt(1);
+  statMqttResult(err);
+  noteMqttResult(AT_Cmd::MQTT_PUBLISH.response, slot->client, err);
+  if (err == SIM76xx_MQTT_TIMEOUT)
+    retryPublish(*slot, AT_RESULT_TERMINATOR, err);
+  else
+    finishPublish(*slot, AT_RESULT_TERMINATOR, err);
+}
+
+void AT_Lib::retryPublish(PubSlot &slot, AT_result_t result, int code)
+{
+  if (slot.retries >= _pubRetries || slot.dataOff < 0)
+  {
+    finishPublish(slot, result, code);
+    return;
+  }
+  slot.state = PUB_RESEND;
+  slot.retries++;
+  _stats.mqttPubRetries++;
+}
+
+bool AT_Lib::resendPublish(PubSlot &slot)
+{
+  if (_asyncCount + 3 > AT_ASYNC_QUEUE_LEN)
+    return false;
+
+  // The payload in the copy is already framed
+  const uint8_t *data = _pubData + slot.dataOff;
+  AT_PublishChannel channel;
+  if (!prepareChannel(channel, slot.client, (const char *)data, slot.topicLen, slot.qos, slot.retain, slot.timeout))
+    return false;
+  AsyncTx *pub = loadPublish(channel, data + slot.topicLen, slot.payloadLen, true);
+  if (!pub)
+    return false;
+  pub->cb = onPublishLoaded;
+  pub->user = this;
+  slot.state = PUB_QUEUED;
+  slot.order = _pubOrder++;
+  return true;
+}
+
+// The callback runs from publishStep(), outside the line
+// handling that found the result
+void AT_Lib::finishPublish(PubSlot &slot, AT_result_t result, int code)
+{
+  slot.state = PUB_DONE;
+  slot.result = result;
+  slot.code = code;
+}
+
+void AT_Lib::publishStep()
+{
+  uint32_t now = millis();
+  for (uint8_t i = 0; i < AT_MQTT_PUB_WINDOW_MAX; i++)
+  {
+    PubSlot &s = _pub[i];
+    // A lost link ends the wait; its result is not coming
+    if (s.state == PUB_SENT && (s.client >= AT_MQTT_CLIENTS || _mqtt[s.client].state < MQTT_STATE_CONNECTED))
+      finishPublish(s, AT_RESULT_TERMINATOR, SIM76xx_MQTT_NO_CONNECTION);
+    else if (s.state == PUB_SENT && now - s.sentAt >= resultWaitMs(s.timeout))
+    {
+      AT_LOGW("[MQTT] No publish result for client %u", s.client);
+      retryPublish(s, AT_RESULT_TIMEOUT, 0);
+    }
+
+    if (s.state == PUB_RESEND)
+    {
+      if (s.client >= AT_MQTT_CLIENTS || _mqtt[s.client].state < MQTT_STATE_CONNECTED)
+        finishPublish(s, AT_RESULT_TERMINATOR, SIM76xx_MQTT_NO_CONNECTION);
+      else
+        resendPublish(s);
+    }
+  }
+
+  PubSlot *slot;
+  while ((slot = oldestPublish(PUB_DONE, -1)))
+  {
+    AT_Completion done = {slot->result, slot->code, slot->result == AT_RESULT_TERMINATOR && slot->code == 0,
+                          AT_Slice()};
+    at_async_callback_t cb = slot->cb;
+    void *user = slot->user;
+    slot->state = PUB_FREE;
+    if (cb)
+      cb(done, user);
+  }
+}
+
+// Lets a blocking publish wait out the pipelined ones, whose
+// +CMQTTPUB: it would otherwise take for its own. Each of them
+// ends by its own result deadline (resultWaitMs) or once its
+// resends run out, not by the blocking call's timeout.
+void AT_Lib::waitPublishes()
+{
+  for (;;)
+  {
+    bool pending = false;
+    for (uint8_t i = 0; i < AT_MQTT_PUB_WINDOW_MAX; i++)
+      pending |= _pub[i].state != PUB_FREE && _pub[i].state != PUB_DONE;
+    if (!pending)
+      return;
+
+    asyncStep();
+    if (asyncIdle())
+    {
+      drainModem();
+      deliverMqtt();
+    }
+    publishStep();
+    waitModem(1);
+  }
+}
+
+#if AT_RTOS
+// Time until publishStep() has a callback to run, a resend
+// to queue or a result to give up on
+uint32_t AT_Lib::publishWaitMs() const
+{
+  uint32_t wait = UINT32_MAX;
+  uint32_t now = millis();
+  for (uint8_t i = 0; i < AT_MQTT_PUB_WINDOW_MAX; i++)
+  {
+    const PubSlot &s = _pub[i];
+    if (s.state == PUB_DONE || s.state == PUB_RESEND)
+      return 1;
+    if (s.state != PUB_SENT)
+      continue;
+    if (s.client >= AT_MQTT_CLIENTS || _mqtt[s.client].state < MQTT_STATE_CONNECTED)
+      return 1;
+    uint32_t limit = resultWaitMs(s.timeout);
+    uint32_t elapsed = now - s.sentAt;
+    uint32_t left = elapsed < limit ? limit - elapsed : 1;
+    if (left < wait)
+      wait = left;
+  }
+  return wait;
+}
+#endif
@@ -0,0 +1,281 @@
+#include "AT_lib.h"
+
+#if AT_RTOS
+
+// =====================================================
+// RTOS MODE
+// reader task:   UART → parser → async engine → event queue
+// callback task: event queue → MQTT / SMS / URC handlers
+// Handlers are looked up under the lock but called without
+// it, so a slow handler never stalls the reader.
+// =====================================================
+bool AT_Lib::beginTasks(const AT_RtosConfig &config)
+{
+  if (_readerTask)
+    return true;
+
+  if (!_lock)
+    _lock = xSemaphoreCreateRecursiveMutex();
+  if (!_events)
+    _events = xQueueCreate(config.eventQueueLen, sizeof(RtosEvent));
+  if (!_lock || !_events)
+  {
+    AT_LOGE("[RTOS] Out of memory");
+    return false;
+  }
+
+  _rtosStop = false;
+  if (xTaskCreatePinnedToCore(callbackTask, "at_callback", config.callbackStack, this, config.callbackPriority,
+                              &_callbackTask, config.callbackCore < 0 ? tskNO_AFFINITY : config.callbackCore) != pdPASS)
+  {
+    _callbackTask = nullptr;
+    AT_LOGE("[RTOS] Callback task not created");
+    return false;
+  }
+
+  {
+    // Held until the handle is stored, as it also marks RTOS mode
+    AT_GUARD();
+    if (xTaskCreatePinnedToCore(readerTask, "at_reader", config.readerStack, this, config.readerPriority,
+                                &_readerTask, config.readerCore < 0 ? tskNO_AFFINITY : config.readerCore) != pdPASS)
+    {
+      _readerTask = nullptr;
+      AT_LOGE("[RTOS] Reader task not created");
+    }
+  }
+
+  if (!_readerTask)
+  {
+    endTasks();
+    return false;
+  }
+
+#if defined(ARDUINO_ARCH_ESP32)
+  // Parse as soon as the UART driver has data rather than on the next period
+  if (_modemUart)
+    _modemUart->onReceive([this]()
+                          {
+                            TaskHandle_t reader = _readerTask;
+                            if (reader)
+                              xTaskNotifyGive(reader); });
+#endif
+
+  AT_LOGI("[RTOS] Reader and callback tasks started");
+  return true;
+}
+
+void AT_Lib::endTasks()
+{
+#if defined(ARDUINO_ARCH_ESP32)
+  if (_modemUart && _readerTask)
+    _modemUart->onReceive(nullptr);
+#endif
+
+  for (bool notified = false;;)
+  {
+    {
+      AT_GUARD();
+      if (!_readerTask)
+        break;
+      _rtosStop = true;
+      if (!notified)
+        wakeReader();
+      notified = true;
+    }
+    vTaskDelay(1);
+  }
+
+  // The reader is gone, so nothing else fills _eventOut; messages
+  // still queued are handed out before the stop event
+  if (_callbackTask)
+  {
+    _eventOut.type = RTOS_EV_STOP;
+    xQueueSend(_events, &_eventOut, portMAX_DELAY);
+    for (;;)
+    {
+      {
+        AT_GUARD();
+        if (!_callbackTask)
+          break;
+      }
+      vTaskDelay(1);
+    }
+  }
+}
+
+void AT_Lib::readerTask(void *arg)
+{
+  AT_Lib *self = (AT_Lib *)arg;
+  for (;;)
+  {
+    uint32_t ms;
+    {
+      Guard guard(self->_lock);
+      if (self->_rtosStop)
+      {
+        self->_readerTask = nullptr;
+        break;
+      }
+      self->pollStep();
+      ms = self->readerWaitMs();
+    }
+
+    // Woken early by UART data or newly queued async work
+#if AT_UART_EVENTS
+    if (self->_modemEvents)
+    {
+      self->_modemEvents->wait(ms);
+      continue;
+    }
+#endif
+    ulTaskNotifyTake(pdTRUE, ms == portMAX_DELAY ? portMAX_DELAY : pdMS_TO_TICKS(ms));
+  }
+  vTaskDelete(nullptr);
+}
+
+// How long the reader may sleep before pollStep() has work that
+// no wake-up announces: a timeout, a message to queue again, a
+// supervisor timer, the outbox drain, a pipelined publish or a
+// telemetry batch
+uint32_t AT_Lib::readerWaitMs() const
+{
+  for (uint8_t i = 0; i < AT_MQTT_CLIENTS; i++)
+    if (_mqtt[i].rxCount)
+      return 1;
+  if (_smsPendingCount)
+    return 1; // AT+CMGR goes out once the queue is free
+
+  // Without a UART wake-up, incoming data is only seen by polling
+  bool signalled = _modemEvents != nullptr;
+#if defined(ARDUINO_ARCH_ESP32)
+  signalled |= _modemUart != nullptr;
+#endif
+
+  uint32_t wait = superviseWaitMs();
+  uint32_t drain = outboxWaitMs();
+  if (drain < wait)
+    wait = drain;
+  uint32_t pub = publishWaitMs();
+  if (pub < wait)
+    wait = pub;
+  uint32_t batch = telemetryWaitMs();
+  if (batch < wait)
+    wait = batch;
+  if (_asyncState != ASYNC_IDLE)
+  {
+    if (!signalled)
+      return 1;
+    uint32_t elapsed = millis() - _asyncStart;
+    uint32_t timeout = _asyncQueue[_asyncHead].timeout;
+    timeout = elapsed < timeout ? timeout - elapsed : 0;
+    return timeout < wait ? timeout : wait;
+  }
+  if (!signalled && AT_RTOS_IDLE_MS < wait)
+    return AT_RTOS_IDLE_MS;
+  return wait;
+}
+
+void AT_Lib::wakeReader()
+{
+#if AT_UART_EVENTS
+  if (_modemEvents)
+  {
+    _modemEvents->wake();
+    return;
+  }
+#endif
+  xTaskNotifyGive(_readerTask);
+}
+
+void AT_Lib::callbackTask(void *arg)
+{
+  AT_Lib *self = (AT_Lib *)arg;
+  RtosEvent &ev = self->_eventIn;
+  while (xQueueReceive(self->_events, &ev, portMAX_DELAY) == pdTRUE && ev.type != RTOS_EV_STOP)
+    self->runEvent(ev);
+
+  {
+    Guard guard(self->_lock);
+    self->_callbackTask = nullptr;
+  }
+  vTaskDelete(nullptr);
+}
+
+// Copies an event into the queue without blocking: the caller holds
+// the lock, which the callback task needs to look up handlers
+bool AT_Lib::postEvent(uint8_t type, uint8_t client, const char *topic, const char *time,
+                       const char *data, uint16_t len)
+{
+  RtosEvent &ev = _eventOut;
+  ev.type = type;
+  ev.client = client;
+  snprintf(ev.topic, sizeof(ev.topic), "%s", topic ? topic : "");
+  snprintf(ev.time, sizeof(ev.time), "%s", time ? time : "");
+  if (len > MQTT_PAYLOAD_MAX)
+    len = MQTT_PAYLOAD_MAX;
+  memcpy(ev.data, data, len);
+  ev.data[len] = '\0';
+  ev.len = len;
+
+  if (xQueueSend(_events, &ev, 0) == pdTRUE)
+    return true;
+
+  // MQTT is retried by the reader; the others cannot be replayed
+  if (type != RTOS_EV_MQTT)
+  {
+    _stats.eventsDropped++;
+    AT_LOGW("[RTOS] Event queue full, %s dropped", type == RTOS_EV_SMS ? "SMS" : "URC");
+  }
+  return false;
+}
+
+void AT_Lib::runEvent(const RtosEvent &ev)
+{
+  switch (ev.type)
+  {
+  case RTOS_EV_MQTT:
+  {
+    mqtt_rx_callback_t handlers[AT_MQTT_SUBS_MAX];
+    uint8_t n;
+    {
+      AT_GUARD();
+      const MqttClient &c = _mqtt[ev.client];
+      n = c.topics.match(ev.topic, handlers, AT_MQTT_SUBS_MAX);
+      if (!n && c.callback)
+        handlers[n++] = c.callback;
+    }
+    for (uint8_t i = 0; i < n; i++)
+      handlers[i](ev.topic, ev.data, ev.len);
+    break;
+  }
+
+  case RTOS_EV_SMS:
+  {
+    sms_rx_callback_t cb;
+    {
+      AT_GUARD();
+      cb = _smsCallback;
+    }
+    if (cb)
+      cb(ev.topic, ev.time, ev.data);
+    break;
+  }
+
+  case RTOS_EV_URC:
+  {
+    urc_callback_t handlers[AT_URC_USER_MAX];
+    uint8_t n = 0;
+    {
+      AT_GUARD();
+      for (uint8_t i = 0; i < AT_URC_USER_MAX; i++)
+        if (_userUrcs[i].cb && strncmp(ev.data, _userUrcs[i].prefix, _userUrcs[i].prefixLen) == 0)
+          handlers[n++] = _userUrcs[i].cb;
+    }
+    for (uint8_t i = 0; i < n; i++)
+      handlers[i](ev.data);
+    break;
+  }
+  }
+}
+
+#endif /* AT_RTOS */
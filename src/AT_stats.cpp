@@ -0,0 +1,194 @@
+#include "AT_lib.h"
+#include <stdarg.h>
+
+// =====================================================
+// COMMAND FAMILIES
+// Table commands carry their family. Raw command text
+// is matched against these prefixes, so AT+CMQTTSUB
+// also takes AT+CMQTTSUBTOPIC and AT+CMG every SMS one
+// =====================================================
+struct FamilyPrefix
+{
+  const char *prefix;
+  AT_cmd_family_t family;
+};
+
+static const FamilyPrefix FAMILY_PREFIXES[] = {
+    {"AT+CMQTTSTART", AT_FAMILY_MQTT_CONNECT},
+    {"AT+CMQTTSTOP", AT_FAMILY_MQTT_CONNECT},
+    {"AT+CMQTTACCQ", AT_FAMILY_MQTT_CONNECT},
+    {"AT+CMQTTREL", AT_FAMILY_MQTT_CONNECT},
+    {"AT+CMQTTCONNECT", AT_FAMILY_MQTT_CONNECT},
+    {"AT+CMQTTDISC", AT_FAMILY_MQTT_CONNECT},
+    {"AT+CMQTTSSLCFG", AT_FAMILY_MQTT_CONNECT},
+    {"AT+CMQTTSUB", AT_FAMILY_MQTT_SUBSCRIBE},
+    {"AT+CMQTTUNSUB", AT_FAMILY_MQTT_SUBSCRIBE},
+    {"AT+CMQTTTOPIC", AT_FAMILY_MQTT_PUBLISH},
+    {"AT+CMQTTPAYLOAD", AT_FAMILY_MQTT_PUBLISH},
+    {"AT+CMQTTPUB", AT_FAMILY_MQTT_PUBLISH},
+    {"AT+CMG", AT_FAMILY_SMS},
+    {"AT+CNMI", AT_FAMILY_SMS},
+    {"AT+CCERT", AT_FAMILY_CERT},
+};
+
+AT_cmd_family_t AT_commandFamily(const char *command)
+{
+  for (uint8_t i = 0; i < sizeof(FAMILY_PREFIXES) / sizeof(FAMILY_PREFIXES[0]); i++)
+  {
+    const FamilyPrefix &f = FAMILY_PREFIXES[i];
+    if (strncmp(command, f.prefix, strlen(f.prefix)) == 0)
+      return f.family;
+  }
+  return AT_FAMILY_GENERIC;
+}
+
+const char *AT_familyName(AT_cmd_family_t family)
+{
+  switch (family)
+  {
+  case AT_FAMILY_MQTT_CONNECT:
+    return "mqtt_connect";
+  case AT_FAMILY_MQTT_PUBLISH:
+    return "mqtt_publish";
+  case AT_FAMILY_MQTT_SUBSCRIBE:
+    return "mqtt_subscribe";
+  case AT_FAMILY_SMS:
+    return "sms";
+  case AT_FAMILY_CERT:
+    return "cert";
+  default:
+    return "generic";
+  }
+}
+
+// =====================================================
+// RECORDING
+// A sample spans writeCommand() (or the async send) to
+// the final result; a '>' prompt is only an intermediate
+// step of the same command.
+// =====================================================
+void AT_Lib::statBegin(const char *command)
+{
+  statBegin(AT_commandFamily(command));
+}
+
+void AT_Lib::statBegin(AT_cmd_family_t family)
+{
+  _statFamily = family;
+  _statStart = millis();
+  _statPending = true;
+}
+
+void AT_Lib::statEnd(AT_result_t result)
+{
+  if (!_statPending || result == AT_RESULT_PROMPT)
+    return;
+  _statPending = false;
+
+  AT_LatencyStats &s = _stats.family[_statFamily];
+  uint32_t ms = millis() - _statStart;
+
+  s.count++;
+  if (result == AT_RESULT_TIMEOUT)
+    s.timeouts++;
+  else if (result == AT_RESULT_ERROR || result == AT_RESULT_CME_ERROR || result == AT_RESULT_CMS_ERROR)
+    s.errors++;
+
+  s.totalMs += ms;
+  if (ms > s.maxMs)
+    s.maxMs = ms;
+
+  uint8_t b = 0;
+  while (b < AT_STATS_BUCKETS - 1 && ms > AT_STATS_BUCKET_MS[b])
+    b++;
+  s.buckets[b]++;
+}
+
+void AT_Lib::statMqttResult(int err)
+{
+  if (err < 0 || err >= AT_STATS_MQTT_ERR_MAX)
+    err = AT_STATS_MQTT_ERR_MAX;
+  _stats.mqttResults[err]++;
+}
+
+void AT_Lib::resetStats()
+{
+  AT_GUARD();
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+// =====================================================
+// JSON EXPORT
+// {"bytes_in":..,"families":{"generic":{"n":..,"hist":[..]},..},
+//  "mqtt_results":{"0":12,"3":2},..}; codes never seen are left out
+// =====================================================
+struct JsonOut
+{
+  char *out;
+  size_t len;
+  size_t pos;
+
+  void printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+  {
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(out + (pos < len ? pos : len), pos < len ? len - pos : 0, format, args);
+    va_end(args);
+    if (n > 0)
+      pos += n;
+  }
+};
+
+size_t AT_statsToJson(const AT_Stats &stats, char *out, size_t outLen)
+{
+  JsonOut j = {out, outLen, 0};
+  if (outLen)
+    out[0] = '\0';
+
+  j.printf("{\"bytes_in\":%lu,\"bytes_out\":%lu,\"prompt_timeouts\":%lu,\"prompt_missing\":%lu,\"families\":{",
+           (unsigned long)stats.bytesIn, (unsigned long)stats.bytesOut, (unsigned long)stats.promptTimeouts,
+           (unsigned long)stats.promptMissing);
+
+  for (uint8_t f = 0; f < AT_FAMILY_COUNT; f++)
+  {
+    const AT_LatencyStats &s = stats.family[f];
+    j.printf("%s\"%s\":{\"n\":%lu,\"err\":%lu,\"timeout\":%lu,\"total_ms\":%lu,\"max_ms\":%lu,\"hist\":[",
+             f ? "," : "", AT_familyName((AT_cmd_family_t)f), (unsigned long)s.count, (unsigned long)s.errors,
+             (unsigned long)s.timeouts, (unsigned long)s.totalMs, (unsigned long)s.maxMs);
+    for (uint8_t b = 0; b < AT_STATS_BUCKETS; b++)
+      j.printf("%s%lu", b ? "," : "", (unsigned long)s.buckets[b]);
+    j.printf("]}");
+  }
+
+  j.printf("},\"mqtt_results\":{");
+  bool first = true;
+  for (uint8_t e = 0; e <= AT_STATS_MQTT_ERR_MAX; e++)
+  {
+    if (!stats.mqttResults[e])
+      continue;
+    j.printf("%s\"%u\":%lu", first ? "" : ",", e, (unsigned long)stats.mqttResults[e]);
+    first = false;
+  }
+
+  j.printf("},\"resp_trunc\":%lu,\"line_trunc\":%lu,\"mqtt_rx_overflow\":%lu,\"mqtt_rx_dropped\":%lu,"
+           "\"mqtt_rx_invalid\":%lu,\"sms_dropped\":%lu,\"events_dropped\":%lu,\"mqtt_link_lost\":%lu,"
+           "\"mqtt_reconnects\":%lu,\"mqtt_pub_retries\":%lu,\"codec_saved_bytes\":%lu,",
+           (unsigned long)stats.responseTruncated, (unsigned long)stats.lineTruncated,
+           (unsigned long)stats.mqttRxOverflow, (unsigned long)stats.mqttRxDropped,
+           (unsigned long)stats.mqttRxInvalid, (unsigned long)stats.smsDropped,
+           (unsigned long)stats.eventsDropped, (unsigned long)stats.mqttLinkLost,
+           (unsigned long)stats.mqttReconnects, (unsigned long)stats.mqttPubRetries,
+           (unsigned long)stats.codecSaved);
+
+  j.printf("\"outbox_stored\":%lu,\"outbox_sent\":%lu,\"outbox_dropped\":%lu,\"outbox_depth\":%lu,"
+           "\"outbox_drain_per_min\":%lu,",
+           (unsigned long)stats.outboxStored, (unsigned long)stats.outboxSent,
+           (unsigned long)stats.outboxDropped, (unsigned long)stats.outboxDepth,
+           (unsigned long)stats.outboxDrainRate);
+
+  j.printf("\"telemetry_samples\":%lu,\"telemetry_batches\":%lu,\"telemetry_dropped\":%lu}",
+           (unsigned long)stats.telemetrySamples, (unsigned long)stats.telemetryBatches,
+           (unsigned long)stats.telemetryDropped);
+
+  return j.pos;
+}
@@ -0,0 +1,94 @@
+#ifndef AT_STATS_H
+#define AT_STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* =====================================================
+ * COMMAND FAMILIES
+ * Every AT command is counted under one family, taken
+ * from its AT_cmd.h entry or, for raw command text,
+ * picked from the text when it is written.
+ * ===================================================== */
+typedef enum
+{
+  AT_FAMILY_GENERIC = 0,   /**< Anything not listed below */
+  AT_FAMILY_MQTT_CONNECT,  /**< CMQTTSTART/STOP/ACCQ/REL/CONNECT/DISC */
+  AT_FAMILY_MQTT_PUBLISH,  /**< CMQTTTOPIC/PAYLOAD/PUB */
+  AT_FAMILY_MQTT_SUBSCRIBE, /**< CMQTTSUB/UNSUB and their topic staging */
+  AT_FAMILY_SMS,           /**< CMGF/CMGS/CMGR/CMGD/CNMI */
+  AT_FAMILY_CERT,          /**< CCERT* */
+  AT_FAMILY_COUNT
+} AT_cmd_family_t;
+
+/* =====================================================
+ * LATENCY HISTOGRAM
+ * Fixed buckets, command write to final result code.
+ * Bucket i counts samples up to AT_STATS_BUCKET_MS[i];
+ * the last bucket takes everything slower.
+ * ===================================================== */
+#define AT_STATS_BUCKETS 11
+
+static const uint16_t AT_STATS_BUCKET_MS[AT_STATS_BUCKETS - 1] = {
+    10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000};
+
+/* MQTT <err> 0..34, the last slot counts codes out of range */
+#define AT_STATS_MQTT_ERR_MAX 35
+
+typedef struct
+{
+  uint32_t count;    /**< Commands that reached a result or timed out */
+  uint32_t errors;   /**< ERROR, +CME ERROR, +CMS ERROR */
+  uint32_t timeouts; /**< No final result code in time */
+  uint32_t totalMs;  /**< Sum of latencies, for the mean */
+  uint32_t maxMs;
+  uint32_t buckets[AT_STATS_BUCKETS];
+} AT_LatencyStats;
+
+/* =====================================================
+ * STATS SNAPSHOT
+ * Counters only ever grow until AT_Lib::resetStats();
+ * the outbox depth and drain rate are gauges.
+ * ===================================================== */
+typedef struct
+{
+  AT_LatencyStats family[AT_FAMILY_COUNT];
+
+  uint32_t bytesIn;  /**< UART bytes read from the modem */
+  uint32_t bytesOut; /**< UART bytes written to the modem */
+
+  uint32_t promptTimeouts; /**< No '>' before the timeout */
+  uint32_t promptMissing;  /**< A final result where '>' was due; the data was not sent */
+  uint32_t mqttResults[AT_STATS_MQTT_ERR_MAX + 1]; /**< +CMQTTxxx <err> seen, by code */
+
+  uint32_t responseTruncated; /**< Response longer than AT_RESPONSE_MAX */
+  uint32_t lineTruncated;     /**< Line longer than AT_LINE_MAX */
+  uint32_t mqttRxOverflow;    /**< Topic or payload longer than its RX buffer, dropped */
+  uint32_t mqttRxDropped;     /**< Message dropped, its client's RX queue full */
+  uint32_t mqttRxInvalid;     /**< Payload failing its topic's codec, dropped */
+  uint32_t smsDropped;        /**< SMS left on the SIM: pending queue full, or unreadable */
+  uint32_t eventsDropped;     /**< SMS / URC not queued for the RTOS callback task */
+  uint32_t mqttLinkLost;      /**< Connected client found disconnected */
+  uint32_t mqttReconnects;    /**< Connections brought back by the supervisor */
+  uint32_t mqttPubRetries;    /**< Pipelined publishes sent again after a timeout */
+  uint32_t codecSaved;        /**< Payload bytes LZ framing kept off the air */
+
+  uint32_t outboxStored;    /**< Publishes stored while the link was down */
+  uint32_t outboxSent;      /**< Stored publishes delivered */
+  uint32_t outboxDropped;   /**< Stored publishes evicted, corrupt or refused */
+  uint32_t outboxDepth;     /**< Stored publishes waiting */
+  uint32_t outboxDrainRate; /**< Delivered per minute, last measured drain */
+
+  uint32_t telemetrySamples; /**< Samples taken by record() */
+  uint32_t telemetryBatches; /**< Batched messages handed over for publishing */
+  uint32_t telemetryDropped; /**< Samples refused by record() or in a batch not handed over */
+} AT_Stats;
+
+const char *AT_familyName(AT_cmd_family_t family);
+AT_cmd_family_t AT_commandFamily(const char *command);
+
+/* Compact JSON for a health topic; returns the length written,
+ * or the length needed when `out` is too small (like snprintf) */
+size_t AT_statsToJson(const AT_Stats &stats, char *out, size_t outLen);
+
+#endif /* AT_STATS_H */
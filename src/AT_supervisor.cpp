@@ -0,0 +1,377 @@
+#include "AT_lib.h"
+
+// =====================================================
+// MQTT SUPERVISOR
+// Driven from poll() through the async queue, one step
+// in flight at a time:
+//   IDLE → AT+CMQTTSTART → STARTED → AT+CMQTTACCQ →
+//   ACQUIRED → AT+CMQTTCONNECT → CONNECTED →
+//   AT+CMQTTSUBTOPIC.. + AT+CMQTTSUB per batch → up
+// A failed attempt waits out a jittered backoff and
+// resumes from whatever state the client is left in.
+// =====================================================
+bool AT_Lib::mqttSupervise(uint8_t clientId, const AT_MqttSession &session)
+{
+  AT_GUARD();
+  MqttClient *c = mqttClient(clientId);
+  if (!c)
+    return false;
+  if (!session.clientName || !session.uri)
+  {
+    AT_LOGW("[MQTT] Supervisor needs a client name and a URI");
+    return false;
+  }
+
+  c->session = session;
+  if (!c->session.backoffMinMs)
+    c->session.backoffMinMs = 1;
+  if (c->session.backoffMaxMs < c->session.backoffMinMs)
+    c->session.backoffMaxMs = c->session.backoffMinMs;
+
+  c->supervised = true;
+  c->supArmed = false;
+  c->supFailures = 0;
+  c->supReleasedAt = 0;
+  c->supResubscribe = c->state < MQTT_STATE_CONNECTED;
+  c->supLost = false;
+  c->supResubNext = 0;
+  c->supCheckAt = millis() + c->session.checkIntervalMs;
+  if (!_supRng)
+    _supRng = micros() | 1;
+  return true;
+}
+
+void AT_Lib::mqttUnsupervise(uint8_t clientId)
+{
+  AT_GUARD();
+  if (MqttClient *c = mqttClient(clientId))
+    c->supervised = false;
+}
+
+// Equal jitter: half the delay is fixed, half random, so a
+// fleet dropped by the same outage does not return in step
+uint32_t AT_Lib::superviseBackoff(const MqttClient &c)
+{
+  uint32_t ceiling = c.session.backoffMinMs;
+  for (uint8_t i = 0; i < c.supFailures && ceiling < c.session.backoffMaxMs; i++)
+    ceiling *= 2;
+  if (ceiling > c.session.backoffMaxMs)
+    ceiling = c.session.backoffMaxMs;
+
+  // xorshift32
+  _supRng ^= _supRng << 13;
+  _supRng ^= _supRng >> 17;
+  _supRng ^= _supRng << 5;
+  return ceiling / 2 + _supRng % (ceiling - ceiling / 2 + 1);
+}
+
+void AT_Lib::superviseStep()
+{
+  if (_supClient >= 0)
+    return;
+
+  uint32_t now = millis();
+  for (uint8_t i = 0; i < AT_MQTT_CLIENTS; i++)
+  {
+    MqttClient &c = _mqtt[i];
+    if (!c.supervised)
+      continue;
+
+    if (c.state >= MQTT_STATE_CONNECTED && !c.supResubscribe)
+    {
+      // Catches a link the modem dropped without a URC; only
+      // sent while nothing else is queued
+      if (c.session.checkIntervalMs && (int32_t)(now - c.supCheckAt) >= 0 && !_asyncCount)
+      {
+        c.supCheckAt = now + c.session.checkIntervalMs;
+        _supStep = SUP_CHECK;
+        if (commandAsync(AT_Cmd::MQTT_CONNECT_QUERY, onSuperviseStep, this, 0))
+        {
+          _supClient = i;
+          return;
+        }
+      }
+      continue;
+    }
+
+    if (!c.supArmed)
+    {
+      uint32_t delayMs = superviseBackoff(c);
+      c.supArmed = true;
+      c.supRetryAt = now + delayMs;
+      AT_LOGI("[MQTT] Client %u reconnecting in %lu ms", i, (unsigned long)delayMs);
+      continue;
+    }
+
+    if ((int32_t)(now - c.supRetryAt) >= 0 && superviseNext(i))
+      return;
+  }
+}
+
+// Time until superviseStep() has something to do, for the
+// RTOS reader's sleep; UINT32_MAX when nothing is due
+uint32_t AT_Lib::superviseWaitMs() const
+{
+  uint32_t wait = UINT32_MAX;
+  if (_supClient >= 0)
+    return wait; // the step's own result wakes the reader
+
+  uint32_t now = millis();
+  for (uint8_t i = 0; i < AT_MQTT_CLIENTS; i++)
+  {
+    const MqttClient &c = _mqtt[i];
+    if (!c.supervised)
+      continue;
+
+    uint32_t due = now; // a backoff still to be armed
+    if (c.supArmed)
+      due = c.supRetryAt;
+    else if (c.state >= MQTT_STATE_CONNECTED && !c.supResubscribe)
+    {
+      if (!c.session.checkIntervalMs)
+        continue;
+      due = c.supCheckAt;
+    }
+
+    int32_t left = (int32_t)(due - now);
+    if (left <= 0)
+      return 1;
+    if ((uint32_t)left < wait)
+      wait = left;
+  }
+  return wait;
+}
+
+// Queues the step the client's state calls for. Returns
+// false when it is up or the queue has no room yet.
+bool AT_Lib::superviseNext(uint8_t clientId)
+{
+  MqttClient &c = _mqtt[clientId];
+  const AT_MqttSession &s = c.session;
+
+  if (c.state >= MQTT_STATE_CONNECTED && (!c.supResubscribe || !c.topics.at(c.supResubNext)))
+  {
+    AT_LOGI("[MQTT] Client %u connected, %u subscriptions restored", clientId, c.supResubNext);
+    c.supArmed = false;
+    c.supFailures = 0;
+    c.supReleasedAt = 0;
+    c.supResubscribe = false;
+    c.supResubNext = 0;
+    c.supCheckAt = millis() + s.checkIntervalMs;
+    // The first connect of a supervised client is not a reconnect
+    if (c.supLost)
+      _stats.mqttReconnects++;
+    c.supLost = false;
+    return false;
+  }
+
+  bool queued;
+  switch (c.state)
+  {
+  case MQTT_STATE_IDLE:
+    _supStep = SUP_START;
+    queued = commandAsync(AT_Cmd::MQTT_START, onSuperviseStep, this, 0);
+    break;
+  case MQTT_STATE_STARTED:
+    _supStep = SUP_ACQUIRE;
+    queued = commandAsync(AT_Cmd::MQTT_ACQUIRE, onSuperviseStep, this, 0, clientId, s.clientName);
+    break;
+  case MQTT_STATE_ACQUIRED:
+    if (c.supFailures && c.supFailures % AT_MQTT_RELEASE_AFTER == 0 && c.supReleasedAt != c.supFailures)
+    {
+      // Repeated failures: start over with a fresh client
+      AT_LOGI("[MQTT] Client %u released after %u failures", clientId, c.supFailures);
+      _supStep = SUP_RELEASE;
+      queued = commandAsync(AT_Cmd::MQTT_RELEASE, onSuperviseStep, this, 0, clientId);
+    }
+    else
+    {
+      _supStep = SUP_CONNECT;
+      queued = commandAsync(AT_Cmd::MQTT_CONNECT, onSuperviseStep, this, 0, clientId, s.uri, s.keepAlive,
+                            s.cleanSession ? 1 : 0, s.user, s.pass);
+    }
+    break;
+  default:
+    _supStep = SUP_RESUBSCRIBE;
+    queued = superviseResubscribe(clientId);
+    break;
+  }
+
+  if (queued)
+    _supClient = clientId;
+  return queued;
+}
+
+// Stages as many filters as the queue has room for and
+// sends them in one SUBSCRIBE; the next batch follows.
+bool AT_Lib::superviseResubscribe(uint8_t clientId)
+{
+  MqttClient &c = _mqtt[clientId];
+  AsyncMark mark = markAsync();
+  uint8_t n = c.supResubNext;
+
+  const AT_TopicTable::Entry *e;
+  while (_asyncCount < AT_ASYNC_QUEUE_LEN - 1 && (e = c.topics.at(n)))
+  {
+    size_t len = strlen(e->filter);
+    AsyncTx *tx = pushCommand(AT_Cmd::MQTT_SUB_TOPIC, (const uint8_t *)e->filter, len, 0,
+                              clientId, (unsigned)len, e->qos);
+    if (!tx)
+      break;
+    tx->flags = TX_CHAINED;
+    n++;
+  }
+
+  AsyncTx *sub = n > c.supResubNext ? pushCommand(AT_Cmd::MQTT_SUBSCRIBE, nullptr, 0, 0, clientId) : nullptr;
+  if (!sub)
+  {
+    rollbackAsync(mark);
+    return false;
+  }
+  sub->cb = onSuperviseStep;
+  sub->user = this;
+  _supResubEnd = n;
+  return true;
+}
+
+void AT_Lib::onSuperviseStep(const AT_Completion &done, void *user)
+{
+  ((AT_Lib *)user)->superviseDone(done);
+}
+
+void AT_Lib::superviseDone(const AT_Completion &done)
+{
+  uint8_t clientId = _supClient;
+  _supClient = -1;
+
+  if (_supStep == SUP_CHECK)
+  {
+    // +CMQTTCONNECT: <client_index>[,<server_addr>,...], one line
+    // per client; the address is only listed while connected
+    AT_Slice line;
+    uint16_t pos = 0;
+    while (done.ok && done.response.nextLine(pos, line))
+    {
+      AT_Fields f;
+      if (!f.parse(line, AT_Cmd::MQTT_CONNECT_QUERY.response) || !f[0].isInt())
+        continue;
+      long id = f.toInt(0);
+      if (id >= 0 && id < AT_MQTT_CLIENTS && _mqtt[id].supervised && f.count() < 2)
+        mqttLinkDown(id, MQTT_STATE_ACQUIRED, "not connected");
+    }
+    return;
+  }
+
+  MqttClient &c = _mqtt[clientId];
+  if (!c.supervised)
+    return;
+
+  bool failed = done.result == AT_RESULT_TIMEOUT;
+  if (!failed)
+  {
+    switch (_supStep)
+    {
+    case SUP_START:
+      // ERROR mostly means the service already runs; a real
+      // failure shows up at the connect
+      for (uint8_t i = 0; i < AT_MQTT_CLIENTS; i++)
+      {
+        if (_mqtt[i].state == MQTT_STATE_IDLE)
+          _mqtt[i].state = MQTT_STATE_STARTED;
+      }
+      break;
+    case SUP_RELEASE:
+      c.supReleasedAt = c.supFailures;
+      if (c.state > MQTT_STATE_STARTED)
+        c.state = MQTT_STATE_STARTED;
+      break;
+    case SUP_ACQUIRE:
+      // Likewise, ERROR mostly means the index is still acquired
+      if (c.state < MQTT_STATE_ACQUIRED)
+        c.state = MQTT_STATE_ACQUIRED;
+      break;
+    case SUP_CONNECT:
+      // A good result has already moved the client to CONNECTED
+      failed = !done.ok;
+      break;
+    case SUP_RESUBSCRIBE:
+      failed = !done.ok;
+      if (!failed)
+        c.supResubNext = _supResubEnd;
+      break;
+    default:
+      break;
+    }
+  }
+
+  if (failed)
+  {
+    AT_LOGW("[MQTT] Client %u reconnect attempt failed (%d)", clientId, done.code);
+    if (c.supFailures < 255)
+      c.supFailures++;
+    c.supArmed = false;
+    return;
+  }
+  superviseNext(clientId);
+}
+
+// =====================================================
+// LINK STATE
+// Result codes and URCs that mean the broker link (or
+// more) is gone move the client down; the supervisor
+// rebuilds from there.
+// =====================================================
+void AT_Lib::mqttLinkDown(uint8_t clientId, SIM76xx_mqtt_state_t state, const char *why)
+{
+  if (clientId >= AT_MQTT_CLIENTS)
+    return;
+
+  MqttClient &c = _mqtt[clientId];
+  bool wasUp = c.state >= MQTT_STATE_CONNECTED;
+  if (c.state > state)
+    c.state = state;
+  if (!wasUp)
+    return;
+
+  _stats.mqttLinkLost++;
+  c.supLost = true;
+  c.supResubscribe = true;
+  c.supResubNext = 0;
+  AT_LOGW("[MQTT] Client %u link down: %s", clientId, why);
+}
+
+void AT_Lib::noteMqttResult(const char *result, int clientId, int err)
+{
+  if (clientId < 0 || clientId >= AT_MQTT_CLIENTS)
+    return;
+
+  MqttClient &c = _mqtt[clientId];
+  if (err == SIM76xx_MQTT_OK)
+  {
+    if (strcmp(result, AT_Cmd::MQTT_CONNECT.response) == 0 && c.state < MQTT_STATE_CONNECTED)
+      c.state = MQTT_STATE_CONNECTED;
+    else if (strcmp(result, AT_Cmd::MQTT_SUBSCRIBE.response) == 0 && c.state == MQTT_STATE_CONNECTED)
+      c.state = MQTT_STATE_SUBSCRIBED;
+    else if (strcmp(result, AT_Cmd::MQTT_DISCONNECT.response) == 0 && c.state > MQTT_STATE_ACQUIRED)
+      c.state = MQTT_STATE_ACQUIRED;
+    return;
+  }
+
+  switch (err)
+  {
+  case SIM76xx_MQTT_NO_CONNECTION:
+  case SIM76xx_MQTT_MSG_RECV_FAIL:
+  case SIM76xx_MQTT_SOCK_SEND_FAIL:
+  case SIM76xx_MQTT_SOCKET_CLOSED_BY_SERVER:
+    mqttLinkDown(clientId, MQTT_STATE_ACQUIRED, SIM76xx_mqtt_err_str((SIM76xx_mqtt_err_t)err));
+    break;
+  case SIM76xx_MQTT_CLIENT_NOT_ACQUIRED:
+    mqttLinkDown(clientId, MQTT_STATE_STARTED, SIM76xx_mqtt_err_str((SIM76xx_mqtt_err_t)err));
+    break;
+  case SIM76xx_MQTT_NET_NOT_OPEN:
+    mqttLinkDown(clientId, MQTT_STATE_IDLE, SIM76xx_mqtt_err_str((SIM76xx_mqtt_err_t)err));
+    break;
+  default:
+    break;
+  }
+}
@@ -0,0 +1,239 @@
+#include "AT_lib.h"
+
+// =====================================================
+// TELEMETRY
+// =====================================================
+AT_Telemetry::AT_Telemetry(uint16_t flushBytes, uint32_t windowMs)
+    : _flushBytes(flushBytes), _windowMs(windowMs)
+{
+  // Room for the closing "]}" is kept in every batch
+  if (_flushBytes > AT_TELEMETRY_BATCH_MAX - 2)
+    _flushBytes = AT_TELEMETRY_BATCH_MAX - 2;
+}
+
+bool AT_Telemetry::record(const char *topic, double value, uint32_t now)
+{
+  if (isnan(value) || isinf(value))
+    return false; // no JSON for them
+  char text[24];
+  snprintf(text, sizeof(text), "%.*g", AT_TELEMETRY_DIGITS, value);
+  return append(topic, text, now);
+}
+
+bool AT_Telemetry::record(const char *topic, long value, uint32_t now)
+{
+  char text[24];
+  snprintf(text, sizeof(text), "%ld", value);
+  return append(topic, text, now);
+}
+
+bool AT_Telemetry::record(const char *topic, unsigned long value, uint32_t now)
+{
+  char text[24];
+  snprintf(text, sizeof(text), "%lu", value);
+  return append(topic, text, now);
+}
+
+// The topic's own slot, else one without samples
+AT_Telemetry::Batch *AT_Telemetry::batch(const char *topic)
+{
+  Batch *spare = nullptr;
+  for (uint8_t i = 0; i < AT_TELEMETRY_TOPICS; i++)
+  {
+    Batch &b = _batches[i];
+    if (b.topic[0] && strcmp(b.topic, topic) == 0)
+      return &b;
+    if (!b.count && !spare)
+      spare = &b;
+  }
+  if (spare)
+    strcpy(spare->topic, topic);
+  return spare;
+}
+
+bool AT_Telemetry::append(const char *topic, const char *value, uint32_t now)
+{
+  size_t topicLen = topic ? strlen(topic) : 0;
+  if (topicLen == 0 || topicLen >= AT_TELEMETRY_TOPIC_MAX)
+    return false;
+
+  Batch *b = batch(topic);
+  if (!b)
+    return false;
+
+  if (!b->count)
+  {
+    b->first = now;
+    b->len = snprintf(b->data, sizeof(b->data), "{\"t\":%lu,\"s\":[", (unsigned long)now);
+  }
+
+  char sample[40];
+  int len = snprintf(sample, sizeof(sample), "%s[%lu,%s]", b->count ? "," : "",
+                     (unsigned long)(now - b->first), value);
+  if (len <= 0 || b->len + len + 2 > AT_TELEMETRY_BATCH_MAX)
+    return false;
+
+  memcpy(b->data + b->len, sample, len);
+  b->len += len;
+  b->count++;
+  return true;
+}
+
+int8_t AT_Telemetry::due(uint32_t now, bool all) const
+{
+  for (uint8_t i = 0; i < AT_TELEMETRY_TOPICS; i++)
+  {
+    const Batch &b = _batches[i];
+    if (b.count && (all || b.len >= _flushBytes || now - b.first >= _windowMs))
+      return i;
+  }
+  return -1;
+}
+
+uint32_t AT_Telemetry::waitMs(uint32_t now) const
+{
+  uint32_t wait = UINT32_MAX;
+  for (uint8_t i = 0; i < AT_TELEMETRY_TOPICS; i++)
+  {
+    const Batch &b = _batches[i];
+    if (!b.count)
+      continue;
+    uint32_t age = now - b.first;
+    if (b.len >= _flushBytes || age >= _windowMs)
+      return 0;
+    if (_windowMs - age < wait)
+      wait = _windowMs - age;
+  }
+  return wait;
+}
+
+const uint8_t *AT_Telemetry::payload(uint8_t i, uint16_t &length)
+{
+  // Closed in place; the next sample overwrites the "]}"
+  Batch &b = _batches[i];
+  b.data[b.len] = ']';
+  b.data[b.len + 1] = '}';
+  length = b.len + 2;
+  return (const uint8_t *)b.data;
+}
+
+uint32_t AT_Telemetry::pending() const
+{
+  uint32_t n = 0;
+  for (uint8_t i = 0; i < AT_TELEMETRY_TOPICS; i++)
+    n += _batches[i].count;
+  return n;
+}
+
+// =====================================================
+// AT_LIB TELEMETRY
+// Due batches are handed to mqttPublishAsync() from
+// poll(), so they take the outbox while the link is down
+// and the publish window when one is set. Without an
+// outbox they wait in their buffers for the link.
+// =====================================================
+void AT_Lib::setTelemetry(AT_Telemetry *telemetry, uint8_t clientId, uint8_t qos)
+{
+  AT_GUARD();
+  _telemetry = telemetry;
+  _telemetryClient = clientId;
+  _telemetryQos = qos;
+  _telemetryFlush = false;
+}
+
+bool AT_Lib::record(const char *topic, double value)
+{
+  AT_GUARD();
+  return _telemetry && noteSample(_telemetry->record(topic, value, millis()), topic);
+}
+
+bool AT_Lib::record(const char *topic, long value)
+{
+  AT_GUARD();
+  return _telemetry && noteSample(_telemetry->record(topic, value, millis()), topic);
+}
+
+bool AT_Lib::record(const char *topic, unsigned long value)
+{
+  AT_GUARD();
+  return _telemetry && noteSample(_telemetry->record(topic, value, millis()), topic);
+}
+
+bool AT_Lib::noteSample(bool recorded, const char *topic)
+{
+  if (!recorded)
+  {
+    AT_LOGW("[TELEMETRY] Sample for %s not recorded", topic ? topic : "");
+    _stats.telemetryDropped++;
+    return false;
+  }
+  _stats.telemetrySamples++;
+#if AT_RTOS
+  if (_readerTask && _telemetry->waitMs(millis()) == 0)
+    wakeReader();
+#endif
+  return true;
+}
+
+void AT_Lib::flushTelemetry()
+{
+  AT_GUARD();
+  if (!_telemetry)
+    return;
+  _telemetryFlush = true;
+#if AT_RTOS
+  if (_readerTask)
+    wakeReader();
+#endif
+}
+
+// Whether a due batch can be handed over now
+bool AT_Lib::telemetryReady() const
+{
+  if (_telemetryClient >= AT_MQTT_CLIENTS)
+    return false;
+  if (_mqtt[_telemetryClient].state < MQTT_STATE_CONNECTED)
+    return _outbox != nullptr;
+  if (_asyncCount + 3 > AT_ASYNC_QUEUE_LEN)
+    return false;
+  return _pubWindow <= 1 || publishesInFlight() < _pubWindow;
+}
+
+void AT_Lib::telemetryStep()
+{
+  if (!_telemetry)
+    return;
+
+  int8_t i;
+  while ((i = _telemetry->due(millis(), _telemetryFlush)) >= 0)
+  {
+    if (!telemetryReady())
+      return;
+
+    uint16_t len;
+    const uint8_t *payload = _telemetry->payload(i, len);
+    if (mqttPublishAsync(_telemetryClient, _telemetry->topic(i), payload, len, _telemetryQos, nullptr))
+    {
+      _stats.telemetryBatches++;
+    }
+    else
+    {
+      AT_LOGW("[TELEMETRY] Batch for %s dropped", _telemetry->topic(i));
+      _stats.telemetryDropped += _telemetry->samples(i);
+    }
+    _telemetry->reset(i);
+  }
+  _telemetryFlush = false;
+}
+
+#if AT_RTOS
+// Time until a batch is due, for the reader's sleep; a
+// client coming back is seen by the reader itself
+uint32_t AT_Lib::telemetryWaitMs() const
+{
+  if (!_telemetry || !telemetryReady())
+    return UINT32_MAX;
+  uint32_t wait = _telemetryFlush && _telemetry->pending() ? 0 : _telemetry->waitMs(millis());
+  return wait ? wait : 1;
+}
+#endif
@@ -0,0 +1,90 @@
+#ifndef AT_TELEMETRY_H
+#define AT_TELEMETRY_H
+
+#include <Arduino.h>
+
+#ifndef AT_TELEMETRY_TOPICS
+#define AT_TELEMETRY_TOPICS 4 // topics batched at the same time
+#endif
+
+#ifndef AT_TELEMETRY_TOPIC_MAX
+#define AT_TELEMETRY_TOPIC_MAX 64 // longest topic, including NUL
+#endif
+
+#ifndef AT_TELEMETRY_BATCH_MAX
+#define AT_TELEMETRY_BATCH_MAX 1024 // bytes per batch buffer, the MQTT payload limit
+#endif
+
+#ifndef AT_TELEMETRY_FLUSH_BYTES
+#define AT_TELEMETRY_FLUSH_BYTES 896 // batch size that sends it; the rest takes samples until then
+#endif
+
+#ifndef AT_TELEMETRY_WINDOW
+#define AT_TELEMETRY_WINDOW 10000 // ms the first sample of a batch may wait
+#endif
+
+#ifndef AT_TELEMETRY_DIGITS
+#define AT_TELEMETRY_DIGITS 6 // significant digits of a floating-point sample
+#endif
+
+/* =====================================================
+ * TELEMETRY BATCH FORMAT
+ * One JSON message per topic and batch:
+ *   {"t":<t0>,"s":[[<dt>,<value>],[<dt>,<value>],..]}
+ *   t0     millis() of the first sample
+ *   dt     ms of each sample after t0
+ * ===================================================== */
+
+/* =====================================================
+ * TELEMETRY
+ * Samples collected per topic in preallocated buffers.
+ * A batch is due once it reaches `flushBytes` or its
+ * first sample is `windowMs` old. Attach with
+ * AT_Lib::setTelemetry(); AT_Lib::record() adds to it
+ * and poll() publishes the due batches.
+ * ===================================================== */
+class AT_Telemetry
+{
+public:
+  explicit AT_Telemetry(uint16_t flushBytes = AT_TELEMETRY_FLUSH_BYTES, uint32_t windowMs = AT_TELEMETRY_WINDOW);
+
+  /* False when the topic is invalid, every topic slot holds
+   * samples of another topic, or the batch has no room left */
+  bool record(const char *topic, double value, uint32_t now);
+  bool record(const char *topic, long value, uint32_t now);
+  bool record(const char *topic, unsigned long value, uint32_t now);
+
+  /* Index of a batch to send, -1 if none; `all` takes any
+   * batch with samples (a flush) */
+  int8_t due(uint32_t now, bool all = false) const;
+  /* Time until the next batch is due by age, UINT32_MAX if none */
+  uint32_t waitMs(uint32_t now) const;
+
+  const char *topic(uint8_t i) const { return _batches[i].topic; }
+  uint16_t samples(uint8_t i) const { return _batches[i].count; }
+  /* The finished JSON message; valid until the next record() */
+  const uint8_t *payload(uint8_t i, uint16_t &length);
+  /* The batch went out; the topic keeps its slot */
+  void reset(uint8_t i) { _batches[i].count = 0; }
+
+  uint32_t pending() const; // samples not yet handed over
+
+private:
+  struct Batch
+  {
+    char topic[AT_TELEMETRY_TOPIC_MAX];
+    char data[AT_TELEMETRY_BATCH_MAX];
+    uint16_t len;
+    uint16_t count;
+    uint32_t first;
+  };
+
+  bool append(const char *topic, const char *value, uint32_t now);
+  Batch *batch(const char *topic);
+
+  uint16_t _flushBytes;
+  uint32_t _windowMs;
+  Batch _batches[AT_TELEMETRY_TOPICS] = {};
+};
+
+#endif /* AT_TELEMETRY_H */
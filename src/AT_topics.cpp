@@ -0,0 +1,218 @@
+#include "AT_topics.h"
+#include <string.h>
+
+static uint32_t fnv1a(const char *s)
+{
+  uint32_t h = 2166136261u;
+  while (*s)
+  {
+    h ^= (uint8_t)*s++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+// =====================================================
+// FILTER VALIDATION
+// '#' only as the last level, '+' only as a whole level
+// =====================================================
+bool AT_TopicTable::valid(const char *filter)
+{
+  if (!filter || !filter[0] || strlen(filter) >= AT_MQTT_FILTER_MAX)
+    return false;
+
+  for (const char *p = filter; *p; p++)
+  {
+    bool levelStart = (p == filter || p[-1] == '/');
+    bool levelEnd = (p[1] == '\0' || p[1] == '/');
+
+    if (*p == '#' && !(levelStart && p[1] == '\0'))
+      return false;
+    if (*p == '+' && !(levelStart && levelEnd))
+      return false;
+  }
+  return true;
+}
+
+// =====================================================
+// WILDCARD MATCH
+// =====================================================
+static bool matchLevels(const char *filter, const char *topic)
+{
+  while (*filter)
+  {
+    if (*filter == '#')
+      return true;
+
+    if (*filter == '+')
+    {
+      while (*topic && *topic != '/')
+        topic++;
+      filter++;
+    }
+    else
+    {
+      while (*filter && *filter != '/')
+      {
+        if (*filter++ != *topic++)
+          return false;
+      }
+      if (*topic && *topic != '/')
+        return false;
+    }
+
+    // Both at a level separator or both at the end
+    if (*filter == '/')
+    {
+      // "a/#" also matches the parent "a"
+      if (*topic == '\0')
+        return filter[1] == '#' && filter[2] == '\0';
+      if (*topic != '/')
+        return false;
+      filter++;
+      topic++;
+    }
+    else if (*topic)
+    {
+      return false;
+    }
+  }
+  return *topic == '\0';
+}
+
+bool AT_TopicTable::matches(const char *filter, const char *topic)
+{
+  // Wildcards never match $-topics at the first level
+  if (topic[0] == '$' && (filter[0] == '+' || filter[0] == '#'))
+    return false;
+  return matchLevels(filter, topic);
+}
+
+// =====================================================
+// TABLE MAINTENANCE
+// =====================================================
+int AT_TopicTable::indexOf(const char *filter) const
+{
+  uint32_t h = fnv1a(filter);
+  for (uint8_t i = 0; i < AT_MQTT_SUBS_MAX; i++)
+  {
+    const Entry &e = _entries[i];
+    if (e.used && e.hash == h && strcmp(e.filter, filter) == 0)
+      return i;
+  }
+  return -1;
+}
+
+const AT_TopicTable::Entry *AT_TopicTable::find(const char *filter) const
+{
+  int i = indexOf(filter);
+  return i < 0 ? nullptr : &_entries[i];
+}
+
+bool AT_TopicTable::add(const char *filter, uint8_t qos, mqtt_rx_callback_t cb)
+{
+  if (!valid(filter))
+    return false;
+
+  int idx = indexOf(filter);
+  Entry *e = idx < 0 ? nullptr : &_entries[idx];
+  if (!e)
+  {
+    for (uint8_t i = 0; i < AT_MQTT_SUBS_MAX && !e; i++)
+    {
+      if (!_entries[i].used)
+        e = &_entries[i];
+    }
+    if (!e)
+      return false;
+
+    strcpy(e->filter, filter);
+    e->hash = fnv1a(filter);
+    e->literalLen = strcspn(filter, "+#");
+    e->wildcard = filter[e->literalLen] != '\0';
+    e->used = true;
+    _count++;
+  }
+
+  e->qos = qos;
+  e->cb = cb;
+  return true;
+}
+
+bool AT_TopicTable::remove(const char *filter)
+{
+  int idx = indexOf(filter);
+  if (idx < 0)
+    return false;
+
+  _entries[idx].used = false;
+  _count--;
+  return true;
+}
+
+void AT_TopicTable::clear()
+{
+  for (uint8_t i = 0; i < AT_MQTT_SUBS_MAX; i++)
+  {
+    _entries[i].used = false;
+  }
+  _count = 0;
+}
+
+const AT_TopicTable::Entry *AT_TopicTable::at(uint8_t n) const
+{
+  for (uint8_t i = 0; i < AT_MQTT_SUBS_MAX; i++)
+  {
+    if (_entries[i].used && n-- == 0)
+      return &_entries[i];
+  }
+  return nullptr;
+}
+
+// =====================================================
+// DISPATCH
+// =====================================================
+// "<prefix>/#" also matches "<prefix>", which is one char
+// short of the literal part the pre-screen compares
+static bool parentLevel(const AT_TopicTable::Entry &e, const char *topic)
+{
+  return e.filter[e.literalLen] == '#' && e.literalLen > 0 &&
+         strncmp(e.filter, topic, e.literalLen - 1) == 0 && topic[e.literalLen - 1] == '\0';
+}
+
+uint8_t AT_TopicTable::match(const char *topic, mqtt_rx_callback_t *out, uint8_t max) const
+{
+  uint32_t h = fnv1a(topic);
+  uint8_t hits = 0;
+
+  for (uint8_t i = 0; i < AT_MQTT_SUBS_MAX && hits < max; i++)
+  {
+    const Entry &e = _entries[i];
+    if (!e.used || !e.cb)
+      continue;
+
+    bool match;
+    if (!e.wildcard)
+      match = (e.hash == h && strcmp(e.filter, topic) == 0);
+    else if (e.literalLen == 0)
+      match = matches(e.filter, topic);
+    else if (strncmp(e.filter, topic, e.literalLen) == 0)
+      match = matchLevels(e.filter + e.literalLen, topic + e.literalLen);
+    else
+      match = parentLevel(e, topic);
+
+    if (match)
+      out[hits++] = e.cb;
+  }
+  return hits;
+}
+
+uint8_t AT_TopicTable::dispatch(const char *topic, const char *payload, uint16_t len) const
+{
+  mqtt_rx_callback_t cbs[AT_MQTT_SUBS_MAX];
+  uint8_t hits = match(topic, cbs, AT_MQTT_SUBS_MAX);
+
+  for (uint8_t i = 0; i < hits; i++)
+    cbs[i](topic, payload, len);
+  return hits;
+}
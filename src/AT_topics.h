@@ -0,0 +1,66 @@
+#ifndef AT_TOPICS_H
+#define AT_TOPICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef void (*mqtt_rx_callback_t)(const char *topic, const char *payload, uint16_t payloadLen);
+
+#ifndef AT_MQTT_SUBS_MAX
+#define AT_MQTT_SUBS_MAX 24 // subscriptions kept per table
+#endif
+
+#ifndef AT_MQTT_FILTER_MAX
+#define AT_MQTT_FILTER_MAX 64 // longest topic filter, including NUL
+#endif
+
+/* =====================================================
+ * MQTT TOPIC TABLE
+ * Subscribed filters with their own handler and QoS.
+ * Exact filters are found by hash; wildcard filters are
+ * pre-screened on their literal prefix before the
+ * level-by-level '+' / '#' match.
+ * ===================================================== */
+class AT_TopicTable
+{
+public:
+  struct Entry
+  {
+    char filter[AT_MQTT_FILTER_MAX];
+    uint32_t hash;      // FNV-1a of the whole filter (exact filters)
+    uint8_t literalLen; // chars before the first wildcard
+    uint8_t qos;
+    bool wildcard;
+    bool used;
+    mqtt_rx_callback_t cb;
+  };
+
+  /* Adds or updates a filter; false if invalid or the table is full */
+  bool add(const char *filter, uint8_t qos, mqtt_rx_callback_t cb);
+  bool remove(const char *filter);
+  void clear();
+
+  /* Calls every matching handler; returns how many were called.
+   * Entries without a handler match but are left to the caller. */
+  uint8_t dispatch(const char *topic, const char *payload, uint16_t len) const;
+  /* Collects the handlers dispatch() would call, at most `max`,
+   * so they can be called after a lock is released */
+  uint8_t match(const char *topic, mqtt_rx_callback_t *out, uint8_t max) const;
+
+  uint8_t count() const { return _count; }
+  const Entry *find(const char *filter) const;
+
+  /* Iteration over used entries: for (i = 0; (e = at(i)); i++) */
+  const Entry *at(uint8_t n) const;
+
+  static bool valid(const char *filter);
+  static bool matches(const char *filter, const char *topic);
+
+private:
+  int indexOf(const char *filter) const;
+
+  Entry _entries[AT_MQTT_SUBS_MAX] = {};
+  uint8_t _count = 0;
+};
+
+#endif /* AT_TOPICS_H */
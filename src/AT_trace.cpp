@@ -0,0 +1,290 @@
+#include "AT_trace.h"
+
+static const uint8_t TRACE_MAGIC[4] = {'A', 'T', 'T', 'R'};
+
+static uint8_t varintLen(uint32_t v)
+{
+  uint8_t n = 1;
+  while (v >= 0x80)
+  {
+    v >>= 7;
+    n++;
+  }
+  return n;
+}
+
+// =====================================================
+// RECORDER
+// =====================================================
+AT_TraceRecorder::AT_TraceRecorder(uint8_t *buffer, size_t size)
+    : _buf(buffer), _size(size) {}
+
+void AT_TraceRecorder::clear()
+{
+  _head = _tail = _used = 0;
+  _lastOpen = false;
+  _started = false;
+  _dropped = 0;
+}
+
+void AT_TraceRecorder::put(uint8_t b)
+{
+  _buf[_head] = b;
+  _head = (_head + 1) % _size;
+  _used++;
+}
+
+// Size of the record starting `off` bytes after the tail
+size_t AT_TraceRecorder::recordSize(size_t off) const
+{
+  size_t n = 2;
+  while (byteAt(off + n) & 0x80)
+    n++;
+  return n + 1 + byteAt(off + 1);
+}
+
+// Drops the oldest records until `n` bytes are free
+bool AT_TraceRecorder::reserve(size_t n)
+{
+  if (n > _size)
+    return false;
+
+  while (_size - _used < n)
+  {
+    if (_tail == _lastRec)
+      _lastOpen = false;
+    size_t s = recordSize(0);
+    _tail = (_tail + s) % _size;
+    _used -= s;
+    _dropped++;
+  }
+  return true;
+}
+
+void AT_TraceRecorder::record(AT_trace_dir_t dir, const uint8_t *data, size_t len)
+{
+  if (_paused || !_size)
+    return;
+
+  uint32_t now = micros();
+  while (len)
+  {
+    // Bytes following closely in the same direction extend the
+    // newest record in place; its data ends at the head
+    if (_lastOpen && _lastDir == dir && now - _byteUs < AT_TRACE_MERGE_US)
+    {
+      size_t lenAt = (_lastRec + 1) % _size;
+      size_t take = 255 - _buf[lenAt];
+      if (take > len)
+        take = len;
+      if (take && _size - _used >= take)
+      {
+        for (size_t i = 0; i < take; i++)
+          put(data[i]);
+        _buf[lenAt] += take;
+        data += take;
+        len -= take;
+        _byteUs = now;
+        continue;
+      }
+    }
+
+    uint32_t delta = _started ? now - _recUs : 0;
+    size_t take = len < 255 ? len : 255;
+    if (!reserve(2 + varintLen(delta) + take))
+      return;
+
+    _lastRec = _head;
+    put(dir);
+    put(take);
+    for (uint32_t v = delta; ; v >>= 7)
+    {
+      if (v < 0x80)
+      {
+        put(v);
+        break;
+      }
+      put((v & 0x7F) | 0x80);
+    }
+    for (size_t i = 0; i < take; i++)
+      put(data[i]);
+
+    _lastOpen = true;
+    _lastDir = dir;
+    _recUs = _byteUs = now;
+    _started = true;
+    data += take;
+    len -= take;
+  }
+}
+
+size_t AT_TraceRecorder::copy(uint8_t *out, size_t len, size_t offset) const
+{
+  const uint8_t header[AT_TRACE_HEADER_LEN] = {TRACE_MAGIC[0], TRACE_MAGIC[1], TRACE_MAGIC[2], TRACE_MAGIC[3],
+                                               AT_TRACE_VERSION, 0, 0, 0};
+  size_t total = imageSize();
+  size_t n = 0;
+  for (; n < len && offset + n < total; n++)
+  {
+    size_t i = offset + n;
+    out[n] = i < AT_TRACE_HEADER_LEN ? header[i] : byteAt(i - AT_TRACE_HEADER_LEN);
+  }
+  return n;
+}
+
+size_t AT_TraceRecorder::dump(Print &out) const
+{
+  const uint8_t header[AT_TRACE_HEADER_LEN] = {TRACE_MAGIC[0], TRACE_MAGIC[1], TRACE_MAGIC[2], TRACE_MAGIC[3],
+                                               AT_TRACE_VERSION, 0, 0, 0};
+  size_t n = out.write(header, sizeof(header));
+
+  // At most two contiguous runs: tail..end, then 0..head
+  size_t first = _size - _tail < _used ? _size - _tail : _used;
+  n += out.write(_buf + _tail, first);
+  if (_used > first)
+    n += out.write(_buf, _used - first);
+  return n;
+}
+
+// =====================================================
+// REPLAY
+// Two cursors walk the same image: one over RX records
+// (read by the library), one over TX records (matched
+// against what the library writes).
+// =====================================================
+AT_TraceReplay::AT_TraceReplay(const uint8_t *image, size_t len)
+    : _image(image), _len(len)
+{
+  _valid = image && len >= AT_TRACE_HEADER_LEN &&
+           memcmp(image, TRACE_MAGIC, sizeof(TRACE_MAGIC)) == 0 &&
+           image[4] == AT_TRACE_VERSION;
+  rewind();
+}
+
+void AT_TraceReplay::rewind()
+{
+  memset(&_rx, 0, sizeof(_rx));
+  memset(&_tx, 0, sizeof(_tx));
+  _rx.next = _tx.next = AT_TRACE_HEADER_LEN;
+  _txWritten = 0;
+  _rxTimed = false;
+  _rxStarted = false;
+  _lastRxUs = micros();
+  _mismatches = 0;
+  _extraTx = 0;
+}
+
+// Moves `c` to the next record in direction `dir`
+bool AT_TraceReplay::load(Cursor &c, uint8_t dir) const
+{
+  c.len = 0;
+  c.pos = 0;
+  c.gapUs = 0;
+  if (!_valid)
+    return false;
+
+  while (c.next + 2 <= _len)
+  {
+    size_t p = c.next;
+    uint8_t d = _image[p];
+    uint8_t n = _image[p + 1];
+    p += 2;
+
+    uint32_t delta = 0;
+    for (uint8_t shift = 0; p < _len; shift += 7)
+    {
+      uint8_t b = _image[p++];
+      delta |= (uint32_t)(b & 0x7F) << shift;
+      if (!(b & 0x80))
+        break;
+    }
+    if (p + n > _len)
+      break; // cut-off image
+
+    c.next = p + n;
+    c.gapUs += delta;
+    if (d == dir && n)
+    {
+      c.data = _image + p;
+      c.len = n;
+      c.txBefore = c.txSeen;
+      if (d == AT_TRACE_TX)
+        c.txSeen += n;
+      return true;
+    }
+    if (d == AT_TRACE_TX)
+      c.txSeen += n;
+  }
+
+  c.next = _len;
+  return false;
+}
+
+bool AT_TraceReplay::rxReady()
+{
+  if (_rx.pos >= _rx.len && !load(_rx, AT_TRACE_RX))
+    return false;
+
+  if (_gateOnTx && _rx.txBefore > _txWritten)
+    return false;
+
+  if (_realtime)
+  {
+    if (!_rxTimed)
+    {
+      _rxDueUs = _lastRxUs + (_rxStarted ? _rx.gapUs : 0);
+      _rxTimed = true;
+    }
+    if ((int32_t)(micros() - _rxDueUs) < 0)
+      return false;
+  }
+  return true;
+}
+
+bool AT_TraceReplay::done() const
+{
+  if (_rx.pos < _rx.len)
+    return false;
+  Cursor c = _rx;
+  return !load(c, AT_TRACE_RX);
+}
+
+int AT_TraceReplay::available()
+{
+  return rxReady() ? _rx.len - _rx.pos : 0;
+}
+
+int AT_TraceReplay::peek()
+{
+  return rxReady() ? _rx.data[_rx.pos] : -1;
+}
+
+int AT_TraceReplay::read()
+{
+  if (!rxReady())
+    return -1;
+
+  uint8_t b = _rx.data[_rx.pos++];
+  if (_rx.pos == _rx.len)
+  {
+    // Next record's gap counts from when this one was due
+    _lastRxUs = _rxTimed ? _rxDueUs : micros();
+    _rxTimed = false;
+    _rxStarted = true;
+  }
+  return b;
+}
+
+size_t AT_TraceReplay::write(uint8_t c)
+{
+  if (_tx.pos >= _tx.len && !load(_tx, AT_TRACE_TX))
+  {
+    _extraTx++;
+    return 1;
+  }
+
+  if (_tx.data[_tx.pos++] != c)
+    _mismatches++;
+  _txWritten++;
+  return 1;
+}
@@ -0,0 +1,152 @@
+#ifndef AT_TRACE_H
+#define AT_TRACE_H
+
+#include <Arduino.h>
+
+#ifndef AT_TRACE_MERGE_US
+#define AT_TRACE_MERGE_US 2000 // same-direction bytes closer than this share a record
+#endif
+
+/* =====================================================
+ * TRACE FORMAT
+ * Image:  "ATTR" <version> 0 0 0, then records oldest first
+ * Record: <dir> <len> <delta_us varint> <len data bytes>
+ *   dir      AT_TRACE_RX / AT_TRACE_TX
+ *   len      1..255; longer transfers span several records
+ *   delta_us time since the previous record started
+ * ===================================================== */
+typedef enum
+{
+  AT_TRACE_RX = 0, /**< Modem → host */
+  AT_TRACE_TX = 1  /**< Host → modem */
+} AT_trace_dir_t;
+
+#define AT_TRACE_VERSION 1
+#define AT_TRACE_HEADER_LEN 8
+
+/* =====================================================
+ * TRACE RECORDER
+ * Ring of timestamped UART chunks; the oldest records are
+ * dropped whole when it fills. Attach with AT_Lib::setTrace().
+ * ===================================================== */
+class AT_TraceRecorder
+{
+public:
+  AT_TraceRecorder(uint8_t *buffer, size_t size);
+
+  void record(AT_trace_dir_t dir, const uint8_t *data, size_t len);
+  void clear();
+
+  /* Stops and resumes recording without losing the contents */
+  void pause(bool paused) { _paused = paused; }
+  bool paused() const { return _paused; }
+
+  size_t used() const { return _used; }
+  uint32_t dropped() const { return _dropped; } // records overwritten
+
+  /* Export as an image (header + records), e.g. to a file or in
+   * MQTT-sized pieces: copy() returns the bytes written at `offset` */
+  size_t imageSize() const { return AT_TRACE_HEADER_LEN + _used; }
+  size_t copy(uint8_t *out, size_t len, size_t offset = 0) const;
+  size_t dump(Print &out) const;
+
+private:
+  uint8_t byteAt(size_t off) const { return _buf[(_tail + off) % _size]; }
+  void put(uint8_t b);
+  size_t recordSize(size_t off) const;
+  bool reserve(size_t n);
+
+  uint8_t *_buf;
+  size_t _size;
+  size_t _head = 0; // next write
+  size_t _tail = 0; // oldest record
+  size_t _used = 0;
+
+  size_t _lastRec = 0; // ring index of the newest record
+  bool _lastOpen = false; // newest record can still grow
+  uint8_t _lastDir = 0;
+  uint32_t _recUs = 0;  // start of the newest record
+  uint32_t _byteUs = 0; // last byte recorded
+  bool _started = false;
+  bool _paused = false;
+  uint32_t _dropped = 0;
+};
+
+/* Recorder with its own storage */
+template <size_t N>
+class AT_TraceBuffer : public AT_TraceRecorder
+{
+public:
+  AT_TraceBuffer() : AT_TraceRecorder(_storage, N) {}
+
+private:
+  uint8_t _storage[N];
+};
+
+/* =====================================================
+ * TRACE REPLAY
+ * Plays an image back as the modem stream of an AT_Lib.
+ * RX records are held until the library has written the
+ * TX bytes recorded before them, so responses follow their
+ * commands. Written bytes are compared with the recording.
+ * ===================================================== */
+class AT_TraceReplay : public Stream
+{
+public:
+  AT_TraceReplay(const uint8_t *image, size_t len);
+
+  bool valid() const { return _valid; }
+  bool done() const; // every RX byte has been read
+  void rewind();
+
+  /* Keep the recorded gaps between RX chunks (default: as fast
+   * as the reader takes them) */
+  void setRealtime(bool on) { _realtime = on; }
+  /* Release RX without waiting for TX, for poll-only replays of
+   * traces recorded with other traffic */
+  void setGateOnTx(bool on) { _gateOnTx = on; }
+
+  uint32_t mismatches() const { return _mismatches; } // TX bytes that differ
+  uint32_t extraTx() const { return _extraTx; }       // TX bytes beyond the recording
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t write(uint8_t c) override;
+  using Print::write;
+  void flush() override {}
+
+private:
+  struct Cursor
+  {
+    size_t next;      // offset of the next record header
+    const uint8_t *data;
+    uint8_t len;      // current record, 0 when none
+    uint8_t pos;
+    uint32_t txBefore; // TX bytes recorded before the current record
+    uint32_t gapUs;    // recorded time since the previous record of this direction
+    uint32_t txSeen;   // TX bytes in records passed so far
+  };
+
+  bool load(Cursor &c, uint8_t dir) const;
+  bool rxReady();
+
+  const uint8_t *_image;
+  size_t _len;
+  bool _valid;
+  bool _realtime = false;
+  bool _gateOnTx = true;
+
+  Cursor _rx;
+  Cursor _tx;
+  uint32_t _txWritten = 0;
+  uint32_t _rxDueUs = 0;
+  bool _rxTimed = false;   // _rxDueUs set for the current RX record
+  bool _rxStarted = false; // first RX record released
+  uint32_t _lastRxUs = 0;
+
+  uint32_t _mismatches = 0;
+  uint32_t _extraTx = 0;
+};
+
+#endif /* AT_TRACE_H */
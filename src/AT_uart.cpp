@@ -0,0 +1,193 @@
+#include "AT_uart.h"
+
+#if AT_UART_EVENTS
+#include <esp_idf_version.h>
+
+// =====================================================
+// DRIVER SETUP
+// Pattern detection takes a single character, so '\n'
+// is detected and a '>' prompt (never followed by '\n')
+// ends a burst and fires the RX idle timeout instead.
+// =====================================================
+AT_UartEvents::AT_UartEvents(uart_port_t port) : _port(port) {}
+
+AT_UartEvents::~AT_UartEvents()
+{
+  end();
+}
+
+bool AT_UartEvents::begin(unsigned long baud, int8_t rxPin, int8_t txPin)
+{
+  end();
+
+  uart_config_t config = {};
+  config.baud_rate = baud;
+  config.data_bits = UART_DATA_8_BITS;
+  config.parity = UART_PARITY_DISABLE;
+  config.stop_bits = UART_STOP_BITS_1;
+  config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+#if ESP_IDF_VERSION_MAJOR >= 5
+  config.source_clk = UART_SCLK_DEFAULT;
+#else
+  config.source_clk = UART_SCLK_APB;
+#endif
+
+  if (uart_driver_install(_port, AT_UART_RX_BUFFER, 0, AT_UART_EVENT_QUEUE_LEN, &_events, 0) != ESP_OK)
+    return false;
+  _installed = true;
+
+  if (uart_param_config(_port, &config) != ESP_OK ||
+      uart_set_pin(_port, txPin, rxPin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) != ESP_OK)
+  {
+    end();
+    return false;
+  }
+
+  uart_enable_pattern_det_baud_intr(_port, '\n', 1, 9, 0, 0);
+  uart_pattern_queue_reset(_port, AT_UART_EVENT_QUEUE_LEN);
+  uart_set_rx_timeout(_port, AT_UART_RX_TIMEOUT);
+  return true;
+}
+
+void AT_UartEvents::end()
+{
+  if (!_installed)
+    return;
+  uart_driver_delete(_port);
+  _installed = false;
+  _events = nullptr;
+  _bufPos = _bufLen = 0;
+}
+
+void AT_UartEvents::setBaudRate(unsigned long baud)
+{
+  if (_installed)
+    uart_set_baudrate(_port, baud);
+}
+
+void AT_UartEvents::setFlowControl(int8_t rtsPin, int8_t ctsPin)
+{
+  if (!_installed)
+    return;
+
+  if (rtsPin < 0 || ctsPin < 0)
+  {
+    uart_set_hw_flow_ctrl(_port, UART_HW_FLOWCTRL_DISABLE, 0);
+    return;
+  }
+  uart_set_pin(_port, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, rtsPin, ctsPin);
+  uart_set_hw_flow_ctrl(_port, UART_HW_FLOWCTRL_CTS_RTS, 64);
+}
+
+// =====================================================
+// EVENTS
+// Only wake-ups: data is always taken through read(),
+// so an event may be stale by the time it is seen
+// =====================================================
+void AT_UartEvents::drainEvents()
+{
+  uart_event_t ev;
+  while (xQueueReceive(_events, &ev, 0) == pdTRUE)
+  {
+    switch (ev.type)
+    {
+    case UART_PATTERN_DET:
+      // Positions are not used; popping keeps their queue from filling
+      uart_pattern_pop_pos(_port);
+      break;
+    case UART_FIFO_OVF:
+    case UART_BUFFER_FULL:
+      // The driver resets the FIFO itself and resumes once read
+      _overflows++;
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+bool AT_UartEvents::wait(uint32_t ms)
+{
+  if (!_installed)
+    return false;
+
+  size_t buffered = 0;
+  uart_get_buffered_data_len(_port, &buffered);
+  if (_bufPos < _bufLen || buffered)
+    return true;
+
+  uart_event_t ev;
+  return xQueuePeek(_events, &ev, ms == portMAX_DELAY ? portMAX_DELAY : pdMS_TO_TICKS(ms)) == pdTRUE;
+}
+
+void AT_UartEvents::wake()
+{
+  if (!_installed)
+    return;
+
+  // Never produced by the driver, so drainEvents() skips it
+  uart_event_t ev = {};
+  ev.type = UART_EVENT_MAX;
+  xQueueSend(_events, &ev, 0);
+}
+
+// =====================================================
+// STREAM
+// =====================================================
+bool AT_UartEvents::refill()
+{
+  if (_bufPos < _bufLen)
+    return true;
+  if (!_installed)
+    return false;
+
+  int n = uart_read_bytes(_port, _buf, sizeof(_buf), 0);
+  _bufPos = 0;
+  _bufLen = n > 0 ? n : 0;
+  return _bufLen > 0;
+}
+
+int AT_UartEvents::available()
+{
+  if (_bufPos < _bufLen)
+    return _bufLen - _bufPos;
+  if (!_installed)
+    return 0;
+
+  // Emptied: events so far are accounted for
+  drainEvents();
+  size_t buffered = 0;
+  uart_get_buffered_data_len(_port, &buffered);
+  return buffered;
+}
+
+int AT_UartEvents::read()
+{
+  return refill() ? _buf[_bufPos++] : -1;
+}
+
+int AT_UartEvents::peek()
+{
+  return refill() ? _buf[_bufPos] : -1;
+}
+
+size_t AT_UartEvents::write(uint8_t c)
+{
+  return write(&c, 1);
+}
+
+size_t AT_UartEvents::write(const uint8_t *buffer, size_t size)
+{
+  if (!_installed)
+    return 0;
+  int n = uart_write_bytes(_port, (const char *)buffer, size);
+  return n > 0 ? n : 0;
+}
+
+void AT_UartEvents::flush()
+{
+  if (_installed)
+    uart_wait_tx_done(_port, portMAX_DELAY);
+}
+
+#endif /* AT_UART_EVENTS */
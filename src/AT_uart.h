@@ -0,0 +1,84 @@
+#ifndef AT_UART_H
+#define AT_UART_H
+
+#include <Arduino.h>
+
+#ifndef AT_UART_EVENTS
+#if defined(ARDUINO_ARCH_ESP32)
+#define AT_UART_EVENTS 1 // AT_UartEvents, on the ESP-IDF UART driver
+#else
+#define AT_UART_EVENTS 0
+#endif
+#endif
+
+class AT_UartEvents;
+
+#if AT_UART_EVENTS
+#include <driver/uart.h>
+
+#ifndef AT_UART_RX_BUFFER
+#define AT_UART_RX_BUFFER 2048 // driver ring; a full MQTT payload fits while a task is busy
+#endif
+
+#ifndef AT_UART_EVENT_QUEUE_LEN
+#define AT_UART_EVENT_QUEUE_LEN 16
+#endif
+
+#ifndef AT_UART_RX_TIMEOUT
+#define AT_UART_RX_TIMEOUT 4 // idle symbols that end a burst, e.g. after a '>' prompt
+#endif
+
+/* =====================================================
+ * EVENT-DRIVEN UART
+ * Modem stream on the ESP-IDF UART driver. The driver
+ * reports '\n' through pattern detection and the end of
+ * a burst through its RX idle timeout, so wait() sleeps
+ * until a line or a '>' prompt is in. Pass it to AT_Lib
+ * in place of a HardwareSerial on the same port.
+ * ===================================================== */
+class AT_UartEvents : public Stream
+{
+public:
+  explicit AT_UartEvents(uart_port_t port);
+  ~AT_UartEvents();
+
+  bool begin(unsigned long baud, int8_t rxPin, int8_t txPin);
+  void end();
+  void setBaudRate(unsigned long baud);
+  /* RTS/CTS on the given pins; -1 for both turns it off */
+  void setFlowControl(int8_t rtsPin, int8_t ctsPin);
+
+  /* Blocks until data may be readable, wake() or `ms` passes.
+   * Events are peeked, not taken, so two tasks may wait at once;
+   * available() consumes them. */
+  bool wait(uint32_t ms);
+  void wake();
+
+  uint32_t overflows() const { return _overflows; } // FIFO / ring overruns
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  void flush() override;
+
+private:
+  void drainEvents();
+  bool refill();
+
+  uart_port_t _port;
+  QueueHandle_t _events = nullptr;
+  bool _installed = false;
+  uint32_t _overflows = 0;
+
+  /* uart_read_bytes() takes a lock per call, so bytes are
+   * fetched a burst at a time */
+  uint8_t _buf[64];
+  uint8_t _bufPos = 0;
+  uint8_t _bufLen = 0;
+};
+#endif
+
+#endif /* AT_UART_H */